@@ -0,0 +1,97 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "BatchEntryPoints.hpp"
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr const char *kModuleName = "batch_entry_bench";
+constexpr const char *kFunction = "f";
+
+// A polynomial in two variables through a helper, both get inlined into the batch loop
+constexpr const char *kProgram = "def square(x) x * x;\n"
+                                 "def f(x y) square(x) * y - 2 * x * y + 3 * square(y) + 1 - (x < y);\n";
+
+constexpr std::size_t kElements = 1 << 16;
+
+using Function = double (*)(double, double);
+using BatchFunction = void (*)(const double *, const double *, double *, std::size_t);
+
+// The program on the JIT with its batch entry points, compiled once per benchmark and left out of the timings
+std::unique_ptr<llvm::orc::KaleidoscopeJIT> compile() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+
+    auto exportedFunctions = std::make_shared<ExportedFunctions>();
+    LLVMContextData ctxData{exportedFunctions};
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+
+    Lexer lexer{std::make_unique<StringSource>(kProgram)};
+    Parser parser{lexer};
+    parser.start();
+
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto func = parser.parseDefinition();
+        func->codegen(ctxData);
+        parser.recycle(*func);
+    }
+
+    // Where the driver generates them, when the module is handed over
+    ctxData.exportFunctions();
+    BatchEntryPoints batchEntries;
+    batchEntries.generate(*ctxData.m_llvmModule, *exportedFunctions);
+    llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+
+    return jit;
+}
+
+void batchBenchmark(bench::State &state, bool batch) {
+    const std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit = compile();
+
+    std::vector<double> x(kElements);
+    std::vector<double> y(kElements);
+    std::vector<double> out(kElements);
+    for (std::size_t i = 0; i < kElements; ++i) {
+        x[i] = static_cast<double>(i) * 0.001;
+        y[i] = 1.0 - static_cast<double>(i) * 0.0005;
+    }
+
+    if (batch) {
+        const BatchFunction batchEntry = llvm::ExitOnError{}(jit->lookup(BatchEntryPoints::nameOf(kFunction)))
+                                             .getAddress()
+                                             .toPtr<BatchFunction>();
+        state.measure([&] { batchEntry(x.data(), y.data(), out.data(), kElements); });
+    } else {
+        const Function entry = llvm::ExitOnError{}(jit->lookup(kFunction)).getAddress().toPtr<Function>();
+        state.measure([&] {
+            for (std::size_t i = 0; i < kElements; ++i) {
+                out[i] = entry(x[i], y[i]);
+            }
+        });
+    }
+
+    state.setCounter("ns/element", state.seconds() * 1e9 / kElements);
+    state.setCounter("checksum", out[kElements / 3] + out[kElements - 1]);
+}
+
+BENCHMARK("batch-entry/2^16/scalar-calls", [](bench::State &state) { batchBenchmark(state, false); });
+BENCHMARK("batch-entry/2^16/batch", [](bench::State &state) { batchBenchmark(state, true); });
+
+}  // namespace
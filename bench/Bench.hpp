@@ -0,0 +1,111 @@
+#ifndef _BENCH_HPP_
+#define _BENCH_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+class State {
+public:
+    // Runs the measured body `iterations` times(after a warm-up run) and records the best wall time of a single run
+    template <typename Body>
+    void measure(Body &&body) {
+        body();
+
+        for (int i = 0; i < m_iterations; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (m_seconds < 0 || elapsed.count() < m_seconds) {
+                m_seconds = elapsed.count();
+            }
+        }
+    }
+
+    // Like measure(body), with `setup` run before every run of `body` and left out of its time
+    template <typename Setup, typename Body>
+    void measure(Setup &&setup, Body &&body) {
+        setup();
+        body();
+
+        for (int i = 0; i < m_iterations; ++i) {
+            setup();
+
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (m_seconds < 0 || elapsed.count() < m_seconds) {
+                m_seconds = elapsed.count();
+            }
+        }
+    }
+
+    // Amount of input handled by a single run, reported as MB/s
+    void setBytesProcessed(std::size_t bytes) {
+        m_bytes = bytes;
+    }
+
+    // Free-form value reported next to the timing(e.g. tokens per run)
+    void setCounter(std::string name, double value) {
+        m_counters.emplace_back(std::move(name), value);
+    }
+
+    double seconds() const {
+        return m_seconds;
+    }
+
+    std::size_t bytesProcessed() const {
+        return m_bytes;
+    }
+
+    const std::vector<std::pair<std::string, double>> &counters() const {
+        return m_counters;
+    }
+
+    void setIterations(int iterations) {
+        m_iterations = iterations;
+    }
+
+    int iterations() const {
+        return m_iterations;
+    }
+
+private:
+    int m_iterations = 5;
+    double m_seconds = -1;
+    std::size_t m_bytes = 0;
+    std::vector<std::pair<std::string, double>> m_counters;
+};
+
+struct Benchmark {
+    std::string m_name;
+    std::function<void(State &)> m_run;
+};
+
+inline std::vector<Benchmark> &registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+struct Registrar {
+    Registrar(std::string name, std::function<void(State &)> run) {
+        registry().push_back(Benchmark{std::move(name), std::move(run)});
+    }
+};
+
+}  // namespace bench
+
+#define BENCH_CONCAT_IMPL(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_IMPL(a, b)
+
+// Registers `fn`(a void(bench::State&) callable) under `name`
+#define BENCHMARK(name, fn) static const bench::Registrar BENCH_CONCAT(benchRegistrar, __LINE__){name, fn}
+
+#endif  // !_BENCH_HPP_
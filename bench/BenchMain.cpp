@@ -0,0 +1,131 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+#include "Bench.hpp"
+
+namespace {
+
+// `text` as a JSON string literal
+std::string jsonString(std::string_view text) {
+    std::string quoted = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+// JSON has no infinities or NaNs
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+
+    std::ostringstream number;
+    number << std::setprecision(9) << value;
+    return number.str();
+}
+
+// One object per benchmark run, in the order they ran
+std::string jsonReport(const std::vector<std::pair<const bench::Benchmark *, bench::State>> &results, int iterations) {
+    std::string json = "{\n  \"iterations\": " + std::to_string(iterations) + ",\n  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto &[benchmark, state] = results[i];
+
+        json += i == 0 ? "\n" : ",\n";
+        json += "    {\"name\": " + jsonString(benchmark->m_name) + ", \"seconds\": " + jsonNumber(state.seconds());
+        if (state.bytesProcessed() != 0) {
+            json += ", \"bytes_per_second\": " + jsonNumber(state.bytesProcessed() / state.seconds());
+        }
+
+        json += ", \"counters\": {";
+        for (std::size_t c = 0; c < state.counters().size(); ++c) {
+            const auto &[name, value] = state.counters()[c];
+            json += (c == 0 ? "" : ", ") + jsonString(name) + ": " + jsonNumber(value);
+        }
+        json += "}}";
+    }
+    return json + "\n  ]\n}\n";
+}
+
+}  // namespace
+
+// Usage: kaleidoscope_bench [--iterations=N] [--json=FILE] [name-filter...]
+// Runs every registered benchmark whose name contains one of the filters(all of them if no filter is given). With
+// --json the results are also written to FILE(stdout for -) as JSON, for tracking them across releases.
+int main(int argc, char **argv) {
+    constexpr std::string_view kJson = "--json=";
+
+    std::vector<std::string_view> filters;
+    int iterations = 5;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--iterations=")) {
+            iterations = std::atoi(argv[i] + std::strlen("--iterations="));
+        } else if (arg.starts_with(kJson)) {
+            jsonPath = arg.substr(kJson.size());
+        } else {
+            filters.push_back(arg);
+        }
+    }
+
+    const auto selected = [&filters](std::string_view name) {
+        if (filters.empty()) {
+            return true;
+        }
+        for (const auto filter : filters) {
+            if (name.find(filter) != std::string_view::npos) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<std::pair<const bench::Benchmark *, bench::State>> results;
+
+    for (const auto &benchmark : bench::registry()) {
+        if (!selected(benchmark.m_name)) {
+            continue;
+        }
+
+        bench::State state;
+        state.setIterations(iterations);
+        benchmark.m_run(state);
+
+        std::cout << std::left << std::setw(48) << benchmark.m_name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << state.seconds() * 1e3 << " ms";
+
+        if (state.bytesProcessed() != 0) {
+            std::cout << std::setw(12) << state.bytesProcessed() / state.seconds() / (1024.0 * 1024.0) << " MB/s";
+        }
+        for (const auto &[name, value] : state.counters()) {
+            std::cout << "  " << name << '=' << std::defaultfloat << value;
+        }
+        std::cout << '\n';
+
+        results.emplace_back(&benchmark, std::move(state));
+    }
+
+    if (jsonPath == "-") {
+        std::cout << jsonReport(results, iterations);
+    } else if (!jsonPath.empty()) {
+        std::ofstream file{jsonPath};
+        file << jsonReport(results, iterations);
+        if (!file) {
+            std::cout << "Error: cannot write '" << jsonPath << "'\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <memory>
+#include <random>
+#include <string>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "ConstantFolder.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr int kFoldedExpressions = 100000;
+
+// Every expression costs the JIT a module, a subset is enough to tell the cost of one
+constexpr int kCompiledExpressions = 1000;
+
+constexpr const char *kModuleName = "constant_fold_bench";
+constexpr const char *kAnonExprIdentifier = "__anon_expr";
+
+constexpr const char *kDefinitions = "def sq(x) x * x;\n"
+                                     "def poly(x y) sq(x) + 3 * x * y - y;\n"
+                                     "def lerp(a b t) a + (b - a) * t;\n";
+
+// The pure helpers, then constant top-level expressions: plain arithmetic and calls with constant arguments
+std::string generateProgram(int expressions) {
+    std::mt19937 rng{14};
+    std::uniform_int_distribution<int> pick{1, 99};
+    const auto number = [&] { return std::to_string(pick(rng)); };
+
+    std::string text = kDefinitions;
+    for (int i = 0; i < expressions; ++i) {
+        switch (i % 3) {
+            case 0:
+                text += "(" + number() + " + " + number() + ".5) * " + number() + " - 4 < " + number() + ";\n";
+                break;
+            case 1:
+                text += "poly(" + number() + ", " + number() + ".25) - sq(" + number() + ");\n";
+                break;
+            case 2:
+                text += "lerp(" + number() + ", " + number() + ", 0." + number() + ") * 2;\n";
+                break;
+        }
+    }
+    return text;
+}
+
+const std::string &program(int expressions) {
+    static const std::string folded = generateProgram(kFoldedExpressions);
+    static const std::string compiled = generateProgram(kCompiledExpressions);
+    return expressions == kFoldedExpressions ? folded : compiled;
+}
+
+llvm::orc::KaleidoscopeJIT &jit() {
+    static const std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit = [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmParser();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+        llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+        return jit;
+    }();
+    return *jit;
+}
+
+// What the REPL does for a constant top-level expression now: parse it and evaluate its AST
+double foldAll() {
+    Lexer lexer{std::make_unique<StringSource>(program(kFoldedExpressions))};
+    Parser parser{lexer};
+    parser.start();
+
+    ConstantFolder folder;
+    const Symbol name = Symbol::intern(kAnonExprIdentifier);
+
+    double sum = 0;
+    for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+        if (item == Parser::TopLevel::Definition) {
+            const auto func = parser.parseDefinition();
+            folder.define(*func);
+            parser.recycle(*func);
+        } else if (item == Parser::TopLevel::Expression) {
+            const auto anonFunc = parser.parseTopLevelExpr(name);
+            sum += *folder.evaluate(anonFunc->m_body);
+            parser.recycle(*anonFunc);
+        } else {
+            parser.skipSeparator();
+        }
+    }
+
+    return sum;
+}
+
+// What it did before: codegen into a module of its own, hand it to the JIT, run it and free it again. The helpers go
+// to the JIT once per run and are removed after it, the expressions call them through the exported functions.
+double compileAll() {
+    Lexer lexer{std::make_unique<StringSource>(program(kCompiledExpressions))};
+    Parser parser{lexer};
+    parser.start();
+
+    auto &kaleidoscopeJIT = jit();
+    const Symbol name = Symbol::intern(kAnonExprIdentifier);
+
+    LLVMContextData ctxData;
+    ctxData.startModule(kModuleName, kaleidoscopeJIT.getDataLayout());
+
+    auto definitionsTracker = kaleidoscopeJIT.getMainJITDylib().createResourceTracker();
+    bool definitionsAdded = false;
+
+    double sum = 0;
+    for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+        if (item == Parser::TopLevel::Definition) {
+            const auto func = parser.parseDefinition();
+            func->codegen(ctxData);
+            parser.recycle(*func);
+            continue;
+        }
+        if (item != Parser::TopLevel::Expression) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        // The definitions precede the first expression
+        if (!definitionsAdded) {
+            definitionsAdded = true;
+            ctxData.exportFunctions();
+            llvm::ExitOnError{}(kaleidoscopeJIT.addModule(ctxData.takeModule(), definitionsTracker));
+            ctxData.startModule(kModuleName, kaleidoscopeJIT.getDataLayout());
+        }
+
+        const auto anonFunc = parser.parseTopLevelExpr(name);
+        anonFunc->codegen(ctxData);
+        parser.recycle(*anonFunc);
+
+        auto resourceTracker = kaleidoscopeJIT.getMainJITDylib().createResourceTracker();
+        llvm::ExitOnError{}(kaleidoscopeJIT.addEagerModule(ctxData.takeModule(), resourceTracker));
+        ctxData.startModule(kModuleName, kaleidoscopeJIT.getDataLayout());
+
+        auto exprSymbol = llvm::ExitOnError{}(kaleidoscopeJIT.lookup(kAnonExprIdentifier));
+        sum += exprSymbol.getAddress().toPtr<double (*)()>()();
+
+        llvm::ExitOnError{}(resourceTracker->remove());
+    }
+
+    llvm::ExitOnError{}(definitionsTracker->remove());
+    return sum;
+}
+
+void foldBenchmark(bench::State &state, bool fold) {
+    const int expressions = fold ? kFoldedExpressions : kCompiledExpressions;
+
+    double sum = 0;
+    state.measure([&] { sum = fold ? foldAll() : compileAll(); });
+
+    state.setCounter("expressions", expressions);
+    state.setCounter("us/expression", state.seconds() * 1e6 / expressions);
+    state.setCounter("sum", sum);
+}
+
+BENCHMARK("fold/constant-exprs/folded", [](bench::State &state) { foldBenchmark(state, true); });
+BENCHMARK("fold/constant-exprs/jit", [](bench::State &state) { foldBenchmark(state, false); });
+
+}  // namespace
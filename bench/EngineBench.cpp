@@ -0,0 +1,70 @@
+#include <cstddef>
+#include <memory>
+
+#include "Bench.hpp"
+#include "Engine.hpp"
+
+namespace {
+
+constexpr const char *kProgram = "def f(x y) x * y + 1;";
+
+constexpr std::size_t kCalls = 1 << 20;
+
+using Function = kaleidoscope::Fn<double(double, double)>;
+
+// The engine and the handle of `f`, set up once per benchmark
+std::unique_ptr<kaleidoscope::Engine> compile(Function &f) {
+    auto engine = kaleidoscope::Engine::create();
+    auto program = (*engine)->compile(kProgram);
+    f = *program->function<double(double, double)>("f");
+    return std::move(*engine);
+}
+
+// A chain of dependent calls, every call waits for the previous result
+template <typename Callee>
+double callChain(Callee &&callee) {
+    double value = 0;
+    for (std::size_t i = 0; i < kCalls; ++i) {
+        value = callee(value * 1e-9, static_cast<double>(i));
+    }
+    return value;
+}
+
+void callBenchmark(bench::State &state, bool handle) {
+    Function f;
+    const auto engine = compile(f);
+
+    double result = 0;
+    if (handle) {
+        state.measure([&] { result = callChain(f); });
+    } else {
+        // What the handle holds, called directly
+        double (*const pointer)(double, double) = f.address();
+        state.measure([&] { result = callChain(pointer); });
+    }
+
+    state.setCounter("ns/call", state.seconds() * 1e9 / kCalls);
+    state.setCounter("result", result);
+}
+
+// Another handle of a function whose address the engine resolved before
+void lookupBenchmark(bench::State &state) {
+    auto engine = kaleidoscope::Engine::create();
+    auto program = (*engine)->compile(kProgram);
+
+    constexpr int kLookups = 1000;
+    Function f;
+    state.measure([&] {
+        for (int i = 0; i < kLookups; ++i) {
+            f = *program->function<double(double, double)>("f");
+        }
+    });
+
+    state.setCounter("ns/lookup", state.seconds() * 1e9 / kLookups);
+}
+
+BENCHMARK("embed/call-2^20/fn-handle", [](bench::State &state) { callBenchmark(state, true); });
+BENCHMARK("embed/call-2^20/raw-pointer", [](bench::State &state) { callBenchmark(state, false); });
+BENCHMARK("embed/function-lookup", lookupBenchmark);
+
+}  // namespace
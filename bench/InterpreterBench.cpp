@@ -0,0 +1,140 @@
+#include <memory>
+#include <string>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "Bytecode.hpp"
+#include "BytecodeVM.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr const char *kModuleName = "interpreter_bench";
+constexpr const char *kEntry = "run";
+constexpr const char *kEntryCall = "run(0.25);";
+
+// A one-shot script: a handful of functions and a single call
+constexpr int kScriptDepth = 4;
+
+// Long enough a run for the per-call cost to dominate, 2^20 evaluations of f
+constexpr int kKernelDepth = 20;
+
+// Numeric integration of f over [a, a + h] by bisection, 2^depth evaluations of f and 2^(depth + 1) - 1 calls in all.
+// Every level of the recursion is a function of its own, the language has no conditionals.
+std::string generateIntegration(int depth) {
+    std::string text = "def f(x) x * x * x - 2 * x * x + 3 * x + 1;\n"
+                       "def integrate0(a h) f(a + h * 0.5) * h;\n";
+    for (int i = 1; i <= depth; ++i) {
+        const std::string previous = "integrate" + std::to_string(i - 1);
+        text += "def integrate" + std::to_string(i) + "(a h) " + previous + "(a, h * 0.5) + " + previous +
+                "(a + h * 0.5, h * 0.5);\n";
+    }
+    return text + "def run(x) integrate" + std::to_string(depth) + "(x, 1);\n";
+}
+
+double callsOf(int depth) {
+    return static_cast<double>((std::size_t{1} << (depth + 1)) - 1 + (std::size_t{1} << depth));
+}
+
+// Parses the definitions of `program` and hands every one of them to `define`
+template <typename Define>
+void parseDefinitions(const std::string &program, Define &&define) {
+    Lexer lexer{std::make_unique<StringSource>(program)};
+    Parser parser{lexer};
+    parser.start();
+
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto func = parser.parseDefinition();
+        define(*func);
+        parser.recycle(*func);
+    }
+}
+
+// The program on the JIT, until `run` can be called. LLVM's targets are set up once per process, which is not counted.
+double (*compileJit(const std::string &program, std::unique_ptr<llvm::orc::KaleidoscopeJIT> &jit))(double) {
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+
+    LLVMContextData ctxData;
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+    parseDefinitions(program, [&ctxData](FunctionAST &func) { func.codegen(ctxData); });
+
+    llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+    return llvm::ExitOnError{}(jit->lookup(kEntry)).getAddress().toPtr<double (*)(double)>();
+}
+
+// The program as bytecode, and the top-level expression calling `run`
+BytecodeFunction compileInterp(const std::string &program, BytecodeProgram &bytecode) {
+    parseDefinitions(program, [&bytecode](FunctionAST &func) { bytecode.define(func); });
+
+    Lexer lexer{std::make_unique<StringSource>(kEntryCall)};
+    Parser parser{lexer};
+    parser.start();
+
+    const auto anonFunc = parser.parseTopLevelExpr(Symbol::intern("__anon_expr"));
+    return *bytecode.compileExpression(*anonFunc);
+}
+
+void initializeJit() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+}
+
+// From the source text to the result of its first call
+void firstResultBenchmark(bench::State &state, bool interp) {
+    static const std::string program = generateIntegration(kScriptDepth);
+    initializeJit();
+
+    double result = 0;
+    state.measure([&] {
+        if (interp) {
+            BytecodeProgram bytecode;
+            BytecodeVM vm;
+            const BytecodeFunction entry = compileInterp(program, bytecode);
+            result = *vm.run(bytecode, entry);
+        } else {
+            std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+            result = compileJit(program, jit)(0.25);
+        }
+    });
+
+    state.setCounter("first-result-us", state.seconds() * 1e6);
+    state.setCounter("result", result);
+}
+
+// Calls of an already compiled program
+void throughputBenchmark(bench::State &state, bool interp) {
+    static const std::string program = generateIntegration(kKernelDepth);
+    initializeJit();
+
+    double result = 0;
+    if (interp) {
+        BytecodeProgram bytecode;
+        BytecodeVM vm;
+        const BytecodeFunction entry = compileInterp(program, bytecode);
+        state.measure([&] { result = *vm.run(bytecode, entry); });
+    } else {
+        std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+        double (*const entry)(double) = compileJit(program, jit);
+        state.measure([&] { result = entry(0.25); });
+    }
+
+    state.setCounter("ns/call", state.seconds() * 1e9 / callsOf(kKernelDepth));
+    state.setCounter("result", result);
+}
+
+BENCHMARK("engine/first-result/jit", [](bench::State &state) { firstResultBenchmark(state, false); });
+BENCHMARK("engine/first-result/interp", [](bench::State &state) { firstResultBenchmark(state, true); });
+BENCHMARK("engine/integrate-2^20/jit", [](bench::State &state) { throughputBenchmark(state, false); });
+BENCHMARK("engine/integrate-2^20/interp", [](bench::State &state) { throughputBenchmark(state, true); });
+
+}  // namespace
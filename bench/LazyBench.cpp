@@ -0,0 +1,141 @@
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr int kFunctions = 10000;
+constexpr int kCalledFunctions = 50;
+constexpr const char *kModuleName = "lazy_bench";
+constexpr const char *kAnonExprIdentifier = "__anon_expr";
+
+// A large library of definitions of which only a few are ever called
+std::string generateLibrary() {
+    std::string text;
+    for (int i = 0; i < kFunctions; ++i) {
+        const std::string n = std::to_string(i);
+        text += "def f" + n + "(x y) (x + " + n + ".5) * (y - x) + x * y * " + n + " - (x < y) * y;\n";
+    }
+    for (int i = 0; i < kCalledFunctions; ++i) {
+        text += "f" + std::to_string(i * (kFunctions / kCalledFunctions)) + "(1.5, 2);\n";
+    }
+    return text;
+}
+
+const std::string &library() {
+    static const std::string text = generateLibrary();
+    return text;
+}
+
+struct Timings {
+    double m_startup = 0;  // until the first top-level expression returned
+    double m_total = 0;
+    double m_sum = 0;
+};
+
+// The batch driver with its JIT in the given mode, from an empty JIT to the last result
+Timings runLibrary(bool lazy) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto secondsSince = [](auto from) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+    };
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create(lazy).moveInto(jit));
+
+    LLVMContextData ctxData;
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+
+    std::mutex optimizerMutex;
+    if (lazy) {
+        ctxData.m_optimizeFunctions = false;
+        jit->setOptimizer([&](llvm::orc::ThreadSafeModule threadSafeModule,
+                              const llvm::orc::MaterializationResponsibility &) {
+            threadSafeModule.withModuleDo([&](llvm::Module &module) {
+                std::lock_guard lock{optimizerMutex};
+                ctxData.m_llvmOpt.optimize(module);
+            });
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(threadSafeModule));
+        });
+    }
+
+    Lexer lexer{std::make_unique<StringSource>(library())};
+    Parser parser{lexer};
+    parser.start();
+
+    std::vector<Symbol> expressions;
+    for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+        std::unique_ptr<FunctionAST> func;
+        if (item == Parser::TopLevel::Definition) {
+            func = parser.parseDefinition();
+        } else if (item == Parser::TopLevel::Expression) {
+            expressions.push_back(Symbol::intern(kAnonExprIdentifier + std::to_string(expressions.size())));
+            func = parser.parseTopLevelExpr(expressions.back());
+        } else {
+            parser.skipSeparator();
+            continue;
+        }
+
+        func->codegen(ctxData);
+        parser.recycle(*func);
+
+        // Like the driver: lazily every item is a module of its own, callable from later modules
+        if (lazy) {
+            ctxData.exportFunctions();
+            llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+            ctxData.startModule(kModuleName, jit->getDataLayout());
+        }
+    }
+
+    if (!lazy) {
+        llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+    }
+
+    Timings timings;
+    for (const Symbol name : expressions) {
+        auto exprSymbol = llvm::ExitOnError{}(jit->lookup(name.str()));
+        timings.m_sum += exprSymbol.getAddress().toPtr<double (*)()>()();
+
+        if (timings.m_startup == 0) {
+            timings.m_startup = secondsSince(start);
+        }
+    }
+
+    timings.m_total = secondsSince(start);
+    return timings;
+}
+
+void libraryBenchmark(bench::State &state, bool lazy) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    Timings best;
+    state.measure([&] {
+        const Timings timings = runLibrary(lazy);
+        if (best.m_total == 0 || timings.m_total < best.m_total) {
+            best = timings;
+        }
+    });
+
+    state.setCounter("functions", kFunctions);
+    state.setCounter("called", kCalledFunctions);
+    state.setCounter("startup-ms", best.m_startup * 1e3);
+    state.setCounter("total-ms", best.m_total * 1e3);
+    state.setCounter("sum", best.m_sum);
+}
+
+BENCHMARK("jit/10k-defs-50-calls/eager", [](bench::State &state) { libraryBenchmark(state, false); });
+BENCHMARK("jit/10k-defs-50-calls/lazy", [](bench::State &state) { libraryBenchmark(state, true); });
+
+}  // namespace
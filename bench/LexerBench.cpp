@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include <fcntl.h>
+
+#include "Bench.hpp"
+#include "Lexer.hpp"
+
+namespace {
+
+constexpr std::size_t kCorpusBytes = 8 * 1024 * 1024;
+
+// Deterministic mix of definitions, externs, comments and top-level expressions
+std::string generateCorpus(std::size_t bytes) {
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> pick{0, 99};
+
+    std::string text;
+    text.reserve(bytes + 256);
+
+    for (int i = 0; text.size() < bytes; ++i) {
+        const int kind = pick(rng);
+        const std::string fn = "function_" + std::to_string(i);
+
+        if (kind < 10) {
+            text += "# helper number " + std::to_string(i) + " computes a polynomial of its arguments\n";
+        } else if (kind < 20) {
+            text += "extern " + fn + "(x y);\n";
+        } else if (kind < 80) {
+            text += "def " + fn + "(alpha beta gamma)\n    alpha * " + std::to_string(pick(rng)) + ".25 + beta * (gamma - " +
+                    std::to_string(pick(rng)) + ") < alpha;\n";
+        } else {
+            text += "function_" + std::to_string(pick(rng)) + "(1.5, 2, " + std::to_string(i) + ".75);\n";
+        }
+    }
+
+    return text;
+}
+
+const std::string &corpus() {
+    static const std::string text = generateCorpus(kCorpusBytes);
+    return text;
+}
+
+const std::filesystem::path &corpusFile() {
+    static const std::filesystem::path path = [] {
+        auto path = std::filesystem::temp_directory_path() / "kaleidoscope_lexer_bench.ks";
+        std::ofstream{path, std::ios::binary} << corpus();
+        return path;
+    }();
+    return path;
+}
+
+// The input path the lexer used to have: one locked stdio call per character
+class PerCharStdioSource : public SourceBuffer {
+public:
+    explicit PerCharStdioSource(std::FILE *file)
+        : m_file(file) {
+    }
+
+    std::string_view nextChunk() override {
+        const int c = std::getc(m_file);
+        if (c == EOF) {
+            return {};
+        }
+        m_char = static_cast<char>(c);
+        return {&m_char, 1};
+    }
+
+private:
+    std::FILE *m_file;
+    char m_char = 0;
+};
+
+std::size_t lexAll(std::unique_ptr<SourceBuffer> source) {
+    Lexer lexer{std::move(source)};
+
+    std::size_t tokens = 0;
+    while (lexer.getNextToken().m_token != Token::TOK_EOF) {
+        ++tokens;
+    }
+    return tokens;
+}
+
+void reportTokens(bench::State &state, std::size_t tokens) {
+    state.setBytesProcessed(corpus().size());
+    state.setCounter("tokens", static_cast<double>(tokens));
+}
+
+void lexPerCharStdio(bench::State &state) {
+    std::size_t tokens = 0;
+    state.measure([&tokens] {
+        std::FILE *file = std::fopen(corpusFile().c_str(), "rb");
+        tokens = lexAll(std::make_unique<PerCharStdioSource>(file));
+        std::fclose(file);
+    });
+    reportTokens(state, tokens);
+}
+
+void lexStream(bench::State &state) {
+    std::size_t tokens = 0;
+    state.measure([&tokens] {
+        const int fd = ::open(corpusFile().c_str(), O_RDONLY);
+        tokens = lexAll(std::make_unique<StreamSource>(fd));
+        ::close(fd);
+    });
+    reportTokens(state, tokens);
+}
+
+void lexMappedFile(bench::State &state) {
+    std::size_t tokens = 0;
+    state.measure([&tokens] { tokens = lexAll(MappedFileSource::open(corpusFile().c_str())); });
+    reportTokens(state, tokens);
+}
+
+void lexString(bench::State &state) {
+    std::size_t tokens = 0;
+    state.measure([&tokens] { tokens = lexAll(std::make_unique<StringSource>(corpus())); });
+    reportTokens(state, tokens);
+}
+
+}  // namespace
+
+BENCHMARK("lexer/per-char-stdio", lexPerCharStdio);
+BENCHMARK("lexer/stream", lexStream);
+BENCHMARK("lexer/mapped-file", lexMappedFile);
+BENCHMARK("lexer/string", lexString);
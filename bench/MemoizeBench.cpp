@@ -0,0 +1,82 @@
+#include <memory>
+#include <string>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Memoizer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr const char *kModuleName = "memoize_bench";
+constexpr const char *kEntry = "run";
+constexpr int kFibDepth = 30;
+
+// fibN(x) = fibN-1(x) + fibN-2(x), every level a function of its own(there are no conditionals): 2 * fib(N) - 1 calls
+// without memoization, one miss per level with it
+std::string generateFib(int depth) {
+    std::string text = "def fib0(x) x;\ndef fib1(x) x + 1;\n";
+    for (int i = 2; i <= depth; ++i) {
+        text += "def fib" + std::to_string(i) + "(x) fib" + std::to_string(i - 1) + "(x) + fib" +
+                std::to_string(i - 2) + "(x);\n";
+    }
+    return text + "def run(x) fib" + std::to_string(depth) + "(x);\n";
+}
+
+void memoizeBenchmark(bench::State &state, bool memoize) {
+    static const std::string program = generateFib(kFibDepth);
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+
+    auto exportedFunctions = std::make_shared<ExportedFunctions>();
+    LLVMContextData ctxData{exportedFunctions};
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+
+    Lexer lexer{std::make_unique<StringSource>(program)};
+    Parser parser{lexer};
+    parser.start();
+
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto func = parser.parseDefinition();
+        func->codegen(ctxData);
+        parser.recycle(*func);
+    }
+
+    // Where the driver memoizes, when the module is handed over
+    std::unique_ptr<Memoizer> memoizer;
+    ctxData.exportFunctions();
+    if (memoize) {
+        memoizer = std::make_unique<Memoizer>(*jit, 1 << 16);
+        memoizer->memoize(*ctxData.m_llvmModule, *exportedFunctions);
+    }
+    llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+
+    double (*entry)(double) = llvm::ExitOnError{}(jit->lookup(kEntry)).getAddress().toPtr<double (*)(double)>();
+
+    // A fresh argument every run, the first call of a memoized program is what counts
+    double x = 0;
+    double result = 0;
+    state.measure([&] { result = entry(x += 0.5); });
+
+    state.setCounter("run-us", state.seconds() * 1e6);
+    state.setCounter("result", result);
+}
+
+BENCHMARK("memoize/fib-30/plain", [](bench::State &state) { memoizeBenchmark(state, false); });
+BENCHMARK("memoize/fib-30/memoized", [](bench::State &state) { memoizeBenchmark(state, true); });
+
+}  // namespace
@@ -0,0 +1,126 @@
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "ObjectCache.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr int kFunctions = 2000;
+constexpr int kFunctionsPerModule = 64;  // Driver::kItemsPerParallelModule
+constexpr std::uint64_t kMaxBytes = 256 << 20;
+constexpr const char *kModuleName = "object_cache_bench";
+
+// A standard library that every run loads in full before doing anything
+std::string generateLibrary() {
+    std::string text;
+    for (int i = 0; i < kFunctions; ++i) {
+        const std::string n = std::to_string(i);
+        text += "def lib" + n + "(a b c) (a + " + n + ".25) * (b - c) + (a < b) * (c * c - a * " + n +
+                ") + (b + c) * (a - " + n + ".5) * (a * b + c)";
+        if (i > 0) {
+            text += " + lib" + std::to_string(i / 2) + "(a, c, b)";
+        }
+        text += ";\n";
+    }
+    return text;
+}
+
+const std::string &library() {
+    static const std::string text = generateLibrary();
+    return text;
+}
+
+enum class Cache {
+    None,
+    Cold,  // empty directory
+    Warm,  // filled by an earlier run
+};
+
+// Startup of the driver: an empty JIT until the whole library is compiled, in modules of kFunctionsPerModule
+// functions
+void loadLibrary(ObjectCacheDirectory *cacheDirectory) {
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create(false, 1, cacheDirectory).moveInto(jit));
+
+    LLVMContextData ctxData;
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+
+    Lexer lexer{std::make_unique<StringSource>(library())};
+    Parser parser{lexer};
+    parser.start();
+
+    const auto handOver = [&] {
+        ctxData.exportFunctions();
+        llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+        ctxData.startModule(kModuleName, jit->getDataLayout());
+    };
+
+    std::vector<std::string> names;
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto func = parser.parseDefinition();
+        names.emplace_back(func->m_prototype.getName().str());
+        func->codegen(ctxData);
+        parser.recycle(*func);
+
+        if (names.size() % kFunctionsPerModule == 0) {
+            handOver();
+        }
+    }
+    handOver();
+
+    llvm::ExitOnError{}(jit->materialize(names));
+}
+
+void objectCacheBenchmark(bench::State &state, Cache cache) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "kaleidoscope_object_cache_bench";
+    std::filesystem::remove_all(path);
+
+    ObjectCacheDirectory::Stats last;
+    state.measure([&] {
+        if (cache == Cache::Cold) {
+            std::filesystem::remove_all(path);
+        }
+
+        std::unique_ptr<ObjectCacheDirectory> cacheDirectory;
+        if (cache != Cache::None) {
+            cacheDirectory = ObjectCacheDirectory::open(path.string(), kMaxBytes);
+        }
+
+        loadLibrary(cacheDirectory.get());
+
+        if (cacheDirectory) {
+            last = cacheDirectory->stats();
+        }
+    });
+
+    std::filesystem::remove_all(path);
+
+    state.setCounter("functions", kFunctions);
+    state.setCounter("hits", last.m_hits);
+    state.setCounter("misses", last.m_misses);
+    state.setCounter("cache-kb", last.m_bytes / 1024.0);
+}
+
+BENCHMARK("startup/2k-defs/no-cache", [](bench::State &state) { objectCacheBenchmark(state, Cache::None); });
+BENCHMARK("startup/2k-defs/cold-cache", [](bench::State &state) { objectCacheBenchmark(state, Cache::Cold); });
+BENCHMARK("startup/2k-defs/warm-cache", [](bench::State &state) { objectCacheBenchmark(state, Cache::Warm); });
+
+}  // namespace
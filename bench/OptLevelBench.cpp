@@ -0,0 +1,137 @@
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr const char *kModuleName = "opt_level_bench";
+constexpr const char *kEntry = "run";
+
+// The language has no conditionals, so recursion cannot stop by itself: every level of the recursion is a function
+// of its own instead, which gives the same call trees.
+
+// fib: fibN(x) = fibN-1(x) + fibN-2(x), 2 * fib(N) - 1 calls
+std::string generateFib(int depth) {
+    std::string text = "def fib0(x) x;\ndef fib1(x) x + 1;\n";
+    for (int i = 2; i <= depth; ++i) {
+        const std::string n = std::to_string(i);
+        text += "def fib" + n + "(x) fib" + std::to_string(i - 1) + "(x) + fib" + std::to_string(i - 2) + "(x);\n";
+    }
+    return text + "def run(x) fib" + std::to_string(depth) + "(x);\n";
+}
+
+// Numeric integration of f over [a, a + h] by bisection, 2^depth evaluations of f at the midpoints
+std::string generateIntegration(int depth) {
+    std::string text = "def f(x) x * x * x - 2 * x * x + 3 * x + 1;\n"
+                       "def integrate0(a h) f(a + h * 0.5) * h;\n";
+    for (int i = 1; i <= depth; ++i) {
+        const std::string previous = "integrate" + std::to_string(i - 1);
+        text += "def integrate" + std::to_string(i) + "(a h) " + previous + "(a, h * 0.5) + " + previous +
+                "(a + h * 0.5, h * 0.5);\n";
+    }
+    return text + "def run(x) integrate" + std::to_string(depth) + "(x, 1);\n";
+}
+
+struct Timings {
+    double m_compile = 0;  // codegen, optimization and machine code, until `run` can be called
+    double m_run = 0;
+    double m_result = 0;
+};
+
+// The driver's batch path at the given level, without the JIT's own threads
+Timings compileAndRun(const std::string &program, OptLevel level) {
+    const auto secondsSince = [](auto from) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+
+    LLVMContextData ctxData{std::make_shared<ExportedFunctions>(), level};
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+
+    Lexer lexer{std::make_unique<StringSource>(program)};
+    Parser parser{lexer};
+    parser.start();
+
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto func = parser.parseDefinition();
+        func->codegen(ctxData);
+        parser.recycle(*func);
+    }
+
+    // Where the driver's optimizer runs, right before the module is compiled
+    if (isModuleLevel(level)) {
+        ctxData.m_llvmOpt.optimize(*ctxData.m_llvmModule);
+    }
+    llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+
+    auto entrySymbol = llvm::ExitOnError{}(jit->lookup(kEntry));
+    double (*entry)(double) = entrySymbol.getAddress().toPtr<double (*)(double)>();
+
+    Timings timings;
+    timings.m_compile = secondsSince(start);
+
+    const auto run = std::chrono::steady_clock::now();
+    timings.m_result = entry(0.25);
+    timings.m_run = secondsSince(run);
+
+    return timings;
+}
+
+void optLevelBenchmark(bench::State &state, const std::string &program, OptLevel level) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    Timings best;
+    state.measure([&] {
+        const Timings timings = compileAndRun(program, level);
+        if (best.m_compile == 0 || timings.m_compile + timings.m_run < best.m_compile + best.m_run) {
+            best = timings;
+        }
+    });
+
+    state.setCounter("compile-ms", best.m_compile * 1e3);
+    state.setCounter("run-ms", best.m_run * 1e3);
+    state.setCounter("result", best.m_result);
+}
+
+void fibBenchmark(bench::State &state, OptLevel level) {
+    static const std::string program = generateFib(27);
+    optLevelBenchmark(state, program, level);
+}
+
+void integrationBenchmark(bench::State &state, OptLevel level) {
+    static const std::string program = generateIntegration(20);
+    optLevelBenchmark(state, program, level);
+}
+
+BENCHMARK("opt/fib-27/Ofunction", [](bench::State &state) { fibBenchmark(state, OptLevel::Function); });
+BENCHMARK("opt/fib-27/O0", [](bench::State &state) { fibBenchmark(state, OptLevel::O0); });
+BENCHMARK("opt/fib-27/O1", [](bench::State &state) { fibBenchmark(state, OptLevel::O1); });
+BENCHMARK("opt/fib-27/O2", [](bench::State &state) { fibBenchmark(state, OptLevel::O2); });
+BENCHMARK("opt/fib-27/O3", [](bench::State &state) { fibBenchmark(state, OptLevel::O3); });
+
+BENCHMARK("opt/integrate-2^20/Ofunction", [](bench::State &state) { integrationBenchmark(state, OptLevel::Function); });
+BENCHMARK("opt/integrate-2^20/O0", [](bench::State &state) { integrationBenchmark(state, OptLevel::O0); });
+BENCHMARK("opt/integrate-2^20/O1", [](bench::State &state) { integrationBenchmark(state, OptLevel::O1); });
+BENCHMARK("opt/integrate-2^20/O2", [](bench::State &state) { integrationBenchmark(state, OptLevel::O2); });
+BENCHMARK("opt/integrate-2^20/O3", [](bench::State &state) { integrationBenchmark(state, OptLevel::O3); });
+
+}  // namespace
@@ -0,0 +1,102 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "ConstantFolder.hpp"
+#include "LLVMContextData.hpp"
+#include "ParallelFrontEnd.hpp"
+
+// The parallel front end of batch mode(--parse-threads) over a program of a few megabytes: the pre-scan on its own,
+// then splitting, lexing, parsing, merging and codegen(with the function-level pipeline) on 1 to 16 threads. Scaling
+// is bounded by the cores of the machine and by the merge, which runs on one thread.
+namespace {
+
+constexpr int kFunctions = 24000;
+constexpr const char *kModuleName = "parallel_front_end_bench";
+constexpr const char *kExpressionPrefix = "__anon_expr";
+
+// Definitions calling earlier ones(most of them in other pieces), with a comment, an extern or a top-level expression
+// now and then
+std::string generateProgram() {
+    std::string text = "extern sin(x);\n";
+    for (int i = 0; i < kFunctions; ++i) {
+        const std::string n = std::to_string(i);
+        if (i % 16 == 0) {
+            text += "# block " + n + ": polynomials of the arguments; def and extern in comments do not start items\n";
+        }
+
+        text += "def f" + n + "(alpha beta gamma)\n    alpha * " + n + ".25 + beta * (gamma - " + n +
+                ") < alpha * (beta + gamma * 0.5) - gamma";
+        if (i > 0) {
+            text += " + f" + std::to_string(i / 2) + "(beta, gamma, alpha)";
+        }
+        if (i % 64 == 0) {
+            text += " + sin(alpha)";
+        }
+        text += ";\n";
+
+        if (i % 256 == 255) {
+            text += "f" + n + "(1.5, 2, " + n + ".75);\n";
+        }
+    }
+    return text;
+}
+
+const std::string &program() {
+    static const std::string text = generateProgram();
+    return text;
+}
+
+void splitBenchmark(bench::State &state) {
+    std::size_t pieces = 0;
+    state.measure([&pieces] { pieces = ParallelFrontEnd::split(program(), 16).size(); });
+
+    // Only the neighbourhood of every split point is scanned, not the program
+    state.setCounter("pieces", static_cast<double>(pieces));
+}
+
+void frontEndBenchmark(bench::State &state, std::size_t threads) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    const llvm::DataLayout dataLayout{""};
+
+    std::unique_ptr<ConstantFolder> folder;
+    std::vector<std::unique_ptr<LLVMContextData>> contexts;
+    std::vector<TopLevelExpression> expressions;
+
+    // Fresh contexts every run, the modules of the previous one are thrown away
+    const auto setup = [&] {
+        folder = std::make_unique<ConstantFolder>();
+        expressions.clear();
+
+        contexts.clear();
+        const auto exportedFunctions = std::make_shared<ExportedFunctions>();
+        for (std::size_t i = 0; i < threads; ++i) {
+            contexts.push_back(std::make_unique<LLVMContextData>(exportedFunctions));
+            contexts.back()->startModule(kModuleName, dataLayout);
+        }
+    };
+
+    int errors = 0;
+    state.measure(setup, [&] {
+        errors = ParallelFrontEnd{*folder, kExpressionPrefix}.compile(program(), contexts, expressions);
+    });
+
+    state.setBytesProcessed(program().size());
+    state.setCounter("functions/s", kFunctions / state.seconds());
+    state.setCounter("errors", errors);
+}
+
+BENCHMARK("frontend/split", splitBenchmark);
+BENCHMARK("frontend/parse+codegen/threads=1", [](bench::State &state) { frontEndBenchmark(state, 1); });
+BENCHMARK("frontend/parse+codegen/threads=2", [](bench::State &state) { frontEndBenchmark(state, 2); });
+BENCHMARK("frontend/parse+codegen/threads=4", [](bench::State &state) { frontEndBenchmark(state, 4); });
+BENCHMARK("frontend/parse+codegen/threads=8", [](bench::State &state) { frontEndBenchmark(state, 8); });
+BENCHMARK("frontend/parse+codegen/threads=16", [](bench::State &state) { frontEndBenchmark(state, 16); });
+
+}  // namespace
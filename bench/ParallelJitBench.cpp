@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr int kFunctions = 4000;
+constexpr int kFunctionsPerModule = 64;  // Driver::kItemsPerParallelModule
+constexpr const char *kModuleName = "parallel_jit_bench";
+
+// Independent functions with bodies big enough for the backend to dominate, some of them calling earlier ones
+std::string generateProgram() {
+    std::string text;
+    for (int i = 0; i < kFunctions; ++i) {
+        const std::string n = std::to_string(i);
+        text += "def g" + n + "(a b c) (a + " + n + ".25) * (b - c) + (a < b) * (c * c - a * " + n + ") + (b + c) * (a - " +
+                n + ".5) * (a * b + c)";
+        if (i > 0) {
+            text += " + g" + std::to_string(i / 2) + "(a, c, b)";
+        }
+        text += ";\n";
+    }
+    return text;
+}
+
+const std::string &program() {
+    static const std::string text = generateProgram();
+    return text;
+}
+
+// Generates and compiles the whole program; with `threads` == 0 as a single module on the main thread(the batch
+// driver without --jit-threads), otherwise in modules of kFunctionsPerModule functions spread over `threads` contexts
+// and compiled by as many worker threads(threads == 1: split, but compiled on the main thread)
+void compileProgram(unsigned threads) {
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create(false, threads).moveInto(jit));
+
+    const auto exportedFunctions = std::make_shared<ExportedFunctions>();
+    std::vector<std::unique_ptr<LLVMContextData>> contexts;
+    for (unsigned i = 0; i < std::max(threads, 1u); ++i) {
+        contexts.push_back(std::make_unique<LLVMContextData>(exportedFunctions));
+        contexts.back()->startModule(kModuleName, jit->getDataLayout());
+    }
+
+    Lexer lexer{std::make_unique<StringSource>(program())};
+    Parser parser{lexer};
+    parser.start();
+
+    const auto handOver = [&](LLVMContextData &ctxData) {
+        ctxData.exportFunctions();
+        llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+        ctxData.startModule(kModuleName, jit->getDataLayout());
+    };
+
+    std::vector<std::string> names;
+    for (std::size_t current = 0; parser.peekTopLevel() != Parser::TopLevel::EndOfInput;) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        LLVMContextData &ctxData = *contexts[current];
+        const auto func = parser.parseDefinition();
+        names.emplace_back(func->m_prototype.getName().str());
+        func->codegen(ctxData);
+        parser.recycle(*func);
+
+        if (threads > 0 && names.size() % kFunctionsPerModule == 0) {
+            handOver(ctxData);
+            current = (current + 1) % contexts.size();
+        }
+    }
+
+    for (const auto &ctxData : contexts) {
+        handOver(*ctxData);
+    }
+
+    llvm::ExitOnError{}(jit->materialize(names));
+}
+
+void parallelJitBenchmark(bench::State &state, unsigned threads) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    state.measure([threads] { compileProgram(threads); });
+
+    state.setCounter("functions", kFunctions);
+    state.setCounter("functions/s", kFunctions / state.seconds());
+}
+
+BENCHMARK("jit/compile-4k/single-module", [](bench::State &state) { parallelJitBenchmark(state, 0); });
+BENCHMARK("jit/compile-4k/split/threads=1", [](bench::State &state) { parallelJitBenchmark(state, 1); });
+BENCHMARK("jit/compile-4k/split/threads=2", [](bench::State &state) { parallelJitBenchmark(state, 2); });
+BENCHMARK("jit/compile-4k/split/threads=4", [](bench::State &state) { parallelJitBenchmark(state, 4); });
+BENCHMARK("jit/compile-4k/split/threads=8", [](bench::State &state) { parallelJitBenchmark(state, 8); });
+
+}  // namespace
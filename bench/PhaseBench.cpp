@@ -0,0 +1,240 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "ProgramGenerator.hpp"
+
+// Every phase of the compiler on its own, over the generated programs of every shape: lexing, parsing, codegen, the
+// optimization pipelines, the JIT(addModule + lookup) and running the compiled code. Each benchmark times its phase
+// only, the phases before it are run in the untimed setup.
+namespace {
+
+constexpr const char *kModuleName = "phase_bench";
+constexpr const char *kEntry = "run";
+constexpr double kEntryArgument = 0.5;
+
+using bench::Shape;
+
+const std::string &program(Shape shape) {
+    static const std::string programs[] = {
+        bench::ProgramGenerator{}.generate(Shape::DeepExpressions),
+        bench::ProgramGenerator{}.generate(Shape::ManyFunctions),
+        bench::ProgramGenerator{}.generate(Shape::WideCalls),
+        bench::ProgramGenerator{}.generate(Shape::Recursion),
+    };
+    return programs[static_cast<int>(shape)];
+}
+
+// The host target, for the target machines and the JIT
+void initializeTarget() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+}
+
+// The definitions of `text`, the generated programs have nothing else
+std::vector<std::unique_ptr<FunctionAST>> parseProgram(const std::string &text) {
+    Lexer lexer{std::make_unique<StringSource>(text)};
+    Parser parser{lexer};
+    parser.start();
+
+    std::vector<std::unique_ptr<FunctionAST>> functions;
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() == Parser::TopLevel::Definition) {
+            functions.push_back(parser.parseDefinition());
+        } else {
+            parser.skipSeparator();
+        }
+    }
+    return functions;
+}
+
+// A fresh module in `ctxData` holding all of `functions`
+void generateModule(LLVMContextData &ctxData, const llvm::DataLayout &dataLayout,
+                    const std::vector<std::unique_ptr<FunctionAST>> &functions) {
+    ctxData.startModule(kModuleName, dataLayout);
+    for (const auto &func : functions) {
+        func->codegen(ctxData);
+    }
+}
+
+void lexBenchmark(bench::State &state, Shape shape) {
+    const std::string &text = program(shape);
+
+    std::size_t tokens = 0;
+    state.measure([&] {
+        Lexer lexer{std::make_unique<StringSource>(text)};
+        tokens = 0;
+        while (lexer.getNextToken().m_token != Token::TOK_EOF) {
+            ++tokens;
+        }
+    });
+
+    state.setBytesProcessed(text.size());
+    state.setCounter("tokens", static_cast<double>(tokens));
+    state.setCounter("ns/token", state.seconds() * 1e9 / static_cast<double>(tokens));
+}
+
+void parseBenchmark(bench::State &state, Shape shape) {
+    const std::string &text = program(shape);
+
+    std::size_t functions = 0;
+    state.measure([&] { functions = parseProgram(text).size(); });
+
+    state.setBytesProcessed(text.size());
+    state.setCounter("functions", static_cast<double>(functions));
+    state.setCounter("us/function", state.seconds() * 1e6 / static_cast<double>(functions));
+}
+
+void codegenBenchmark(bench::State &state, Shape shape) {
+    initializeTarget();
+    const auto functions = parseProgram(program(shape));
+
+    // A module level that is never run: codegen alone
+    LLVMContextData ctxData{std::make_shared<ExportedFunctions>(), OptLevel::O0};
+    const llvm::DataLayout dataLayout = ctxData.m_targetMachine->createDataLayout();
+
+    state.measure([&] { generateModule(ctxData, dataLayout, functions); });
+
+    state.setCounter("instructions", static_cast<double>(ctxData.m_llvmModule->getInstructionCount()));
+    state.setCounter("us/function", state.seconds() * 1e6 / static_cast<double>(functions.size()));
+}
+
+void optimizeBenchmark(bench::State &state, Shape shape, OptLevel level) {
+    initializeTarget();
+    const auto functions = parseProgram(program(shape));
+
+    LLVMContextData ctxData{std::make_shared<ExportedFunctions>(), level, createHostTargetMachine(level)};
+    ctxData.m_optimizeFunctions = false;
+    const llvm::DataLayout dataLayout = ctxData.m_targetMachine->createDataLayout();
+
+    state.measure([&] { generateModule(ctxData, dataLayout, functions); },
+                  [&] { ctxData.m_llvmOpt.optimize(*ctxData.m_llvmModule); });
+
+    state.setCounter("instructions-after", static_cast<double>(ctxData.m_llvmModule->getInstructionCount()));
+    state.setCounter("us/function", state.seconds() * 1e6 / static_cast<double>(functions.size()));
+}
+
+// The module as the default driver hands it over(optimized function by function), compiled by a fresh JIT
+void jitBenchmark(bench::State &state, Shape shape) {
+    initializeTarget();
+    const auto functions = parseProgram(program(shape));
+
+    LLVMContextData ctxData;
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+
+    double (*entry)(double) = nullptr;
+    state.measure(
+        [&] {
+            jit.reset();
+            llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+            generateModule(ctxData, jit->getDataLayout(), functions);
+        },
+        [&] {
+            llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+            entry = llvm::ExitOnError{}(jit->lookup(kEntry)).getAddress().toPtr<double (*)(double)>();
+        });
+
+    state.setCounter("us/function", state.seconds() * 1e6 / static_cast<double>(functions.size()));
+    state.setCounter("result", entry(kEntryArgument));
+}
+
+void executeBenchmark(bench::State &state, Shape shape) {
+    initializeTarget();
+    const auto functions = parseProgram(program(shape));
+
+    LLVMContextData ctxData;
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+    generateModule(ctxData, jit->getDataLayout(), functions);
+    llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+
+    double (*const entry)(double) =
+        llvm::ExitOnError{}(jit->lookup(kEntry)).getAddress().toPtr<double (*)(double)>();
+
+    double result = 0;
+    state.measure([&] { result = entry(kEntryArgument); });
+
+    state.setCounter("us/run", state.seconds() * 1e6);
+    state.setCounter("result", result);
+}
+
+// The benchmark functions of a shape, for BENCHMARK()
+template <Shape shape>
+void lex(bench::State &state) {
+    lexBenchmark(state, shape);
+}
+
+template <Shape shape>
+void parse(bench::State &state) {
+    parseBenchmark(state, shape);
+}
+
+template <Shape shape>
+void codegen(bench::State &state) {
+    codegenBenchmark(state, shape);
+}
+
+template <Shape shape>
+void optimizeFunction(bench::State &state) {
+    optimizeBenchmark(state, shape, OptLevel::Function);
+}
+
+template <Shape shape>
+void optimizeO2(bench::State &state) {
+    optimizeBenchmark(state, shape, OptLevel::O2);
+}
+
+template <Shape shape>
+void jit(bench::State &state) {
+    jitBenchmark(state, shape);
+}
+
+template <Shape shape>
+void execute(bench::State &state) {
+    executeBenchmark(state, shape);
+}
+
+BENCHMARK("phase/lex/deep-expressions", lex<Shape::DeepExpressions>);
+BENCHMARK("phase/lex/many-functions", lex<Shape::ManyFunctions>);
+BENCHMARK("phase/lex/wide-calls", lex<Shape::WideCalls>);
+BENCHMARK("phase/lex/recursion", lex<Shape::Recursion>);
+
+BENCHMARK("phase/parse/deep-expressions", parse<Shape::DeepExpressions>);
+BENCHMARK("phase/parse/many-functions", parse<Shape::ManyFunctions>);
+BENCHMARK("phase/parse/wide-calls", parse<Shape::WideCalls>);
+BENCHMARK("phase/parse/recursion", parse<Shape::Recursion>);
+
+BENCHMARK("phase/codegen/deep-expressions", codegen<Shape::DeepExpressions>);
+BENCHMARK("phase/codegen/many-functions", codegen<Shape::ManyFunctions>);
+BENCHMARK("phase/codegen/wide-calls", codegen<Shape::WideCalls>);
+BENCHMARK("phase/codegen/recursion", codegen<Shape::Recursion>);
+
+BENCHMARK("phase/optimize-function/deep-expressions", optimizeFunction<Shape::DeepExpressions>);
+BENCHMARK("phase/optimize-function/many-functions", optimizeFunction<Shape::ManyFunctions>);
+BENCHMARK("phase/optimize-function/wide-calls", optimizeFunction<Shape::WideCalls>);
+BENCHMARK("phase/optimize-function/recursion", optimizeFunction<Shape::Recursion>);
+
+BENCHMARK("phase/optimize-O2/deep-expressions", optimizeO2<Shape::DeepExpressions>);
+BENCHMARK("phase/optimize-O2/many-functions", optimizeO2<Shape::ManyFunctions>);
+BENCHMARK("phase/optimize-O2/wide-calls", optimizeO2<Shape::WideCalls>);
+BENCHMARK("phase/optimize-O2/recursion", optimizeO2<Shape::Recursion>);
+
+BENCHMARK("phase/jit/deep-expressions", jit<Shape::DeepExpressions>);
+BENCHMARK("phase/jit/many-functions", jit<Shape::ManyFunctions>);
+BENCHMARK("phase/jit/wide-calls", jit<Shape::WideCalls>);
+BENCHMARK("phase/jit/recursion", jit<Shape::Recursion>);
+
+BENCHMARK("phase/execute/deep-expressions", execute<Shape::DeepExpressions>);
+BENCHMARK("phase/execute/many-functions", execute<Shape::ManyFunctions>);
+BENCHMARK("phase/execute/wide-calls", execute<Shape::WideCalls>);
+BENCHMARK("phase/execute/recursion", execute<Shape::Recursion>);
+
+}  // namespace
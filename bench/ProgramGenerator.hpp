@@ -0,0 +1,186 @@
+#ifndef _PROGRAM_GENERATOR_HPP_
+#define _PROGRAM_GENERATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace bench {
+
+// Kinds of generated programs, every one of them stresses the phases differently
+enum class Shape {
+    // Few functions with big, deeply nested expression bodies
+    DeepExpressions,
+
+    // Thousands of small functions, each calling an earlier one
+    ManyFunctions,
+
+    // Functions of many parameters, called with an expression per argument
+    WideCalls,
+
+    // Recursion unrolled into a function per level(the language has no conditionals, a function calling itself would
+    // never return): level i calls levels i - 1 and i - 2, fib(depth) calls in all
+    Recursion,
+};
+
+constexpr const char *shapeName(Shape shape) {
+    switch (shape) {
+        case Shape::DeepExpressions:
+            return "deep-expressions";
+        case Shape::ManyFunctions:
+            return "many-functions";
+        case Shape::WideCalls:
+            return "wide-calls";
+        case Shape::Recursion:
+            return "recursion";
+    }
+    return "";
+}
+
+// Generates the same program for the same shape and seed on every platform: only the raw output of mt19937_64 is used,
+// which the standard pins down, and not the distributions, which it does not. Every program defines `run(x)`, the
+// entry point that exercises all of it.
+class ProgramGenerator {
+    static constexpr int kDeepFunctions = 64;
+    static constexpr int kDeepDepth = 9;
+
+    static constexpr int kManyFunctions = 2000;
+
+    static constexpr int kWideFunctions = 200;
+    static constexpr int kWideArity = 12;
+
+    static constexpr int kRecursionDepth = 22;
+
+public:
+    static constexpr std::uint64_t kDefaultSeed = 0x6b616c6569646f;
+
+    explicit ProgramGenerator(std::uint64_t seed = kDefaultSeed)
+        : m_rng(seed) {
+    }
+
+    std::string generate(Shape shape) {
+        switch (shape) {
+            case Shape::DeepExpressions:
+                return deepExpressions();
+            case Shape::ManyFunctions:
+                return manyFunctions();
+            case Shape::WideCalls:
+                return wideCalls();
+            case Shape::Recursion:
+                return recursion();
+        }
+        return {};
+    }
+
+private:
+    // Uniform enough in [0, bound) for bounds this small
+    std::uint64_t pick(std::uint64_t bound) {
+        return m_rng() % bound;
+    }
+
+    // A small constant with two decimals, so that values stay finite for a while
+    std::string constant() {
+        const std::uint64_t whole = pick(4);
+        return std::to_string(whole) + '.' + std::to_string(pick(100));
+    }
+
+    // A random expression tree of `depth` levels over `variables`
+    std::string expression(int depth, const std::string *variables, std::size_t count) {
+        if (depth == 0 || pick(8) == 0) {
+            return pick(3) == 0 ? constant() : variables[pick(count)];
+        }
+
+        // One statement each, the operands of + are evaluated in any order
+        constexpr char kOperators[] = {'+', '-', '*', '<'};
+        const char op = kOperators[pick(sizeof(kOperators))];
+        const std::string lhs = expression(depth - 1, variables, count);
+        const std::string rhs = expression(depth - 1, variables, count);
+        return '(' + lhs + ' ' + op + ' ' + rhs + ')';
+    }
+
+    std::string deepExpressions() {
+        const std::string variables[] = {"x", "y", "z"};
+
+        std::string text;
+        std::string run = "def run(x) 0";
+        for (int i = 0; i < kDeepFunctions; ++i) {
+            const std::string name = "deep" + std::to_string(i);
+            text += "def " + name + "(x y z) " + expression(kDeepDepth, variables, 3) + ";\n";
+            run += " + " + name + "(x, x * 0.5, " + constant() + ")";
+        }
+        return text + run + ";\n";
+    }
+
+    std::string manyFunctions() {
+        const std::string variables[] = {"a", "b"};
+
+        std::string text;
+        for (int i = 0; i < kManyFunctions; ++i) {
+            text += "def small" + std::to_string(i) + "(a b) " + expression(2, variables, 2);
+            if (i > 0) {
+                // A chain back to small0, a call tree would grow exponentially
+                text += " + small" + std::to_string(pick(i)) + "(b, a * 0.5)";
+            }
+            text += ";\n";
+        }
+
+        std::string run = "def run(x) 0";
+        for (int i = kManyFunctions - 8; i < kManyFunctions; ++i) {
+            run += " + small" + std::to_string(i) + "(x, " + constant() + ")";
+        }
+        return text + run + ";\n";
+    }
+
+    std::string wideCalls() {
+        std::string parameters[kWideArity];
+        for (int p = 0; p < kWideArity; ++p) {
+            parameters[p] = "p" + std::to_string(p);
+        }
+
+        const auto arguments = [&] {
+            std::string list;
+            for (int p = 0; p < kWideArity; ++p) {
+                list += (p == 0 ? "" : ", ") + expression(2, parameters, kWideArity);
+            }
+            return list;
+        };
+
+        std::string text;
+        for (int i = 0; i < kWideFunctions; ++i) {
+            text += "def wide" + std::to_string(i) + '(';
+            for (int p = 0; p < kWideArity; ++p) {
+                text += (p == 0 ? "" : " ") + parameters[p];
+            }
+            text += ") " + expression(3, parameters, kWideArity);
+            if (i > 0) {
+                text += " + wide" + std::to_string(i - 1) + '(' + arguments() + ") * 0.5";
+            }
+            text += ";\n";
+        }
+
+        // run's only parameter stands in for all of them
+        std::string run = "def run(x) wide" + std::to_string(kWideFunctions - 1) + '(';
+        for (int p = 0; p < kWideArity; ++p) {
+            run += p == 0 ? std::string{"x"} : ", x * " + constant();
+        }
+        return text + run + ");\n";
+    }
+
+    std::string recursion() {
+        std::string text = "def level0(x) x;\ndef level1(x) x + 1;\n";
+        for (int i = 2; i <= kRecursionDepth; ++i) {
+            const std::string scale = constant();
+            const std::string offset = constant();
+            text += "def level" + std::to_string(i) + "(x) level" + std::to_string(i - 1) + "(x * " + scale +
+                    ") + level" + std::to_string(i - 2) + "(x - " + offset + ");\n";
+        }
+        return text + "def run(x) level" + std::to_string(kRecursionDepth) + "(x);\n";
+    }
+
+    std::mt19937_64 m_rng;
+};
+
+}  // namespace bench
+
+#endif  // !_PROGRAM_GENERATOR_HPP_
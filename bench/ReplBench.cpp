@@ -0,0 +1,104 @@
+#include <memory>
+#include <random>
+#include <string>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+namespace {
+
+constexpr int kExpressions = 2000;
+constexpr const char *kModuleName = "repl_bench";
+constexpr const char *kAnonExprIdentifier = "__anon_expr";
+
+// Short arithmetic the way it is typed at the prompt, one top-level expression per line
+std::string generateExpressions() {
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<int> pick{1, 99};
+
+    std::string text;
+    for (int i = 0; i < kExpressions; ++i) {
+        text += "(" + std::to_string(pick(rng)) + " + " + std::to_string(pick(rng)) + ".5) * " +
+                std::to_string(pick(rng)) + " - 4 < " + std::to_string(pick(rng)) + ";\n";
+    }
+    return text;
+}
+
+const std::string &expressions() {
+    static const std::string text = generateExpressions();
+    return text;
+}
+
+llvm::orc::KaleidoscopeJIT &jit() {
+    static const std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit = [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmParser();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+        llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+        return jit;
+    }();
+    return *jit;
+}
+
+// What the REPL does for every top-level expression: codegen into a module of its own, hand it to the JIT, run it
+// and free it again. With `reuseContext` unset every expression gets a brand new LLVMContextData(context, builder
+// and pass pipeline), which is how the REPL used to start each module.
+double evaluateAll(bool reuseContext) {
+    Lexer lexer{std::make_unique<StringSource>(expressions())};
+    Parser parser{lexer};
+    parser.start();
+
+    auto &kaleidoscopeJIT = jit();
+    const Symbol name = Symbol::intern(kAnonExprIdentifier);
+
+    auto ctxData = std::make_unique<LLVMContextData>();
+    ctxData->startModule(kModuleName, kaleidoscopeJIT.getDataLayout());
+
+    double sum = 0;
+    for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+        if (item != Parser::TopLevel::Expression) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto anonFunc = parser.parseTopLevelExpr(name);
+        anonFunc->codegen(*ctxData);
+        parser.recycle(*anonFunc);
+
+        auto resourceTracker = kaleidoscopeJIT.getMainJITDylib().createResourceTracker();
+        llvm::ExitOnError{}(kaleidoscopeJIT.addModule(ctxData->takeModule(), resourceTracker));
+
+        if (!reuseContext) {
+            ctxData = std::make_unique<LLVMContextData>();
+        }
+        ctxData->startModule(kModuleName, kaleidoscopeJIT.getDataLayout());
+
+        auto exprSymbol = llvm::ExitOnError{}(kaleidoscopeJIT.lookup(kAnonExprIdentifier));
+        sum += exprSymbol.getAddress().toPtr<double (*)()>()();
+
+        llvm::ExitOnError{}(resourceTracker->remove());
+    }
+
+    return sum;
+}
+
+void replBenchmark(bench::State &state, bool reuseContext) {
+    double sum = 0;
+    state.measure([&] { sum = evaluateAll(reuseContext); });
+
+    state.setCounter("expressions", kExpressions);
+    state.setCounter("us/expression", state.seconds() * 1e6 / kExpressions);
+    state.setCounter("sum", sum);
+}
+
+BENCHMARK("repl/context-per-module", [](bench::State &state) { replBenchmark(state, false); });
+BENCHMARK("repl/reused-context", [](bench::State &state) { replBenchmark(state, true); });
+
+}  // namespace
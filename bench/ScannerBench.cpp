@@ -0,0 +1,150 @@
+#include <charconv>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.hpp"
+#include "CharScanner.hpp"
+#include "Lexer.hpp"
+
+namespace {
+
+constexpr std::size_t kInputBytes = 4 * 1024 * 1024;
+
+// Deeply indented code with blank lines and wide alignment
+std::string generateWhitespaceHeavy() {
+    std::mt19937 rng{1};
+    std::uniform_int_distribution<int> width{4, 48};
+
+    std::string text;
+    for (int i = 0; text.size() < kInputBytes; ++i) {
+        text += "def f" + std::to_string(i) + "(x)\n\n";
+        text += std::string(width(rng), ' ') + "x" + std::string(width(rng), ' ') + "*\t\t" +
+                std::string(width(rng), ' ') + "2.5;\n\n\n";
+    }
+    return text;
+}
+
+// Long documentation comments between short definitions
+std::string generateCommentHeavy() {
+    std::mt19937 rng{2};
+    std::uniform_int_distribution<int> lines{2, 8};
+
+    std::string text;
+    for (int i = 0; text.size() < kInputBytes; ++i) {
+        for (int line = lines(rng); line > 0; --line) {
+            text += "# Computes the weighted score of the candidate; weights are tuned offline and must be kept in sync\n";
+        }
+        text += "def g" + std::to_string(i) + "(a b) a*b + 1;\n";
+    }
+    return text;
+}
+
+const std::string &whitespaceHeavy() {
+    static const std::string text = generateWhitespaceHeavy();
+    return text;
+}
+
+const std::string &commentHeavy() {
+    static const std::string text = generateCommentHeavy();
+    return text;
+}
+
+// Walks the input the way the lexer does, using only the run scanners
+std::size_t scanAll(const scan::Kernels &kernels, const std::string &text) {
+    const char *cur = text.data();
+    const char *end = cur + text.size();
+
+    std::size_t runs = 0;
+    while (cur != end) {
+        cur = kernels.m_skipSpaces(cur, end);
+        if (cur == end) {
+            break;
+        }
+
+        if (*cur == '#') {
+            cur = kernels.m_skipToLineEnd(cur, end);
+        } else if (scan::isIdentifierStart(*cur)) {
+            cur = kernels.m_skipIdentifier(cur, end);
+        } else if (scan::isDigit(*cur)) {
+            cur = kernels.m_skipDigits(cur, end);
+        } else {
+            ++cur;
+        }
+        ++runs;
+    }
+    return runs;
+}
+
+void registerScannerBenchmarks(const char *inputName, const std::string &(*input)()) {
+    for (const scan::Isa isa : {scan::Isa::Scalar, scan::Isa::SSE2, scan::Isa::AVX2}) {
+        const scan::Kernels *kernels = scan::kernelsFor(isa);
+        if (!kernels) {
+            continue;
+        }
+
+        bench::registry().push_back(bench::Benchmark{
+            std::string{"scanner/"} + inputName + "/" + scan::isaName(isa), [kernels, input](bench::State &state) {
+                std::size_t runs = 0;
+                state.measure([&] { runs = scanAll(*kernels, input()); });
+                state.setBytesProcessed(input().size());
+                state.setCounter("runs", static_cast<double>(runs));
+            }});
+    }
+
+    // The whole lexer with the kernels picked for this CPU
+    bench::registry().push_back(bench::Benchmark{
+        std::string{"scanner/"} + inputName + "/lexer", [input](bench::State &state) {
+            std::size_t tokens = 0;
+            state.measure([&] {
+                Lexer lexer{std::make_unique<StringSource>(input())};
+                for (tokens = 0; lexer.getNextToken().m_token != Token::TOK_EOF; ++tokens) {
+                }
+            });
+            state.setBytesProcessed(input().size());
+            state.setCounter("tokens", static_cast<double>(tokens));
+        }});
+}
+
+const std::vector<std::string> &numberLiterals() {
+    static const std::vector<std::string> literals = [] {
+        std::mt19937 rng{3};
+        std::uniform_int_distribution<int> integer{0, 100000};
+        std::uniform_int_distribution<int> fraction{0, 999};
+
+        std::vector<std::string> literals;
+        for (int i = 0; i < 1'000'000; ++i) {
+            literals.push_back(std::to_string(integer(rng)) + (i % 2 ? "." + std::to_string(fraction(rng)) : ""));
+        }
+        return literals;
+    }();
+    return literals;
+}
+
+template <bool FastPath>
+void parseNumbers(bench::State &state) {
+    double sum = 0;
+    state.measure([&sum] {
+        sum = 0;
+        for (const std::string &literal : numberLiterals()) {
+            double value = 0;
+            if (!FastPath || !scan::parseSimpleNumber(literal, value)) {
+                std::from_chars(literal.data(), literal.data() + literal.size(), value);
+            }
+            sum += value;
+        }
+    });
+    state.setCounter("literals", static_cast<double>(numberLiterals().size()));
+    state.setCounter("sum", sum);
+}
+
+const bool kRegistered = [] {
+    registerScannerBenchmarks("whitespace-heavy", whitespaceHeavy);
+    registerScannerBenchmarks("comment-heavy", commentHeavy);
+    return true;
+}();
+
+}  // namespace
+
+BENCHMARK("numbers/from_chars", parseNumbers<false>);
+BENCHMARK("numbers/fast-path", parseNumbers<true>);
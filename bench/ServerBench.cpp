@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Bench.hpp"
+#include "Server.hpp"
+
+// Load generator for the evaluation server(--serve): kClients sessions, a client thread each, connect to an in-process
+// server on a Unix domain socket, define a function of their own and send kRequests requests one at a time, each
+// waiting for its answer. Every request compiles and runs a top-level expression calling the session's function and
+// the preloaded library, which is compiled once per server. Reports the requests per second and the latencies against
+// 1 to 16 workers; the workers only scale up to the cores of the machine.
+namespace {
+
+constexpr int kClients = 16;
+constexpr int kRequests = 50;
+
+// Impure through sin(), so that no request folds
+constexpr const char *kLibrary = "extern sin(x);\n"
+                                 "def wave(x) sin(x) * 0.5 + x * x;\n"
+                                 "def mix(a b) wave(a) - wave(b) * 0.25 + a * b;\n";
+
+std::string socketPath() {
+    return "/tmp/kaleidoscope_bench_" + std::to_string(::getpid()) + ".sock";
+}
+
+// A connection to the server at `path`, -1 if there is none
+int connectTo(const std::string &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends `request`(a line) and waits for its answer, false unless it starts with "ok". `input` keeps what was read
+// past the answer.
+bool roundTrip(int fd, const std::string &request, std::string &input) {
+    for (std::size_t sent = 0; sent < request.size();) {
+        const ssize_t written = ::send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(written);
+    }
+
+    std::size_t end;
+    while ((end = input.find('\n')) == std::string::npos) {
+        char buffer[4096];
+        const ssize_t bytesRead = ::read(fd, buffer, sizeof(buffer));
+        if (bytesRead <= 0) {
+            return false;
+        }
+        input.append(buffer, static_cast<std::size_t>(bytesRead));
+    }
+
+    const bool ok = input.starts_with("ok");
+    input.erase(0, end + 1);
+    return ok;
+}
+
+// A session: the latency of every request in seconds, and the number of them that failed
+void runClient(const std::string &path, int client, std::vector<double> &latencies, int &errors) {
+    const int fd = connectTo(path);
+    if (fd < 0) {
+        errors += kRequests;
+        return;
+    }
+
+    std::string input;
+    const std::string definition = "def mine(a b) mix(a, b) * " + std::to_string(client) + " + wave(b);\n";
+    if (!roundTrip(fd, definition, input)) {
+        ++errors;
+    }
+
+    for (int i = 0; i < kRequests; ++i) {
+        const std::string request = "mine(" + std::to_string(i) + ", " + std::to_string(client) + ".5) + 1;\n";
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok = roundTrip(fd, request, input);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        latencies.push_back(elapsed.count());
+        errors += ok ? 0 : 1;
+    }
+    ::close(fd);
+}
+
+// The latency below which a `fraction` of `sorted` lies
+double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void serverBenchmark(bench::State &state, unsigned threads) {
+    const std::string path = socketPath();
+    const auto server = Server::open(path, threads, OptLevel::Function, kLibrary);
+    if (!server) {
+        return;
+    }
+    std::thread serving{[&server] { server->run(); }};
+
+    std::vector<std::vector<double>> latencies(kClients);
+    std::vector<int> errors(kClients);
+
+    // Fresh sessions every run, the latencies are those of the last one
+    const auto setup = [&] {
+        for (int i = 0; i < kClients; ++i) {
+            latencies[i].clear();
+            errors[i] = 0;
+        }
+    };
+
+    state.setIterations(3);
+    state.measure(setup, [&] {
+        std::vector<std::thread> clients;
+        for (int i = 0; i < kClients; ++i) {
+            clients.emplace_back(runClient, std::cref(path), i, std::ref(latencies[i]), std::ref(errors[i]));
+        }
+        for (std::thread &client : clients) {
+            client.join();
+        }
+    });
+
+    server->stop();
+    serving.join();
+
+    std::vector<double> sorted;
+    for (const std::vector<double> &clientLatencies : latencies) {
+        sorted.insert(sorted.end(), clientLatencies.begin(), clientLatencies.end());
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    int totalErrors = 0;
+    for (const int clientErrors : errors) {
+        totalErrors += clientErrors;
+    }
+
+    state.setCounter("requests/s", kClients * kRequests / state.seconds());
+    state.setCounter("p50 ms", percentile(sorted, 0.5) * 1e3);
+    state.setCounter("p99 ms", percentile(sorted, 0.99) * 1e3);
+    state.setCounter("errors", totalErrors);
+}
+
+BENCHMARK("server/requests/threads=1", [](bench::State &state) { serverBenchmark(state, 1); });
+BENCHMARK("server/requests/threads=2", [](bench::State &state) { serverBenchmark(state, 2); });
+BENCHMARK("server/requests/threads=4", [](bench::State &state) { serverBenchmark(state, 4); });
+BENCHMARK("server/requests/threads=8", [](bench::State &state) { serverBenchmark(state, 8); });
+BENCHMARK("server/requests/threads=16", [](bench::State &state) { serverBenchmark(state, 16); });
+
+}  // namespace
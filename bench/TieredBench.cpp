@@ -0,0 +1,131 @@
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "llvm/Support/TargetSelect.h"
+
+#include "Bench.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "TieredCompiler.hpp"
+
+namespace {
+
+constexpr int kCalls = 2'000'000;
+constexpr std::uint64_t kThreshold = 1000;  // Options::m_tierThreshold
+constexpr const char *kModuleName = "tiered_bench";
+constexpr const char *kKernel = "kernel";
+
+// Small helpers behind a kernel, the inlining tier 1 does across them is where most of the gain comes from
+constexpr const char *kProgram = "def sq(x) x * x;\n"
+                                 "def poly(x) sq(x) * 0.5 + sq(x + 1) * 0.25 - x * 3 + 1;\n"
+                                 "def kernel(x) poly(x) + poly(x * 0.5) - sq(poly(x - 1)) * 0.001;\n";
+constexpr std::size_t kTieredFunctions = 3;
+
+enum class Mode {
+    Eager,      // optimized codegen, the default driver
+    Tier0Only,  // tiered, never hot
+    Tiered,
+};
+
+struct Timings {
+    double m_firstCall = 0;  // from an empty JIT until the first call returned
+    double m_promotion = 0;  // from the first call until all functions run at tier 1
+    double m_perCall = 0;    // steady state
+    double m_sum = 0;
+};
+
+Timings runKernel(Mode mode) {
+    const auto secondsSince = [](auto from) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - from).count();
+    };
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit;
+    llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(jit));
+
+    std::unique_ptr<TieredCompiler> tiered;
+    if (mode != Mode::Eager) {
+        tiered = std::make_unique<TieredCompiler>(
+            *jit, mode == Mode::Tiered ? kThreshold : std::numeric_limits<std::uint64_t>::max());
+    }
+
+    LLVMContextData ctxData;
+    ctxData.m_optimizeFunctions = mode == Mode::Eager;
+    ctxData.startModule(kModuleName, jit->getDataLayout());
+
+    Lexer lexer{std::make_unique<StringSource>(kProgram)};
+    Parser parser{lexer};
+    parser.start();
+
+    while (parser.peekTopLevel() != Parser::TopLevel::EndOfInput) {
+        if (parser.peekTopLevel() != Parser::TopLevel::Definition) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        const auto func = parser.parseDefinition();
+        func->codegen(ctxData);
+        parser.recycle(*func);
+    }
+
+    if (tiered) {
+        llvm::ExitOnError{}(tiered->addModule(ctxData.takeModule()));
+    } else {
+        llvm::ExitOnError{}(jit->addModule(ctxData.takeModule()));
+    }
+
+    auto kernelSymbol = llvm::ExitOnError{}(jit->lookup(kKernel));
+    double (*kernel)(double) = kernelSymbol.getAddress().toPtr<double (*)(double)>();
+
+    Timings timings;
+    timings.m_sum += kernel(0.5);
+    timings.m_firstCall = secondsSince(start);
+
+    // Tiered: calls go on at tier 0 until the background thread switches the stubs over
+    const auto warmUp = std::chrono::steady_clock::now();
+    for (int i = 1; mode == Mode::Tiered && tiered->promotedFunctions() < kTieredFunctions; ++i) {
+        timings.m_sum += kernel(i * 1e-3);
+        if (i % 1024 == 0) {
+            std::this_thread::yield();
+        }
+    }
+    timings.m_promotion = secondsSince(warmUp);
+
+    const auto steady = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCalls; ++i) {
+        timings.m_sum += kernel(i * 1e-3);
+    }
+    timings.m_perCall = secondsSince(steady) / kCalls;
+
+    return timings;
+}
+
+void kernelBenchmark(bench::State &state, Mode mode) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    Timings best;
+    state.measure([&] {
+        const Timings timings = runKernel(mode);
+        if (best.m_perCall == 0 || timings.m_perCall < best.m_perCall) {
+            best = timings;
+        }
+    });
+
+    state.setCounter("first-call-ms", best.m_firstCall * 1e3);
+    state.setCounter("promotion-ms", best.m_promotion * 1e3);
+    state.setCounter("ns/call", best.m_perCall * 1e9);
+    state.setCounter("sum", best.m_sum);
+}
+
+BENCHMARK("jit/kernel/eager", [](bench::State &state) { kernelBenchmark(state, Mode::Eager); });
+BENCHMARK("jit/kernel/tier0-only", [](bench::State &state) { kernelBenchmark(state, Mode::Tier0Only); });
+BENCHMARK("jit/kernel/tiered", [](bench::State &state) { kernelBenchmark(state, Mode::Tiered); });
+
+}  // namespace
@@ -0,0 +1,58 @@
+#ifndef _AOT_COMPILER_HPP_
+#define _AOT_COMPILER_HPP_
+
+#include "LLVMContextData.hpp"
+#include "Options.hpp"
+#include "Parser.hpp"
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <memory>
+#include <string>
+
+// Ahead-of-time compilation: the whole input becomes one object file(or a static library holding it) for the host or
+// the target given on the command line, together with a C header declaring its functions. Every Kaleidoscope function
+// is a plain C function `double name(double, ...)`, externs are left for the linker to resolve. Nothing is run,
+// top-level expressions are skipped. With --batch-entries the batch entry points are compiled and declared as well.
+class AotCompiler {
+    static constexpr const char *kModuleName = "Kaleidoscope goes native";
+
+public:
+    AotCompiler(Lexer &lexer, const Options &options);
+    AotCompiler(const AotCompiler &) = delete;
+    AotCompiler &operator=(const AotCompiler &) = delete;
+    AotCompiler(AotCompiler &&) = delete;
+    AotCompiler &operator=(AotCompiler &&) = delete;
+    ~AotCompiler() = default;
+
+    // Compiles the input and writes the outputs. Returns the number of items that failed to parse or compile, or
+    // of outputs that could not be written.
+    int run();
+
+private:
+    // The target machine to compile for, configured from the options
+    llvm::Expected<std::unique_ptr<llvm::TargetMachine>> createTargetMachine() const;
+
+    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> emitObject();
+
+    llvm::Error writeFile(const std::string &path, llvm::StringRef contents) const;
+    llvm::Error writeLibrary(const std::string &path, llvm::MemoryBufferRef object) const;
+
+    // C declarations of the functions defined in the module, for a header named `fileName`
+    std::string generateHeader(const std::string &fileName) const;
+
+    // The header next to `output`, unless one was given
+    std::string headerPath(const std::string &output) const;
+
+    Parser m_parser;
+    const Options &m_options;
+
+    // --pass-profile only, outlives the pipeline of m_ctxData
+    std::unique_ptr<PassProfiler> m_passProfiler;
+
+    std::unique_ptr<LLVMContextData> m_ctxData;
+};
+
+#endif  // !_AOT_COMPILER_HPP_
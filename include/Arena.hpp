@@ -0,0 +1,135 @@
+#ifndef _ARENA_HPP_
+#define _ARENA_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator. Objects are carved out of large blocks and are never destroyed one by one; reset() releases
+// everything allocated so far in O(1) and keeps the blocks around for the next round of allocations. Only trivially
+// destructible types may live here since no destructor is ever run.
+//
+// Blocks start at the size given to the constructor and double up to kBlockSize, so that the many arenas holding
+// little(one per expression, see ExprPool) stay small.
+class Arena {
+    struct Block {
+        std::unique_ptr<std::byte[]> m_data;
+        std::size_t m_size;
+    };
+
+public:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+
+    explicit Arena(std::size_t firstBlockSize = kBlockSize)
+        : m_nextBlockSize(std::max<std::size_t>(firstBlockSize, 1)) {
+    }
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    Arena(Arena &&) = delete;
+    Arena &operator=(Arena &&) = delete;
+    ~Arena() = default;
+
+    template <typename T, typename... Args>
+    T *make(Args &&...args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copies `values` into the arena
+    template <typename T>
+    std::span<T> copyArray(std::span<const T> values) {
+        static_assert(std::is_trivially_copyable_v<T>, "Arena arrays are copied bytewise");
+        if (values.empty()) {
+            return {};
+        }
+
+        T *data = static_cast<T *>(allocate(values.size_bytes(), alignof(T)));
+        std::copy(values.begin(), values.end(), data);
+        return {data, values.size()};
+    }
+
+    void *allocate(std::size_t size, std::size_t alignment) {
+        std::byte *aligned = alignUp(m_cur, alignment);
+        if (!m_cur || aligned + size > m_end) {
+            aligned = alignUp(nextBlock(size + alignment), alignment);
+        }
+
+        m_cur = aligned + size;
+        m_bytesAllocated += size;
+        m_peakBytesAllocated = std::max(m_peakBytesAllocated, m_bytesAllocated);
+        return aligned;
+    }
+
+    // Releases every object at once
+    void reset() {
+        m_blockIndex = 0;
+        m_cur = m_blocks.empty() ? nullptr : m_blocks.front().m_data.get();
+        m_end = m_blocks.empty() ? nullptr : m_cur + m_blocks.front().m_size;
+        m_bytesAllocated = 0;
+    }
+
+    std::size_t bytesAllocated() const {
+        return m_bytesAllocated;
+    }
+
+    // High-water mark of bytesAllocated() since construction
+    std::size_t peakBytesAllocated() const {
+        return m_peakBytesAllocated;
+    }
+
+    // Memory held by the arena, including the unused tails of blocks
+    std::size_t bytesReserved() const {
+        std::size_t total = 0;
+        for (const Block &block : m_blocks) {
+            total += block.m_size;
+        }
+        return total;
+    }
+
+private:
+    static std::byte *alignUp(std::byte *ptr, std::size_t alignment) {
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        return ptr + ((alignment - address % alignment) % alignment);
+    }
+
+    // Moves to the next block that can hold `minSize` bytes, reusing blocks kept by reset() when possible
+    std::byte *nextBlock(std::size_t minSize) {
+        if (m_cur) {
+            ++m_blockIndex;
+        }
+
+        while (m_blockIndex < m_blocks.size() && m_blocks[m_blockIndex].m_size < minSize) {
+            ++m_blockIndex;
+        }
+
+        if (m_blockIndex == m_blocks.size()) {
+            const std::size_t size = std::max(m_nextBlockSize, minSize);
+            m_blocks.push_back(Block{std::make_unique_for_overwrite<std::byte[]>(size), size});
+            m_nextBlockSize = std::max(m_nextBlockSize, std::min(m_nextBlockSize * 2, kBlockSize));
+        }
+
+        Block &block = m_blocks[m_blockIndex];
+        m_cur = block.m_data.get();
+        m_end = m_cur + block.m_size;
+        return m_cur;
+    }
+
+    std::vector<Block> m_blocks;
+    std::size_t m_blockIndex = 0;
+    std::size_t m_nextBlockSize;
+
+    // Free part of the current block
+    std::byte *m_cur = nullptr;
+    std::byte *m_end = nullptr;
+
+    std::size_t m_bytesAllocated = 0;
+    std::size_t m_peakBytesAllocated = 0;
+};
+
+#endif  // !_ARENA_HPP_
@@ -0,0 +1,64 @@
+#ifndef _BATCH_ENTRY_POINTS_HPP_
+#define _BATCH_ENTRY_POINTS_HPP_
+
+#include "LLVMContextData.hpp"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Vectorized batch entry points(--batch-entries).
+//
+// For every function `double f(double a, double b, ...)` of a module, generate() adds a companion
+//   void f_batch(const double *a, const double *b, ..., double *out, size_t n)
+// that computes out[i] = f(a[i], b[i], ...) for every i < n. f is inlined into the loop, and so is everything it calls
+// within the module up to a size limit, then the loop is vectorized for the SIMD width of the target machine. A call
+// per element becomes a call per array, and the loop runs several elements per instruction.
+//
+// The arrays must not overlap `out`. Batch entry points are exported with the functions of the module, so that the
+// name cannot be defined again, but Kaleidoscope code cannot call them(see ExportedFunction::m_batchEntry).
+class BatchEntryPoints {
+    static constexpr const char *kSuffix = "_batch";
+
+    // Instructions of a loop body beyond which calls are no longer inlined, a recursive function would never stop
+    static constexpr std::size_t kMaxInlinedInstructions = 2048;
+
+public:
+    // Vectorizes for `targetMachine`, for the host if it is nullptr
+    explicit BatchEntryPoints(std::unique_ptr<llvm::TargetMachine> targetMachine = nullptr);
+    BatchEntryPoints(const BatchEntryPoints &) = delete;
+    BatchEntryPoints &operator=(const BatchEntryPoints &) = delete;
+    BatchEntryPoints(BatchEntryPoints &&) = delete;
+    BatchEntryPoints &operator=(BatchEntryPoints &&) = delete;
+    ~BatchEntryPoints() = default;
+
+    // Name of the batch entry point of `name`
+    static std::string nameOf(std::string_view name);
+
+    // Adds the batch entry points of the functions with arguments defined in `module`, except those whose name is
+    // taken already, and exports them. Call it after the module's functions were exported.
+    void generate(llvm::Module &module, ExportedFunctions &exportedFunctions);
+
+private:
+    // The loop over `func`, nullptr if the name is taken
+    llvm::Function *generateLoop(llvm::Function &func, const ExportedFunctions &exportedFunctions);
+
+    // Inlines the calls of `batchFunc` to functions defined in its module, those of the inlined bodies included
+    void inlineCalls(llvm::Function &batchFunc);
+
+    std::unique_ptr<llvm::TargetMachine> m_targetMachine;
+
+    // The vectorization pipeline, run over every batch entry point once it is generated
+    llvm::FunctionPassManager m_FPM;
+    llvm::LoopAnalysisManager m_LAM;
+    llvm::FunctionAnalysisManager m_FAM;
+    llvm::CGSCCAnalysisManager m_CGAM;
+    llvm::ModuleAnalysisManager m_MAM;
+};
+
+#endif  // !_BATCH_ENTRY_POINTS_HPP_
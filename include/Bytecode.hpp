@@ -0,0 +1,82 @@
+#ifndef _BYTECODE_HPP_
+#define _BYTECODE_HPP_
+
+#include "ExpressionsAST.hpp"
+#include "Symbol.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Register-based bytecode run by the BytecodeVM. Every function works on a frame of its own registers: the arguments
+// first, then the temporaries of its body. Operands name registers, except for the constant of LoadConst and the
+// callee and argument list of Call.
+enum class Opcode : std::uint8_t {
+    LoadConst,  // dst = constants[a]
+    Add,        // dst = a + b
+    Sub,        // dst = a - b
+    Mul,        // dst = a * b
+    Less,       // dst = a < b(or unordered) ? 1 : 0
+    Call,       // dst = functions[a](registers operands[b], operands[b + 1], ...), as many as the callee takes
+    Return,     // returns a
+};
+
+struct Instruction {
+    Opcode m_op;
+    std::uint32_t m_dst;
+    std::uint32_t m_a;
+    std::uint32_t m_b;
+};
+
+struct BytecodeFunction {
+    Symbol m_name;
+    std::uint32_t m_arity = 0;
+
+    // Size of the frame: the arguments and the temporaries
+    std::uint32_t m_registers = 0;
+
+    // Empty for a declaration, which is then called at m_hostAddress
+    std::vector<Instruction> m_code{};
+    std::vector<double> m_constants{};
+    std::vector<std::uint32_t> m_operands{};
+
+    // Extern only: the host function of that name, nullptr if the process has none
+    void *m_hostAddress = nullptr;
+
+    bool isDefined() const {
+        return !m_code.empty();
+    }
+};
+
+// The functions of a program, compiled straight from their ASTs. A call refers to its callee by index, so a function
+// declared by an extern and defined later on is called at its definition from then on.
+class BytecodeProgram {
+public:
+    // Registers `proto` like an extern, the host function of that name is called unless it gets defined. False(after
+    // printing the error) for a function known with a different number of arguments.
+    bool declare(const PrototypeAST &proto);
+
+    // Compiles `func` and registers it, false(after printing the error) if it cannot be compiled or is already defined
+    bool define(const FunctionAST &func);
+
+    // Compiles the top-level expression `func` into a function that is not registered, so that it can be run once and
+    // dropped
+    std::optional<BytecodeFunction> compileExpression(const FunctionAST &func) const;
+
+    const std::vector<BytecodeFunction> &functions() const {
+        return m_functions;
+    }
+
+    // nullptr if there is no function of that name
+    const BytecodeFunction *find(Symbol name) const;
+
+private:
+    // The bytecode of a body whose arguments are `params`, false after printing the error on failure
+    bool compile(const ExprPool &body, const std::vector<Symbol> &params, BytecodeFunction &func) const;
+
+    std::vector<BytecodeFunction> m_functions;
+    std::unordered_map<Symbol, std::uint32_t> m_indices;
+};
+
+#endif  // !_BYTECODE_HPP_
@@ -0,0 +1,41 @@
+#ifndef _BYTECODE_VM_HPP_
+#define _BYTECODE_VM_HPP_
+
+#include "Bytecode.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Runs bytecode in a single dispatch loop(threaded through computed gotos where the compiler has them). Calls do not
+// recurse on the native stack, the frames are laid out one after the other on a register stack of fixed size: without
+// conditionals every recursive call recurses until the stack runs out, and that is an error rather than a crash.
+class BytecodeVM {
+    static constexpr std::size_t kStackRegisters = std::size_t{1} << 20;
+    static constexpr std::size_t kMaxCallDepth = std::size_t{1} << 18;
+
+public:
+    // Externs are called with up to that many arguments
+    static constexpr std::size_t kMaxHostArguments = 8;
+
+    BytecodeVM();
+
+    // Runs `entry`, which takes no arguments, calling into the functions of `program`. std::nullopt(after printing
+    // the error) if it runs out of stack or calls an extern the process cannot provide.
+    std::optional<double> run(const BytecodeProgram &program, const BytecodeFunction &entry);
+
+private:
+    // A caller, resumed at the Call instruction m_pc once the callee returns
+    struct Frame {
+        const BytecodeFunction *m_function;
+        const Instruction *m_pc;
+        double *m_registers;
+    };
+
+    // Left uninitialized, only the pages the frames reach are ever touched
+    std::unique_ptr<double[]> m_stack;
+    std::vector<Frame> m_frames;
+};
+
+#endif  // !_BYTECODE_VM_HPP_
@@ -0,0 +1,92 @@
+#ifndef _CHAR_SCANNER_HPP_
+#define _CHAR_SCANNER_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Byte classification and run scanning for the Lexer. Classes are plain ASCII(what std::isspace/std::isalnum answer
+// in the "C" locale) and are looked up in a table, so they inline and do not depend on the current locale. Scanning a
+// run is done 16 or 32 bytes at a time where the CPU allows it; the implementation is picked once at runtime.
+namespace scan {
+
+enum CharClass : std::uint8_t {
+    kSpace = 1 << 0,
+    kDigit = 1 << 1,
+    kIdentifierStart = 1 << 2,  // letters and '_'
+    kLineEnd = 1 << 3,
+};
+
+inline constexpr std::array<std::uint8_t, 256> kCharClasses = [] {
+    std::array<std::uint8_t, 256> classes{};
+
+    for (const char c : std::string_view{" \t\n\v\f\r"}) {
+        classes[static_cast<unsigned char>(c)] |= kSpace;
+    }
+    for (int c = '0'; c <= '9'; ++c) {
+        classes[c] |= kDigit;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        classes[c] |= kIdentifierStart;
+        classes[c - 'a' + 'A'] |= kIdentifierStart;
+    }
+    classes['_'] |= kIdentifierStart;
+    classes['\n'] |= kLineEnd;
+    classes['\r'] |= kLineEnd;
+
+    return classes;
+}();
+
+inline bool is(char c, std::uint8_t charClass) {
+    return kCharClasses[static_cast<unsigned char>(c)] & charClass;
+}
+
+inline bool isSpace(char c) {
+    return is(c, kSpace);
+}
+
+inline bool isDigit(char c) {
+    return is(c, kDigit);
+}
+
+inline bool isIdentifierStart(char c) {
+    return is(c, kIdentifierStart);
+}
+
+inline bool isIdentifierChar(char c) {
+    return is(c, kIdentifierStart | kDigit);
+}
+
+// Returns the first position in [begin, end) whose byte does not belong to the run, or `end`
+using RunScanner = const char *(*)(const char *begin, const char *end);
+
+enum class Isa {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+struct Kernels {
+    Isa m_isa;
+    RunScanner m_skipSpaces;       // run of whitespace
+    RunScanner m_skipToLineEnd;    // run of anything but '\r' and '\n'
+    RunScanner m_skipIdentifier;   // run of letters, digits and '_'
+    RunScanner m_skipDigits;       // run of digits
+};
+
+// Kernels for `isa`, nullptr if the build or the running CPU lacks it
+const Kernels *kernelsFor(Isa isa);
+
+// Best kernels for the running CPU
+const Kernels &kernels();
+
+const char *isaName(Isa isa);
+
+// Parses digits* ('.' digits*)? when the result is a single correctly rounded division of two exact doubles: all digits
+// read as one integer stay below 2^53 and there are at most 22 fraction digits. Returns false, leaving `value`
+// untouched, for anything else so that the caller can fall back to std::from_chars.
+bool parseSimpleNumber(std::string_view text, double &value);
+
+}  // namespace scan
+
+#endif  // !_CHAR_SCANNER_HPP_
@@ -0,0 +1,47 @@
+#ifndef _CONSTANT_FOLDER_HPP_
+#define _CONSTANT_FOLDER_HPP_
+
+#include "ExpressionsAST.hpp"
+#include "Symbol.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Evaluates expressions made of numbers, binary operators and calls to pure functions at parse time, so that constant
+// top-level expressions need neither IR nor the JIT. A function is pure if its body only uses its arguments, numbers,
+// operators and calls to functions that were pure when it was defined; externs and functions declared but not yet
+// defined never are. The results are bit for bit those of the generated code, which does the same IEEE double
+// operations in the same order.
+class ConstantFolder {
+    // Evaluation gives up beyond these, the expression is then compiled as usual. The language has no conditionals,
+    // so a call tree only ever grows with the depth of the calls.
+    static constexpr std::size_t kMaxNodes = 1 << 16;
+    static constexpr std::size_t kMaxDepth = 256;
+
+public:
+    // Remembers the definition `func` if it is pure. Call after its codegen succeeded. A later definition of the same
+    // name(see HotSwapper) replaces it, the pure functions calling it then call the new one, like the generated code.
+    void define(const FunctionAST &func);
+
+    // Value of the top-level expression `expr`, std::nullopt if it is not constant(or too costly to evaluate)
+    std::optional<double> evaluate(const ExprPool &expr) const;
+
+private:
+    struct PureFunction {
+        std::vector<Symbol> m_params;
+        ExprPool m_body;
+    };
+
+    // Whether a function with these parameters and body would be pure
+    bool isPure(const ExprPool &body, std::span<const Symbol> params) const;
+
+    std::optional<double> evaluate(const ExprPool &expr, std::span<const Symbol> params, std::span<const double> args,
+                                   std::size_t depth, std::size_t &nodes) const;
+
+    std::unordered_map<Symbol, PureFunction> m_functions;
+};
+
+#endif  // !_CONSTANT_FOLDER_HPP_
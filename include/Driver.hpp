@@ -0,0 +1,133 @@
+#ifndef _DRIVER_HPP_
+#define _DRIVER_HPP_
+
+#include "BatchEntryPoints.hpp"
+#include "ConstantFolder.hpp"
+#include "HotSwapper.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Memoizer.hpp"
+#include "ObjectCache.hpp"
+#include "Options.hpp"
+#include "ParallelFrontEnd.hpp"
+#include "Parser.hpp"
+#include "TieredCompiler.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Takes the top-level items produced by the Parser through codegen and the JIT
+class Driver {
+    static constexpr const char *kModuleName = "Kaleidoscope goes jiitttt";
+    static constexpr const char *kAnonExprIdentifier = "__anon_expr";
+
+    // Items per module when compiling on several threads, enough to make up for the cost of every extra module. The
+    // help of --jit-threads quotes it.
+    static constexpr std::size_t kItemsPerParallelModule = 64;
+
+public:
+    Driver(Lexer &lexer, const Options &options);
+    Driver(const Driver &) = delete;
+    Driver &operator=(const Driver &) = delete;
+    Driver(Driver &&) = delete;
+    Driver &operator=(Driver &&) = delete;
+    ~Driver() = default;
+
+    // Read-eval-print loop: every item is compiled as soon as it is parsed and top-level expressions are evaluated
+    // right away, each in a module of its own
+    void runInteractive();
+
+    // Compiles the whole input into a single module and hands it to the JIT once, then evaluates the top-level
+    // expressions in input order. Only their results are printed(and the IR if requested). Returns the number of
+    // items that failed to parse or compile.
+    int runBatch();
+
+    // runBatch() over `program`, the whole input, which is lexed, parsed and generated in m_options.m_parseThreads
+    // pieces in parallel(see ParallelFrontEnd)
+    int runBatch(std::string_view program);
+
+private:
+    void handleDefinition();
+    void handleExtern();
+    void handleTopLevelExpression();
+
+    // Generates code for `func` into the current module, nullptr if parsing or codegen failed. Definitions are also
+    // handed to m_folder.
+    llvm::Function *compileFunction(std::unique_ptr<FunctionAST> func, bool isDefinition);
+
+    // Batch mode, once the whole program was handed over: runs `expressions` in order and prints their results. An
+    // expression that cannot be compiled is reported and skipped. Returns the number of errors.
+    int runExpressions(const std::vector<TopLevelExpression> &expressions);
+
+    // Prints the statistics of m_objectCache and m_memoizer and the report of m_passProfiler if asked to
+    void printCacheStats() const;
+
+    // Starts a fresh module after the current one was handed to the JIT
+    void startNewModule();
+
+    // Called after every definition, extern or compiled batch top-level expression. Counts the items of the current
+    // module and hands it over once there are enough of them. False if handing it over failed.
+    bool itemGenerated();
+
+    // Hands the current module to the JIT for good, the following modules can still call its functions. False(and the
+    // reason printed) if that fails; the functions of a module the JIT did not take are not exported either.
+    bool handOverDefinitions();
+
+    // Context the current module is generated in
+    LLVMContextData &llvmCtxData() {
+        return *m_contexts[m_currentContext];
+    }
+
+    // The context `llvmContext` belongs to, nullptr if it is not one of m_contexts
+    LLVMContextData *contextOf(const llvm::LLVMContext &llvmContext);
+
+    Parser m_parser;
+    const Options &m_options;
+
+    // Top-level expressions it can evaluate never reach codegen or the JIT
+    ConstantFolder m_folder;
+
+    // The program goes to the JIT in modules of m_itemsPerModule items as soon as they are generated, instead of in
+    // one piece(batch) or right before the next top-level expression(REPL). Lazily compiled functions are split off
+    // their modules at a cost that grows with the module, so those get a module each; modules compiled in parallel
+    // by several threads have to be separate, and so do modules compiled by tiers. Hot-swapped definitions get a module
+    // each too, so that a replaced body frees its code on its own.
+    const bool m_splitModules;
+    const std::size_t m_itemsPerModule;
+    std::size_t m_pendingItems;
+
+    // --pass-profile only, profiles the pipelines of m_contexts and m_tiered
+    std::unique_ptr<PassProfiler> m_passProfiler;
+
+    // Modules are generated in the contexts in turn(one per JIT thread, or per piece of the parallel front end), all of
+    // them share the exported functions
+    std::shared_ptr<ExportedFunctions> m_exportedFunctions;
+    std::vector<std::unique_ptr<LLVMContextData>> m_contexts;
+    std::size_t m_currentContext;
+
+    // Outlives the JIT, which compiles through it
+    std::unique_ptr<ObjectCacheDirectory> m_objectCache;
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> m_JIT;
+
+    // Tiered mode only, handed the modules instead of m_JIT
+    std::unique_ptr<TieredCompiler> m_tiered;
+
+    // --hot-swap only, handed the modules instead of m_JIT
+    std::unique_ptr<HotSwapper> m_hotSwapper;
+
+    // --memoize only, rewrites every module before it goes to the JIT
+    std::unique_ptr<Memoizer> m_memoizer;
+
+    // --batch-entries only, adds the batch entry points to every module before it goes to the JIT
+    std::unique_ptr<BatchEntryPoints> m_batchEntries;
+
+    // Lazy mode: the JIT splits every function off into a context of its own and optimizes it with the m_llvmOpt of
+    // the(only) context when it is first called. Codegen never runs at the same time(calls into JIT'd code are
+    // synchronous), the lock only orders the JIT's own materializations.
+    std::mutex m_optimizerMutex;
+};
+
+#endif  // !_DRIVER_HPP_
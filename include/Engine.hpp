@@ -0,0 +1,207 @@
+#ifndef _ENGINE_HPP_
+#define _ENGINE_HPP_
+
+#include "OptLevel.hpp"
+#include "Symbol.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace llvm::orc {
+class KaleidoscopeJIT;
+}  // namespace llvm::orc
+
+struct LLVMContextData;
+
+// The embedding API of libkaleidoscope: compile once, call many times.
+//
+//   auto engine = kaleidoscope::Engine::create();
+//   auto program = (*engine)->compile("def f(x y) x * y + 1;");
+//   auto f = program->function<double(double, double)>("f");
+//   double value = (*f)(2, 3);
+//
+// Nothing is printed, every error comes back as the error of a Result.
+namespace kaleidoscope {
+
+struct Error {
+    std::string m_message;
+};
+
+// A value or the error that prevented it
+template <typename T>
+class Result {
+public:
+    Result(T value)
+        : m_value(std::move(value)) {
+    }
+
+    Result(Error error)
+        : m_value(std::move(error)) {
+    }
+
+    bool ok() const {
+        return std::holds_alternative<T>(m_value);
+    }
+
+    explicit operator bool() const {
+        return ok();
+    }
+
+    T &value() {
+        return std::get<T>(m_value);
+    }
+
+    const T &value() const {
+        return std::get<T>(m_value);
+    }
+
+    T &operator*() {
+        return value();
+    }
+
+    const T &operator*() const {
+        return value();
+    }
+
+    T *operator->() {
+        return &value();
+    }
+
+    const T *operator->() const {
+        return &value();
+    }
+
+    // Only if !ok()
+    const std::string &error() const {
+        return std::get<Error>(m_value).m_message;
+    }
+
+private:
+    std::variant<T, Error> m_value;
+};
+
+template <typename Signature>
+class Fn;
+
+// Handle of a compiled function: its address, resolved once when the handle was made. Calling it is calling the
+// function pointer, from any number of threads at the same time. Valid as long as the Engine that compiled it.
+template <typename... Args>
+class Fn<double(Args...)> {
+    static_assert((std::is_same_v<Args, double> && ...), "Kaleidoscope functions take and return doubles only");
+
+public:
+    using Pointer = double (*)(Args...);
+    static constexpr std::size_t kArity = sizeof...(Args);
+
+    Fn() = default;
+
+    double operator()(Args... args) const {
+        return m_address(args...);
+    }
+
+    Pointer address() const {
+        return m_address;
+    }
+
+    explicit operator bool() const {
+        return m_address != nullptr;
+    }
+
+private:
+    friend class Program;
+
+    explicit Fn(Pointer address)
+        : m_address(address) {
+    }
+
+    Pointer m_address = nullptr;
+};
+
+class Engine;
+
+// The functions one Engine::compile() defined
+class Program {
+public:
+    // Handle of function `name` of this program, which must take as many arguments as `Signature`
+    template <typename Signature>
+    Result<Fn<Signature>> function(std::string_view name) const;
+
+    // Names of the functions defined, in source order
+    const std::vector<std::string> &functions() const {
+        return m_functions;
+    }
+
+private:
+    friend class Engine;
+
+    Program(Engine &engine, std::vector<std::string> functions)
+        : m_engine(&engine)
+        , m_functions(std::move(functions)) {
+    }
+
+    // The address of `name` taking `arity` arguments
+    Result<void *> resolve(std::string_view name, std::size_t arity) const;
+
+    Engine *m_engine;
+    std::vector<std::string> m_functions;
+};
+
+// A JIT and the functions compiled into it so far. Thread-safe.
+class Engine {
+    static constexpr const char *kModuleName = "Kaleidoscope embedded";
+
+public:
+    // The functions are optimized at `optLevel`(see OptLevel)
+    static Result<std::unique_ptr<Engine>> create(OptLevel optLevel = OptLevel::Function);
+
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+    Engine(Engine &&) = delete;
+    Engine &operator=(Engine &&) = delete;
+    ~Engine();
+
+    // Compiles the definitions and externs of `source`, which may call the functions of every source compiled before.
+    // All or nothing: on an error none of its functions are defined. Top-level expressions are an error, there is
+    // nothing to report their values to; define a function and call it instead.
+    Result<Program> compile(std::string_view source);
+
+private:
+    friend class Program;
+
+    Engine(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit, OptLevel optLevel);
+
+    // The address of `name` if it takes `arity` arguments. Every name is looked up in the JIT once.
+    Result<void *> resolve(Symbol name, std::size_t arity);
+
+    // Drops the current module after a failed compile() and returns `messages` as its error
+    Error discardModule(const std::vector<std::string> &messages);
+
+    const OptLevel m_optLevel;
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> m_JIT;
+    std::unique_ptr<LLVMContextData> m_ctxData;
+
+    // Guards the codegen state and m_addresses
+    std::mutex m_mutex;
+    std::unordered_map<Symbol, void *> m_addresses;
+};
+
+template <typename Signature>
+Result<Fn<Signature>> Program::function(std::string_view name) const {
+    const auto address = resolve(name, Fn<Signature>::kArity);
+    if (!address) {
+        return Error{address.error()};
+    }
+    return Fn<Signature>{reinterpret_cast<typename Fn<Signature>::Pointer>(*address)};
+}
+
+}  // namespace kaleidoscope
+
+#endif  // !_ENGINE_HPP_
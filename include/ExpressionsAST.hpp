@@ -1,179 +1,386 @@
 #ifndef _EXPRESSIONS_AST_HPP_
 #define _EXPRESSIONS_AST_HPP_
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <span>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Arena.hpp"
+#include "Symbol.hpp"
+#include "Trace.hpp"
 #include "Utils.hpp"
 #include "LLVMUtils.hpp"
 #include "LLVMContextData.hpp"
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Verifier.h"
 
-class ExprAST {
-public:
-    ExprAST() = default;
-    ExprAST(const ExprAST &) = delete;
-    ExprAST &operator=(const ExprAST &) = delete;
-    ExprAST(ExprAST &&) = delete;
-    ExprAST &operator=(ExprAST &&) = delete;
-    virtual ~ExprAST() = default;
-
-    virtual llvm::Value *codegen(LLVMContextData &ctxData) = 0;
+using ExprId = std::uint32_t;
+
+enum class ExprKind : std::uint8_t {
+    Number,    // payload: number
+    Variable,  // payload: symbol
+    Binary,    // op, lhs, rhs
+    Call       // payload: symbol(callee), call arguments
 };
 
-class NumberExprAST : public ExprAST {
+// Expression tree stored as a struct of arrays: a node is an index into parallel arrays holding its kind, operator,
+// two child/operand slots and a literal or symbol payload. The arguments of calls are kept in a separate operand
+// array, a call node refers to them by offset and count.
+//
+// The parser appends nodes in post-order and every node is used by exactly one parent, so children always precede
+// their parents, the last node is the root and a front-to-back sweep visits the nodes in the order a recursive
+// left-to-right walk would finish them. Passes are written as such sweeps switching on the kind.
+//
+// The arrays are carved out of an Arena owned by the pool. An array that fills up is copied into one twice its size and
+// the old one stays in the arena until clear(), which releases all of them at once and keeps the blocks: the parser
+// hands its pool to every item and takes it back(see Parser::recycle()), so steady-state parsing does not allocate.
+class ExprPool {
+    // Arrays of a new pool, and size of the first block of its arena
+    static constexpr ExprId kInitialCapacity = 16;
+    static constexpr std::size_t kFirstBlockSize = 1024;
+
+    union Payload {
+        constexpr Payload(double number)
+            : m_number(number) {
+        }
+        constexpr Payload(Symbol symbol)
+            : m_symbol(symbol) {
+        }
+
+        double m_number;
+        Symbol m_symbol;
+    };
+
 public:
-    NumberExprAST(double number)
-        : m_value(number) {
+    ExprPool() = default;
+
+    // Copies the nodes into an arena of its own, sized to fit
+    ExprPool(const ExprPool &other) {
+        copyFrom(other);
     }
 
-    llvm::Value *codegen(LLVMContextData &ctxData) override {
-        return llvm::ConstantFP::get(*ctxData.m_llvmContext,
-                                     llvm::APFloat{m_value});
+    ExprPool &operator=(const ExprPool &other) {
+        if (this != &other) {
+            clear();
+            copyFrom(other);
+        }
+        return *this;
     }
 
-private:
-    double m_value;
-};
+    ExprPool(ExprPool &&other) noexcept
+        : m_arena(std::move(other.m_arena))
+        , m_columns(std::exchange(other.m_columns, {})) {
+    }
 
-class VariableExprAST : public ExprAST {
-public:
-    VariableExprAST(std::string identifier)
-        : m_identifier(std::move(identifier)) {
+    ExprPool &operator=(ExprPool &&other) noexcept {
+        if (this != &other) {
+            m_arena = std::move(other.m_arena);
+            m_columns = std::exchange(other.m_columns, {});
+        }
+        return *this;
     }
 
-    llvm::Value *codegen(LLVMContextData &ctxData) override {
-        llvm::Value *varValue = std::invoke([this, &ctxData] {
-            const auto it = ctxData.m_namedValues.find(m_identifier);
-            return it != ctxData.m_namedValues.end() ? it->second : nullptr;
-        });
+    ~ExprPool() = default;
 
-        if (!varValue) {
-            utils::logErrorLLVMValue("Unknown variable name");
-        }
+    ExprId addNumber(double value) {
+        return append(ExprKind::Number, '\0', 0, 0, value);
+    }
 
-        return varValue;
+    ExprId addVariable(Symbol identifier) {
+        return append(ExprKind::Variable, '\0', 0, 0, identifier);
     }
 
-private:
-    std::string m_identifier;
-};
+    ExprId addBinary(char op, ExprId lhs, ExprId rhs) {
+        return append(ExprKind::Binary, op, lhs, rhs, 0.0);
+    }
 
-class BinaryExprAST : public ExprAST {
-public:
-    BinaryExprAST(char op, std::unique_ptr<ExprAST> lhs,
-                  std::unique_ptr<ExprAST> rhs)
-        : m_op(op)
-        , m_lhs(std::move(lhs))
-        , m_rhs(std::move(rhs)) {
-    }
-
-    llvm::Value *codegen(LLVMContextData &ctxData) override {
-        llvm::Value *lhsValue = m_lhs ? m_lhs->codegen(ctxData) : nullptr;
-        if (!lhsValue) {
-            return utils::logErrorLLVMValue(
-                "Unexpected nullptr value for LHS sub-expression");
+    ExprId addCall(Symbol callee, std::span<const ExprId> args) {
+        Columns &c = m_columns;
+        const ExprId firstArg = c.m_operandCount;
+        const auto argCount = static_cast<ExprId>(args.size());
+        if (c.m_operandCount + argCount > c.m_operandCapacity) {
+            reserveOperands(std::max(c.m_operandCount + argCount, std::max(c.m_operandCapacity * 2, kInitialCapacity)));
         }
 
-        llvm::Value *rhsValue = m_rhs ? m_rhs->codegen(ctxData) : nullptr;
-        if (!rhsValue) {
-            return utils::logErrorLLVMValue(
-                "Unexpected nullptr value for RHS sub-expression");
+        std::copy(args.begin(), args.end(), c.m_operands + firstArg);
+        c.m_operandCount += argCount;
+        return append(ExprKind::Call, '\0', firstArg, argCount, callee);
+    }
+
+    // Drops all nodes but keeps the storage: the arena is reset and arrays as large as before are carved out of it
+    // again
+    void clear() {
+        const Columns previous = std::exchange(m_columns, {});
+        if (m_arena) {
+            m_arena->reset();
+            reserveNodes(previous.m_capacity);
+            reserveOperands(previous.m_operandCapacity);
         }
+    }
 
-        switch (m_op) {
-            case '+':
-                return ctxData.m_builder.CreateFAdd(lhsValue, rhsValue,
-                                                    "addtmp");
-            case '-':
-                return ctxData.m_builder.CreateFSub(lhsValue, rhsValue,
-                                                    "subtmp");
-            case '*':
-                return ctxData.m_builder.CreateFMul(lhsValue, rhsValue,
-                                                    "multmp");
-            case '<':
-                lhsValue = ctxData.m_builder.CreateFCmpULT(lhsValue, rhsValue,
-                                                           "cmptmp");
-                // Convert bool 0/1 to double 0.0 or 1.0
-                return ctxData.m_builder.CreateUIToFP(
-                    lhsValue, llvm::Type::getDoubleTy(*ctxData.m_llvmContext),
-                    "booltmp");
-            default:
-                return utils::logErrorLLVMValue("Invalid binary operator");
+    bool empty() const {
+        return m_columns.m_size == 0;
+    }
+
+    ExprId size() const {
+        return m_columns.m_size;
+    }
+
+    ExprId root() const {
+        assert(!empty() && "Empty expression has no root");
+        return size() - 1;
+    }
+
+    ExprKind kind(ExprId id) const {
+        return m_columns.m_kinds[id];
+    }
+
+    char op(ExprId id) const {
+        return m_columns.m_ops[id];
+    }
+
+    ExprId lhs(ExprId id) const {
+        return m_columns.m_first[id];
+    }
+
+    ExprId rhs(ExprId id) const {
+        return m_columns.m_second[id];
+    }
+
+    double number(ExprId id) const {
+        return m_columns.m_payloads[id].m_number;
+    }
+
+    // Variable name or callee
+    Symbol symbol(ExprId id) const {
+        return m_columns.m_payloads[id].m_symbol;
+    }
+
+    std::span<const ExprId> args(ExprId id) const {
+        return {m_columns.m_operands + m_columns.m_first[id], m_columns.m_second[id]};
+    }
+
+    llvm::Value *codegen(LLVMContextData &ctxData) const {
+        // Value of every node visited so far
+        llvm::SmallVector<llvm::Value *, 64> values;
+        values.reserve(size());
+
+        for (ExprId id = 0; id < size(); ++id) {
+            llvm::Value *value = codegenNode(id, values, ctxData);
+            if (!value) {
+                return nullptr;
+            }
+            values.push_back(value);
         }
 
-        return nullptr;
+        return values.empty() ? utils::logErrorLLVMValue("Unexpected empty expression before LLVM codegen")
+                              : values.back();
     }
 
 private:
-    char m_op;
-    std::unique_ptr<ExprAST> m_lhs;
-    std::unique_ptr<ExprAST> m_rhs;
-};
+    // The arrays of the nodes and of the call operands, all of them in m_arena
+    struct Columns {
+        ExprKind *m_kinds = nullptr;
+        char *m_ops = nullptr;
+        ExprId *m_first = nullptr;   // Binary: lhs, Call: offset of the first argument in m_operands
+        ExprId *m_second = nullptr;  // Binary: rhs, Call: number of arguments
+        Payload *m_payloads = nullptr;
+        ExprId m_size = 0;
+        ExprId m_capacity = 0;
+
+        ExprId *m_operands = nullptr;
+        ExprId m_operandCount = 0;
+        ExprId m_operandCapacity = 0;
+    };
+
+    ExprId append(ExprKind kind, char op, ExprId first, ExprId second, Payload payload) {
+        Columns &c = m_columns;
+        if (c.m_size == c.m_capacity) {
+            reserveNodes(std::max(c.m_capacity * 2, kInitialCapacity));
+        }
 
-class CallExprAST : public ExprAST {
-public:
-    CallExprAST(std::string callee, std::vector<std::unique_ptr<ExprAST>> args)
-        : m_callee(std::move(callee))
-        , m_args(std::move(args)) {
+        c.m_kinds[c.m_size] = kind;
+        c.m_ops[c.m_size] = op;
+        c.m_first[c.m_size] = first;
+        c.m_second[c.m_size] = second;
+        c.m_payloads[c.m_size] = payload;
+        return c.m_size++;
+    }
+
+    // Moves the node arrays to arrays of `capacity` nodes, unless they hold that many already
+    void reserveNodes(ExprId capacity) {
+        Columns &c = m_columns;
+        if (capacity <= c.m_capacity) {
+            return;
+        }
+
+        c.m_kinds = grow(c.m_kinds, c.m_size, capacity);
+        c.m_ops = grow(c.m_ops, c.m_size, capacity);
+        c.m_first = grow(c.m_first, c.m_size, capacity);
+        c.m_second = grow(c.m_second, c.m_size, capacity);
+        c.m_payloads = grow(c.m_payloads, c.m_size, capacity);
+        c.m_capacity = capacity;
+    }
+
+    void reserveOperands(ExprId capacity) {
+        Columns &c = m_columns;
+        if (capacity > c.m_operandCapacity) {
+            c.m_operands = grow(c.m_operands, c.m_operandCount, capacity);
+            c.m_operandCapacity = capacity;
+        }
     }
 
-    llvm::Value *codegen(LLVMContextData &ctxData) override {
-        // Look up the name in the global module table
-        llvm::Function *calleeFunc = ctxData.m_llvmModule->getFunction(m_callee);
-        if (!calleeFunc) {
-            return utils::logErrorLLVMValue("Unknown function referenced");
+    // A new array of `capacity` elements in m_arena, starting with the first `size` elements of `array`
+    template <typename T>
+    T *grow(const T *array, ExprId size, ExprId capacity) {
+        static_assert(std::is_trivially_copyable_v<T>, "Pool arrays are copied bytewise");
+        if (!m_arena) {
+            m_arena = std::make_unique<Arena>(kFirstBlockSize);
         }
 
-        if (calleeFunc->arg_size() != m_args.size()) {
-            return utils::logErrorLLVMValue("Incorrect # arguments passed");
+        T *const grown = static_cast<T *>(m_arena->allocate(capacity * sizeof(T), alignof(T)));
+        if (size > 0) {
+            std::memcpy(grown, array, size * sizeof(T));
         }
+        return grown;
+    }
 
-        std::vector<llvm::Value*> argValues;
-        argValues.reserve(m_args.size());
+    void copyFrom(const ExprPool &other) {
+        const Columns &from = other.m_columns;
+        if (from.m_size == 0 && from.m_operandCount == 0) {
+            return;
+        }
 
-        for (const auto &arg : m_args) {
-            if (!arg) {
-                return utils::logErrorLLVMValue(
-                    "Unexpected nullptr expr before LLVM codegen");
+        // Every array and the padding that aligns it
+        constexpr std::size_t kNodeBytes =
+            sizeof(ExprKind) + sizeof(char) + 2 * sizeof(ExprId) + sizeof(Payload);
+        if (!m_arena) {
+            m_arena = std::make_unique<Arena>(from.m_size * kNodeBytes + from.m_operandCount * sizeof(ExprId) +
+                                              6 * alignof(std::max_align_t));
+        }
+
+        reserveNodes(from.m_size);
+        reserveOperands(from.m_operandCount);
+
+        Columns &c = m_columns;
+        std::memcpy(c.m_kinds, from.m_kinds, from.m_size * sizeof(ExprKind));
+        std::memcpy(c.m_ops, from.m_ops, from.m_size * sizeof(char));
+        std::memcpy(c.m_first, from.m_first, from.m_size * sizeof(ExprId));
+        std::memcpy(c.m_second, from.m_second, from.m_size * sizeof(ExprId));
+        std::memcpy(c.m_payloads, from.m_payloads, from.m_size * sizeof(Payload));
+        if (from.m_operandCount > 0) {
+            std::memcpy(c.m_operands, from.m_operands, from.m_operandCount * sizeof(ExprId));
+        }
+        c.m_size = from.m_size;
+        c.m_operandCount = from.m_operandCount;
+    }
+
+    llvm::Value *codegenNode(ExprId id, std::span<llvm::Value *const> values, LLVMContextData &ctxData) const {
+        switch (kind(id)) {
+            case ExprKind::Number:
+                return llvm::ConstantFP::get(ctxData.m_llvmContext, llvm::APFloat{number(id)});
+
+            case ExprKind::Variable: {
+                const auto it = ctxData.m_namedValues.find(symbol(id));
+                if (it == ctxData.m_namedValues.end()) {
+                    return utils::logErrorLLVMValue("Unknown variable name");
+                }
+                return it->second;
             }
 
-            argValues.push_back(arg->codegen(ctxData));
+            case ExprKind::Binary: {
+                llvm::Value *lhsValue = values[lhs(id)];
+                llvm::Value *rhsValue = values[rhs(id)];
+
+                switch (op(id)) {
+                    case '+':
+                        return ctxData.m_builder.CreateFAdd(lhsValue, rhsValue, "addtmp");
+                    case '-':
+                        return ctxData.m_builder.CreateFSub(lhsValue, rhsValue, "subtmp");
+                    case '*':
+                        return ctxData.m_builder.CreateFMul(lhsValue, rhsValue, "multmp");
+                    case '<':
+                        lhsValue = ctxData.m_builder.CreateFCmpULT(lhsValue, rhsValue, "cmptmp");
+                        // Convert bool 0/1 to double 0.0 or 1.0
+                        return ctxData.m_builder.CreateUIToFP(
+                            lhsValue, llvm::Type::getDoubleTy(ctxData.m_llvmContext), "booltmp");
+                    default:
+                        return utils::logErrorLLVMValue("Invalid binary operator");
+                }
+            }
 
-            if (!argValues.back()) {
-                return utils::logErrorLLVMValue(
-                    "Unexpected nullptr expr after LLVM codegen");
+            case ExprKind::Call: {
+                // Look up the name in the global module table
+                llvm::Function *calleeFunc = ctxData.getFunction(symbol(id));
+                if (!calleeFunc) {
+                    return utils::logErrorLLVMValue("Unknown function referenced");
+                }
+
+                const std::span<const ExprId> argIds = args(id);
+                if (calleeFunc->arg_size() != argIds.size()) {
+                    return utils::logErrorLLVMValue("Incorrect # arguments passed");
+                }
+
+                llvm::SmallVector<llvm::Value *, 8> argValues;
+                argValues.reserve(argIds.size());
+
+                for (const ExprId argId : argIds) {
+                    argValues.push_back(values[argId]);
+                }
+
+                return ctxData.m_builder.CreateCall(calleeFunc, argValues, "calltmp");
             }
         }
 
-        return ctxData.m_builder.CreateCall(calleeFunc, argValues, "calltmp");
+        return utils::logErrorLLVMValue("Invalid expression kind");
     }
 
-private:
-    std::string m_callee;
-    std::vector<std::unique_ptr<ExprAST>> m_args;
+    // nullptr until the first node is added
+    std::unique_ptr<Arena> m_arena;
+    Columns m_columns;
 };
 
 class PrototypeAST {
 public:
-    PrototypeAST(std::string callee, std::vector<std::string> args)
-        : m_callee(std::move(callee))
+    PrototypeAST(Symbol callee, std::vector<Symbol> args)
+        : m_callee(callee)
         , m_args(std::move(args)) {
     }
 
-    const std::string &getName() const {
+    Symbol getName() const {
         return m_callee;
     }
 
+    const std::vector<Symbol> &getArgs() const {
+        return m_args;
+    }
+
     llvm::Function *codegen(LLVMContextData &ctxData) {
+        if (!ctxData.isCompatibleDeclaration(m_callee, m_args.size())) {
+            return utils::logErrorLLVMFunction(
+                "codegen() prototype does not match the # arguments of an earlier declaration");
+        }
+
+        // Declared again: the declaration already in the module stands
+        if (llvm::Function *func = ctxData.m_llvmModule->getFunction(m_callee.str()); func) {
+            return func;
+        }
+
         llvm::Type *const doubleType =
-            llvm::Type::getDoubleTy(*ctxData.m_llvmContext);
+            llvm::Type::getDoubleTy(ctxData.m_llvmContext);
 
         std::vector<llvm::Type *> types{m_args.size(), doubleType};
 
@@ -182,43 +389,43 @@ public:
 
         llvm::Function *func =
             llvm::Function::Create(funcType, llvm::Function::ExternalLinkage,
-                                   m_callee, *ctxData.m_llvmModule);
+                                   m_callee.str(), *ctxData.m_llvmModule);
 
         // Set names for all arguments
         for (int i = 0; llvm::Argument &arg : func->args()) {
-            arg.setName(m_args[i++]);
+            arg.setName(m_args[i++].str());
         }
 
         return func;
     }
 
 private:
-    std::string m_callee;
-    std::vector<std::string> m_args;
+    Symbol m_callee;
+    std::vector<Symbol> m_args;
 };
 
 class FunctionAST {
 public:
-    FunctionAST(PrototypeAST prototype, std::unique_ptr<ExprAST> body)
+    FunctionAST(PrototypeAST prototype, ExprPool body)
         : m_prototype(std::move(prototype))
         , m_body(std::move(body)) {
     }
 
     llvm::Function *codegen(LLVMContextData &ctxData) {
+        trace::Scope scope{"codegen", m_prototype.getName().str()};
+
+        if (!ctxData.m_allowRedefinition && ctxData.isExportedDefinition(m_prototype.getName())) {
+            return utils::logErrorLLVMFunction(
+                "codegen() function cannot be redefined");
+        }
+
         // First, check for an existing function from a previous 'extern'
-        // declaration
-        llvm::Function *func =
-            ctxData.m_llvmModule->getFunction(m_prototype.getName());
+        // declaration, in this module or in one handed over earlier
+        llvm::Function *func = ctxData.getFunction(m_prototype.getName());
 
         // Create the prototype IR if it wasn't found
         if (!func) {
             func = m_prototype.codegen(ctxData);
-        } else {
-            // TODO: Verofy that the found prototype signature(args count + arg
-            // identifiers match those) is equal to the signature of the current
-            // function
-            // Possible solution: Cache not only the name of the prototype, but
-            // its whole signature(like name mangling)
         }
 
         if (!func) {
@@ -231,21 +438,32 @@ public:
                 "codegen() function cannot be redefined");
         }
 
+        // The signature is the number of arguments, every one of them is a double. The names may differ from those of
+        // the declaration.
+        const std::vector<Symbol> &argNames = m_prototype.getArgs();
+        if (func->arg_size() != argNames.size()) {
+            return utils::logErrorLLVMFunction(
+                "codegen() function does not match the # arguments of its declaration");
+        }
+
         // Create a new basic block to start insertion into
         llvm::BasicBlock *basicBlock =
-            llvm::BasicBlock::Create(*ctxData.m_llvmContext, "entry", func);
+            llvm::BasicBlock::Create(ctxData.m_llvmContext, "entry", func);
 
         ctxData.m_builder.SetInsertPoint(basicBlock);
 
         // Record the function arguments in the NamedValues map
         ctxData.m_namedValues.clear();
 
-        for (llvm::Argument &arg : func->args()) {
-            ctxData.m_namedValues[arg.getName()] =
+        // The body refers to the argument names of this definition, which may differ from those of an earlier 'extern'
+        for (int i = 0; llvm::Argument &arg : func->args()) {
+            const Symbol argName = argNames[i++];
+            arg.setName(argName.str());
+            ctxData.m_namedValues[argName] =
                 &arg;  // llvm::Argument inherits from llvm::Value
         }
 
-        if (llvm::Value *retValue = m_body->codegen(ctxData); retValue) {
+        if (llvm::Value *retValue = m_body.codegen(ctxData); retValue) {
             // Finish off the function
             ctxData.m_builder.CreateRet(retValue);
 
@@ -255,8 +473,17 @@ public:
                     "codegen() verifyFunction failed");
             }
 
-            auto &llvmOpt = ctxData.m_llvmOpt;
-            llvmOpt.m_FPM.run(*func, llvmOpt.m_FAM);
+            scope.finish();
+
+            if (ctxData.m_optimizeFunctions) {
+                trace::Scope optimizeScope{"optimize", m_prototype.getName().str()};
+                trace::count(trace::Counter::IrInstructionsBefore, trace::enabled() ? func->getInstructionCount() : 0);
+
+                auto &llvmOpt = ctxData.m_llvmOpt;
+                llvmOpt.m_FPM.run(*func, llvmOpt.m_FAM);
+
+                trace::count(trace::Counter::IrInstructionsAfter, trace::enabled() ? func->getInstructionCount() : 0);
+            }
 
             return func;
         }
@@ -267,7 +494,7 @@ public:
     }
 
     PrototypeAST m_prototype;
-    std::unique_ptr<ExprAST> m_body;
+    ExprPool m_body;
 };
 
 #endif  // !_EXPRESSIONS_AST_HPP_
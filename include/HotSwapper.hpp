@@ -0,0 +1,77 @@
+#ifndef _HOT_SWAPPER_HPP_
+#define _HOT_SWAPPER_HPP_
+
+#include "KaleidoscopeJIT.h"
+#include "Symbol.hpp"
+
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Functions that can be defined again while the program runs.
+//
+// Every function of a module handed over through addModule() gets an indirect stub that carries its name, its body
+// becomes `name.v<N>` and every call(even from the function itself) goes through the stub. A later definition of the
+// same name compiles only the new body and points the stub at it; callers keep calling the stub, nothing else is
+// compiled again. The stub is repointed with a single pointer store, so a call goes either to the old or to the new
+// body.
+//
+// Every module is added under a ResourceTracker of its own. Once none of its bodies is reachable through a stub any
+// more, it is retired, and releaseRetired() frees its code.
+class HotSwapper {
+    static constexpr const char *kVersionSeparator = ".v";
+
+public:
+    explicit HotSwapper(llvm::orc::KaleidoscopeJIT &jit);
+    HotSwapper(const HotSwapper &) = delete;
+    HotSwapper &operator=(const HotSwapper &) = delete;
+    HotSwapper(HotSwapper &&) = delete;
+    HotSwapper &operator=(HotSwapper &&) = delete;
+    ~HotSwapper() = default;
+
+    // Compiles the functions defined in `threadSafeModule` right away and points their stubs at them. A function that
+    // was defined before keeps its earlier body if this fails. Every function takes the same number of arguments in
+    // all of its definitions.
+    llvm::Error addModule(llvm::orc::ThreadSafeModule threadSafeModule);
+
+    // Frees the code of the retired modules. Only while no call into JIT'd code is running: one that was still in a
+    // replaced body would return into freed code.
+    llvm::Error releaseRetired();
+
+    // Definitions that replaced an earlier one
+    std::size_t redefinitions() const {
+        return m_redefinitions;
+    }
+
+private:
+    // A module handed over to the JIT and the number of its bodies still reachable through their stubs
+    struct LoadedModule {
+        llvm::orc::ResourceTrackerSP m_tracker;
+        std::size_t m_liveBodies;
+    };
+
+    struct SwappableFunction {
+        // Versions defined so far, failed ones included
+        std::uint64_t m_versions = 0;
+
+        // Module of the body the stub points at, nullptr before the first definition succeeded
+        std::shared_ptr<LoadedModule> m_module;
+    };
+
+    // Name of version `version` of `name`, no identifier contains a '.'
+    static std::string bodyName(Symbol name, std::uint64_t version);
+
+    llvm::orc::KaleidoscopeJIT &m_jit;
+
+    std::unordered_map<Symbol, SwappableFunction> m_functions;
+    std::vector<llvm::orc::ResourceTrackerSP> m_retired;
+
+    std::size_t m_redefinitions = 0;
+};
+
+#endif  // !_HOT_SWAPPER_HPP_
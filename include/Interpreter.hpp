@@ -0,0 +1,40 @@
+#ifndef _INTERPRETER_HPP_
+#define _INTERPRETER_HPP_
+
+#include "Bytecode.hpp"
+#include "BytecodeVM.hpp"
+#include "Parser.hpp"
+
+// Runs the top-level items produced by the Parser on the BytecodeVM instead of the JIT(--engine=interp). Nothing of
+// LLVM is set up, the first result comes without any compilation latency. The REPL and batch mode behave like those
+// of the Driver, minus the IR.
+class Interpreter {
+    static constexpr const char *kAnonExprIdentifier = "__anon_expr";
+
+public:
+    explicit Interpreter(Lexer &lexer);
+    Interpreter(const Interpreter &) = delete;
+    Interpreter &operator=(const Interpreter &) = delete;
+    Interpreter(Interpreter &&) = delete;
+    Interpreter &operator=(Interpreter &&) = delete;
+    ~Interpreter() = default;
+
+    // Read-eval-print loop: every item is compiled as soon as it is parsed and top-level expressions are run right away
+    void runInteractive();
+
+    // Compiles the whole input, then runs the top-level expressions in input order and prints their results. Returns
+    // the number of items that failed to parse, compile or run.
+    int runBatch();
+
+private:
+    void handleDefinition();
+    void handleExtern();
+    void handleTopLevelExpression();
+
+    Parser m_parser;
+
+    BytecodeProgram m_program;
+    BytecodeVM m_vm;
+};
+
+#endif  // !_INTERPRETER_HPP_
@@ -15,22 +15,125 @@
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LazyReexports.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/Shared/ExecutorSymbolDef.h"
+#include "llvm/ExecutionEngine/Orc/TaskDispatch.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/ThreadPool.h"
+#include "ObjectCache.hpp"
+#include "Trace.hpp"
+#include <cstdlib>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace llvm {
 namespace orc {
 
+/// IR compiler that keeps the TargetMachines it creates and reuses them for
+/// later modules, instead of building a new one for every module like
+/// ConcurrentIRCompiler does. A TargetMachine is only used by one compilation
+/// at a time, so concurrent materializations are still fine. With an object
+/// cache directory, objects of modules compiled before are loaded from it
+/// instead of being compiled again.
+class TargetMachinePoolCompiler : public IRCompileLayer::IRCompiler {
+public:
+  TargetMachinePoolCompiler(JITTargetMachineBuilder JTMB,
+                            ObjectCacheDirectory *CacheDir = nullptr)
+      : IRCompiler(irManglingOptionsFromTargetOptions(JTMB.getOptions())),
+        JTMB(std::move(JTMB)), CacheDir(CacheDir) {}
+
+  Expected<std::unique_ptr<MemoryBuffer>> operator()(Module &M) override {
+    trace::Scope Span("compile", M.getModuleIdentifier());
+
+    std::unique_ptr<TargetMachine> TM;
+    {
+      std::lock_guard<std::mutex> Lock(PoolMutex);
+      if (!Pool.empty()) {
+        TM = std::move(Pool.back());
+        Pool.pop_back();
+      }
+    }
+
+    if (!TM) {
+      auto TMOrErr = JTMB.createTargetMachine();
+      if (!TMOrErr)
+        return TMOrErr.takeError();
+      TM = std::move(*TMOrErr);
+    }
+
+    // The cache keys describe the code generator, i.e. any of the pool's TMs
+    std::call_once(CacheCreated, [&] {
+      if (CacheDir)
+        Cache = std::make_unique<TargetObjectCache>(*CacheDir, *TM);
+    });
+
+    auto Obj = SimpleCompiler(*TM, Cache.get())(M);
+    if (Obj && trace::enabled())
+      trace::count(trace::Counter::MachineCodeBytes, textSize(**Obj));
+
+    std::lock_guard<std::mutex> Lock(PoolMutex);
+    Pool.push_back(std::move(TM));
+    return Obj;
+  }
+
+private:
+  /// Bytes of machine code in Obj, i.e. of its text sections.
+  static uint64_t textSize(const MemoryBuffer &Obj) {
+    auto File = object::ObjectFile::createObjectFile(Obj.getMemBufferRef());
+    if (!File) {
+      consumeError(File.takeError());
+      return 0;
+    }
+
+    uint64_t Size = 0;
+    for (const auto &Section : (*File)->sections())
+      if (Section.isText())
+        Size += Section.getSize();
+    return Size;
+  }
+
+  JITTargetMachineBuilder JTMB;
+  ObjectCacheDirectory *CacheDir;
+  std::once_flag CacheCreated;
+  std::unique_ptr<TargetObjectCache> Cache;
+  std::mutex PoolMutex;
+  std::vector<std::unique_ptr<TargetMachine>> Pool;
+};
+
+/// Runs the session's tasks, i.e. materializations, on a fixed number of
+/// worker threads.
+class WorkerPoolTaskDispatcher : public TaskDispatcher {
+public:
+  WorkerPoolTaskDispatcher(unsigned NumThreads)
+      : Pool(hardware_concurrency(NumThreads)) {}
+
+  void dispatch(std::unique_ptr<Task> T) override {
+    // ThreadPool only takes copyable callables
+    std::shared_ptr<Task> SharedT(std::move(T));
+    Pool.async([SharedT]() { SharedT->run(); });
+  }
+
+  void shutdown() override { Pool.wait(); }
+
+private:
+  ThreadPool Pool;
+};
+
 class KaleidoscopeJIT {
 private:
   std::unique_ptr<ExecutionSession> ES;
@@ -40,25 +143,63 @@ private:
 
   RTDyldObjectLinkingLayer ObjectLayer;
   IRCompileLayer CompileLayer;
+  IRTransformLayer OptimizeLayer;
+
+  // Compiles without backend optimizations, for code that has to be ready
+  // fast rather than run fast. Not cached: tier-0 code refers to objects of
+  // this process by address.
+  IRCompileLayer BaselineCompileLayer;
+
+  // Stubs of the symbols added through addRedirectableSymbols()
+  std::unique_ptr<IndirectStubsManager> ISM;
+
+  // Lazy mode only: modules are split per function, and each body is
+  // optimized and compiled on its first call through a stub
+  std::unique_ptr<LazyCallThroughManager> LCTMgr;
+  std::unique_ptr<CompileOnDemandLayer> CODLayer;
 
   JITDylib &MainJD;
 
+  /// Lazy mode only: where a call goes if the body it needs fails to compile
+  /// (the session reported why). There is no result to return to the caller.
+  static void handleLazyCallThroughError() {
+    errs() << "Error: a function failed to compile on its first call\n";
+    exit(1);
+  }
+
 public:
   KaleidoscopeJIT(std::unique_ptr<ExecutionSession> ES,
-                  JITTargetMachineBuilder JTMB, DataLayout DL)
+                  JITTargetMachineBuilder JTMB, DataLayout DL,
+                  std::unique_ptr<LazyCallThroughManager> LCTMgr = nullptr,
+                  ObjectCacheDirectory *CacheDir = nullptr)
       : ES(std::move(ES)), DL(std::move(DL)), Mangle(*this->ES, this->DL),
         ObjectLayer(*this->ES,
                     []() { return std::make_unique<SectionMemoryManager>(); }),
         CompileLayer(*this->ES, ObjectLayer,
-                     std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
+                     std::make_unique<TargetMachinePoolCompiler>(JTMB,
+                                                                 CacheDir)),
+        OptimizeLayer(*this->ES, CompileLayer),
+        BaselineCompileLayer(
+            *this->ES, ObjectLayer,
+            std::make_unique<TargetMachinePoolCompiler>(
+                JITTargetMachineBuilder(JTMB).setCodeGenOptLevel(
+                    CodeGenOpt::None))),
+        ISM(createLocalIndirectStubsManagerBuilder(JTMB.getTargetTriple())()),
+        LCTMgr(std::move(LCTMgr)),
         MainJD(this->ES->createBareJITDylib("<main>")) {
     MainJD.addGenerator(
         cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
-            DL.getGlobalPrefix())));
+            this->DL.getGlobalPrefix())));
     if (JTMB.getTargetTriple().isOSBinFormatCOFF()) {
       ObjectLayer.setOverrideObjectFlagsWithResponsibilityFlags(true);
       ObjectLayer.setAutoClaimResponsibilityForObjectSymbols(true);
     }
+    if (this->LCTMgr) {
+      CODLayer = std::make_unique<CompileOnDemandLayer>(
+          *this->ES, OptimizeLayer, *this->LCTMgr,
+          createLocalIndirectStubsManagerBuilder(JTMB.getTargetTriple()));
+      CODLayer->setPartitionFunction(CompileOnDemandLayer::compileRequested);
+    }
   }
 
   ~KaleidoscopeJIT() {
@@ -66,8 +207,19 @@ public:
       ES->reportError(std::move(Err));
   }
 
-  static Expected<std::unique_ptr<KaleidoscopeJIT>> Create() {
-    auto EPC = SelfExecutorProcessControl::Create();
+  /// With NumThreads > 1 modules are materialized on that many worker
+  /// threads, otherwise on the thread that looks their symbols up. CacheDir,
+  /// if any, must outlive the JIT.
+  static Expected<std::unique_ptr<KaleidoscopeJIT>>
+  Create(bool Lazy = false, unsigned NumThreads = 1,
+         ObjectCacheDirectory *CacheDir = nullptr) {
+    std::unique_ptr<TaskDispatcher> D;
+    if (NumThreads > 1)
+      D = std::make_unique<WorkerPoolTaskDispatcher>(NumThreads);
+    else
+      D = std::make_unique<InPlaceTaskDispatcher>();
+
+    auto EPC = SelfExecutorProcessControl::Create(nullptr, std::move(D));
     if (!EPC)
       return EPC.takeError();
 
@@ -80,22 +232,148 @@ public:
     if (!DL)
       return DL.takeError();
 
+    std::unique_ptr<LazyCallThroughManager> LCTMgr;
+    if (Lazy) {
+      auto LCTMgrOrErr = createLocalLazyCallThroughManager(
+          JTMB.getTargetTriple(), *ES,
+          ExecutorAddr::fromPtr(&handleLazyCallThroughError));
+      if (!LCTMgrOrErr)
+        return LCTMgrOrErr.takeError();
+      LCTMgr = std::move(*LCTMgrOrErr);
+    }
+
     return std::make_unique<KaleidoscopeJIT>(std::move(ES), std::move(JTMB),
-                                             std::move(*DL));
+                                             std::move(*DL), std::move(LCTMgr),
+                                             CacheDir);
   }
 
   const DataLayout &getDataLayout() const { return DL; }
 
+  /// Replaces the reporter of the errors no caller gets back, such as those
+  /// of a failed materialization, which by default prints them to stderr.
+  void setErrorReporter(ExecutionSession::ErrorReporter Reporter) {
+    ES->setErrorReporter(std::move(Reporter));
+  }
+
   JITDylib &getMainJITDylib() { return MainJD; }
 
+  bool isLazy() const { return CODLayer != nullptr; }
+
+  /// Sets the transform every module goes through right before it is
+  /// compiled. In lazy mode that is each function, on its first call.
+  void setOptimizer(IRTransformLayer::TransformFunction Optimize) {
+    OptimizeLayer.setTransform(std::move(Optimize));
+  }
+
   Error addModule(ThreadSafeModule TSM, ResourceTrackerSP RT = nullptr) {
+    trace::Scope Span("jit-add");
+    if (!RT)
+      RT = MainJD.getDefaultResourceTracker();
+    if (CODLayer)
+      return CODLayer->add(RT, std::move(TSM));
+    return OptimizeLayer.add(RT, std::move(TSM));
+  }
+
+  /// Like addModule, but the whole module is compiled on the first lookup of
+  /// any of its symbols, even in lazy mode. For code that runs right away.
+  Error addEagerModule(ThreadSafeModule TSM, ResourceTrackerSP RT = nullptr) {
+    trace::Scope Span("jit-add");
+    if (!RT)
+      RT = MainJD.getDefaultResourceTracker();
+    return OptimizeLayer.add(RT, std::move(TSM));
+  }
+
+  /// Adds a module compiled without backend optimizations, as soon as any of
+  /// its symbols is looked up.
+  Error addBaselineModule(ThreadSafeModule TSM,
+                          ResourceTrackerSP RT = nullptr) {
+    trace::Scope Span("jit-add");
     if (!RT)
       RT = MainJD.getDefaultResourceTracker();
-    return CompileLayer.add(RT, std::move(TSM));
+    return BaselineCompileLayer.add(RT, std::move(TSM));
+  }
+
+  /// Defines Name as a function of this process, at Addr.
+  Error defineHostFunction(StringRef Name, ExecutorAddr Addr) {
+    SymbolMap Symbols;
+    Symbols[Mangle(Name.str())] = ExecutorSymbolDef(
+        Addr, JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+    return MainJD.define(absoluteSymbols(std::move(Symbols)));
+  }
+
+  /// Defines each of Names as an indirect stub: a jump through a pointer
+  /// that redirect() can change at any time. A stub must not be called
+  /// before its first redirect().
+  Error addRedirectableSymbols(ArrayRef<std::string> Names) {
+    IndirectStubsManager::StubInitsMap StubInits;
+    for (const auto &Name : Names)
+      StubInits[Name] = {ExecutorAddr(), JITSymbolFlags::Exported |
+                                             JITSymbolFlags::Callable};
+    if (auto Err = ISM->createStubs(StubInits))
+      return Err;
+
+    SymbolMap Stubs;
+    for (const auto &Name : Names)
+      Stubs[Mangle(Name)] = ISM->findStub(Name, true);
+    return MainJD.define(absoluteSymbols(std::move(Stubs)));
+  }
+
+  /// Takes Names out of the main JITDylib, for stubs that never got their
+  /// first redirect(). A stub can be added again under the same name.
+  Error removeSymbols(ArrayRef<std::string> Names) {
+    SymbolNameSet Symbols;
+    for (const auto &Name : Names)
+      Symbols.insert(Mangle(Name));
+    return MainJD.remove(Symbols);
+  }
+
+  /// Points the stub of Name at Addr. A call that already went through the
+  /// stub finishes in the old code, every later call goes to Addr.
+  Error redirect(StringRef Name, ExecutorAddr Addr) {
+    return ISM->updatePointer(Name, Addr);
   }
 
+  /// A JITDylib for code of a client of its own: it can call the functions
+  /// of the main JITDylib and of the process, the other clients cannot call
+  /// its functions. Add modules to it through its resource trackers.
+  Expected<JITDylib &> createClientJITDylib(StringRef Name) {
+    auto JD = ES->createJITDylib(Name.str());
+    if (!JD)
+      return JD.takeError();
+    JD->addToLinkOrder(MainJD);
+    return *JD;
+  }
+
+  /// Frees the code of a JITDylib from createClientJITDylib(), which must not
+  /// be used any more.
+  Error removeClientJITDylib(JITDylib &JD) { return ES->removeJITDylib(JD); }
+
+  /// A lookup compiles whatever it needs that was not compiled yet, its
+  /// trace span includes that.
   Expected<ExecutorSymbolDef> lookup(StringRef Name) {
-    return ES->lookup({&MainJD}, Mangle(Name.str()));
+    return lookup(MainJD, Name);
+  }
+
+  /// Looks Name up in JD only, the modules of JD still link against its
+  /// link order.
+  Expected<ExecutorSymbolDef> lookup(JITDylib &JD, StringRef Name) {
+    trace::Scope Span("jit-lookup",
+                      std::string_view(Name.data(), Name.size()));
+    trace::count(trace::Counter::JitLookups);
+    return ES->lookup({&JD}, Mangle(Name.str()));
+  }
+
+  /// Looks all of Names up at once, so that the modules defining them are
+  /// materialized concurrently when there are worker threads.
+  Error materialize(ArrayRef<std::string> Names) {
+    trace::Scope Span("jit-lookup");
+    trace::count(trace::Counter::JitLookups, Names.size());
+
+    SymbolLookupSet Symbols;
+    for (const auto &Name : Names)
+      Symbols.add(Mangle(Name));
+    return ES->lookup(makeJITDylibSearchOrder({&MainJD}), std::move(Symbols))
+        .takeError();
   }
 };
 
@@ -2,6 +2,8 @@
 #define _LLVM_CONTEXT_DATA_HPP_
 
 // LLVMContextData includes
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
@@ -14,49 +16,141 @@
 
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/StandardInstrumentations.h"
+#include "llvm/Target/TargetMachine.h"
 
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar/Reassociate.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
 
-#include <map>
 #include <string_view>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include "OptLevel.hpp"
+#include "PassProfiler.hpp"
+#include "Symbol.hpp"
+
+// A target machine for the host CPU and all of its features, generating code at `level`. nullptr if the host cannot be
+// described, the module pipelines then optimize without any target information.
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(OptLevel level);
+
+// Optimization pipeline, built once and run over every module generated in the same context. `targetMachine` tells
+// the module pipelines about the target(vector widths, costs), it may be nullptr.
 struct LLVMOptContextData {
-    LLVMOptContextData(llvm::LLVMContext& llvmCtx);
+    LLVMOptContextData(llvm::LLVMContext& llvmCtx, OptLevel level, llvm::TargetMachine* targetMachine,
+                       const PassInstrumentation& instrumentation);
     LLVMOptContextData(const LLVMOptContextData&) = delete;
     LLVMOptContextData& operator=(const LLVMOptContextData&) = delete;
     LLVMOptContextData(LLVMOptContextData&&) = delete;
     LLVMOptContextData& operator=(LLVMOptContextData&&) = delete;
     ~LLVMOptContextData() = default;
 
-    // Pass and analysis managers
+    // Drops the cached analysis results, they refer to IR of a module that is gone
+    void clearAnalyses();
+
+    // Runs the pipeline of m_level over `module`, which is about to be compiled and released. The function level
+    // runs over every function defined in it.
+    void optimize(llvm::Module& module);
+
+    const OptLevel m_level;
+
+    // Pass and analysis managers. m_FPM is the function level, m_MPM any other.
     llvm::FunctionPassManager m_FPM;
+    llvm::ModulePassManager m_MPM;
     llvm::LoopAnalysisManager m_LAM;
     llvm::FunctionAnalysisManager m_FAM;
     llvm::CGSCCAnalysisManager m_CGAM;
     llvm::ModuleAnalysisManager m_MAM;
+
+    // Reach the passes only if some instrumentation was asked for, m_SI only for its debug logging
     llvm::PassInstrumentationCallbacks m_PIC;
-    llvm::StandardInstrumentations m_SI;
+    std::unique_ptr<llvm::StandardInstrumentations> m_SI;
 };
 
+// Signatures of the functions of modules handed over to the JIT for good(see LLVMContextData::exportFunctions()).
+// Shared by all the contexts of a program, so that code generated in one context can call functions generated in
+// another one. Every function takes and returns doubles, the number of arguments is all there is to a signature.
+struct ExportedFunction {
+    std::size_t m_arity;
+    bool m_defined;
+
+    // Calls no extern, however indirectly(see Memoizer)
+    bool m_pure;
+
+    // A batch entry point taking arrays(see BatchEntryPoints), not callable from Kaleidoscope code
+    bool m_batchEntry;
+};
+using ExportedFunctions = std::unordered_map<Symbol, ExportedFunction>;
+
+// Code generation state. The context, the builder and the pass pipeline live as long as the object; only the module
+// is replaced every time the previous one is handed over to the JIT. The JIT compiles modules handed over to it
+// synchronously on lookup, so codegen into the next module never races with the compilation of the previous one.
 struct LLVMContextData {
-    LLVMContextData(std::string_view moduleName);
+    // The module levels optimize for `targetMachine`, or for the host if it is nullptr
+    explicit LLVMContextData(
+        std::shared_ptr<ExportedFunctions> exportedFunctions = std::make_shared<ExportedFunctions>(),
+        OptLevel optLevel = OptLevel::Function, std::unique_ptr<llvm::TargetMachine> targetMachine = nullptr,
+        const PassInstrumentation& instrumentation = {});
     LLVMContextData(const LLVMContextData&) = delete;
     LLVMContextData& operator=(const LLVMContextData&) = delete;
     LLVMContextData(LLVMContextData&&) = delete;
     LLVMContextData& operator=(LLVMContextData&&) = delete;
     ~LLVMContextData() = default;
 
-    std::unique_ptr<llvm::LLVMContext> m_llvmContext;
+    // Starts a new, empty module for the following codegen
+    void startModule(std::string_view moduleName, const llvm::DataLayout& dataLayout);
+
+    // Hands the current module over, together with the context it lives in. Call startModule() before generating
+    // any more code.
+    llvm::orc::ThreadSafeModule takeModule();
+
+    // Function `name` of the current module. A function that only exists in a module handed over earlier(see
+    // exportFunctions()) is declared in the current module first. nullptr if there is no such function.
+    llvm::Function* getFunction(Symbol name);
+
+    // Whether a module handed over earlier defines `name`
+    bool isExportedDefinition(Symbol name) const;
+
+    // Whether `name` may be declared with `arity` arguments: every declaration of a name and its definition, in the
+    // current module or in those handed over earlier, take the same number of arguments. Batch entry points cannot be
+    // declared at all.
+    bool isCompatibleDeclaration(Symbol name, std::size_t arity) const;
+
+    // Makes the functions of the current module callable from the modules that follow it. Only for modules that stay
+    // in the JIT for good. Returns the entries it replaced, for withdrawExports().
+    ExportedFunctions exportFunctions();
+
+    // Names of the functions of the current module
+    std::vector<Symbol> functionNames() const;
+
+    // Undoes exportFunctions() for a module the JIT did not take: the entries of `names`, the functions the module had
+    // when it was handed over, are erased and those in `replaced` put back
+    void withdrawExports(const std::vector<Symbol>& names, ExportedFunctions replaced);
+
+    llvm::orc::ThreadSafeContext m_threadSafeContext;
+    llvm::LLVMContext& m_llvmContext;
     llvm::IRBuilder<> m_builder;
     std::unique_ptr<llvm::Module> m_llvmModule;
 
-    std::map<std::string_view, llvm::Value*> m_namedValues;
+    std::unordered_map<Symbol, llvm::Value*> m_namedValues;
+
+    std::shared_ptr<ExportedFunctions> m_exportedFunctions;
+
+    // The target given to the constructor, otherwise the host for the module levels and nullptr for the function level.
+    // Every context has its own, a TargetMachine is not thread-safe.
+    std::unique_ptr<llvm::TargetMachine> m_targetMachine;
 
     LLVMOptContextData m_llvmOpt;
+
+    // Run m_llvmOpt over every function as soon as its body is generated(the function level). Unset when the whole
+    // module is optimized right before the JIT compiles it.
+    bool m_optimizeFunctions;
+
+    // A definition of a name defined in a module handed over earlier replaces that definition(see HotSwapper)
+    // instead of being an error. It still takes the same number of arguments.
+    bool m_allowRedefinition;
 };
 
 #endif  // !_LLVM_CONTEXT_DATA_HPP_
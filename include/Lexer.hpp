@@ -2,10 +2,20 @@
 #define _LEXER_HPP_
 
 #include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <type_traits>
 
-enum class Token {
+#include "CharScanner.hpp"
+#include "SourceBuffer.hpp"
+#include "Symbol.hpp"
+#include "Trace.hpp"
+
+enum class Token : std::uint8_t {
     TOK_EOF,
     TOK_DEF,
     TOK_EXTERN,
@@ -14,132 +24,207 @@ enum class Token {
     TOK_OPERATOR
 };
 
-using TokenValue = std::variant<char, std::string, double>;
+// Payload of a token, the active member is selected by TokenData::m_token
+union TokenValue {
+    constexpr TokenValue()
+        : m_number(0) {
+    }
+    constexpr TokenValue(char op)
+        : m_op(op) {
+    }
+    constexpr TokenValue(Symbol symbol)
+        : m_symbol(symbol) {
+    }
+    constexpr TokenValue(double number)
+        : m_number(number) {
+    }
+
+    char m_op;          // TOK_OPERATOR, TOK_EOF
+    Symbol m_symbol;    // TOK_IDENTIFIER, TOK_DEF, TOK_EXTERN
+    double m_number;    // TOK_NUMBER
+};
 
 struct TokenData {
     Token m_token;
     TokenValue m_value;
 };
 
+static_assert(sizeof(TokenData) == 16 && std::is_trivially_copyable_v<TokenData>,
+              "TokenData is passed around by value on every token");
+
 class Lexer {
-    struct LastCharSaver {
-        char &m_lastChar;
-        Lexer &m_lexer;
-        LastCharSaver(Lexer &lexer, char &lastChar)
-            : m_lexer(lexer)
-            , m_lastChar(lastChar) {
-        }
-        ~LastCharSaver() {
-            m_lexer.m_lastChar = m_lastChar;
-        }
-    };
+public:
+    // Reads stdin in large blocks
+    Lexer()
+        : Lexer(std::make_unique<StreamSource>()) {
+    }
 
-    friend class LastCharSaver;
+    explicit Lexer(std::unique_ptr<SourceBuffer> source)
+        : m_source(std::move(source))
+        , m_cur(nullptr)
+        , m_end(nullptr)
+        , m_scan(scan::kernels())
+        , m_defKeyword(Symbol::intern("def"))
+        , m_externKeyword(Symbol::intern("extern"))
+        , m_tokensLexed(0) {
+    }
+
+    // Counted per lexer rather than per token, the trace only needs the total
+    ~Lexer() {
+        trace::count(trace::Counter::TokensLexed, m_tokensLexed);
+    }
 
-public:
     TokenData getNextToken() {
-        char currentChar = skipSpaces(m_lastChar);
-        LastCharSaver lastCharSaver{*this, currentChar};
+        ++m_tokensLexed;
 
-        // Handle identifiers
-        if (beginsIdentifier(currentChar)) {
-            std::string identifier;
+        while (true) {
+            skipSpaces();
 
-            while (partOfIdentifier(currentChar)) {
-                identifier.push_back(currentChar);
-                currentChar = std::getchar();
+            if (!refill()) {
+                return TokenData{Token::TOK_EOF, static_cast<char>(EOF)};
             }
 
-            if (identifier == "def") {
-                return TokenData{Token::TOK_DEF, identifier};
-            }
-            if (identifier == "extern") {
-                return TokenData{Token::TOK_EXTERN, identifier};
-            }
+            const char currentChar = *m_cur;
 
-            return TokenData{Token::TOK_IDENTIFIER, identifier};
-        }
+            // Handle identifiers
+            if (beginsIdentifier(currentChar)) {
+                const Symbol identifier = Symbol::intern(scanRun(m_scan.m_skipIdentifier));
 
-        // Handle numbers
-        if (beginsNumber(currentChar)) {
-            const double number = std::invoke([&currentChar] {
-                std::string number;
-                int dotsCount = 0;
+                if (identifier == m_defKeyword) {
+                    return TokenData{Token::TOK_DEF, identifier};
+                }
+                if (identifier == m_externKeyword) {
+                    return TokenData{Token::TOK_EXTERN, identifier};
+                }
 
-                while (beginsNumber(currentChar)) {
-                    dotsCount += (currentChar == '.');
+                return TokenData{Token::TOK_IDENTIFIER, identifier};
+            }
 
-                    if (dotsCount > 1) {
-                        break;
+            // Handle numbers
+            if (beginsNumber(currentChar)) {
+                // digits* ('.' digits*)?, a second '.' starts the next token
+                bool seenDot = false;
+                const std::string_view number = scanRun([this, &seenDot](const char *begin, const char *end) {
+                    while (true) {
+                        begin = m_scan.m_skipDigits(begin, end);
+                        if (begin == end || *begin != '.' || seenDot) {
+                            return begin;
+                        }
+                        seenDot = true;
+                        ++begin;
                     }
-                    number.push_back(currentChar);
-                    currentChar = std::getchar();
-                }
+                });
 
                 double numberVal{};
-                if (const auto fcr = std::from_chars(
-                        number.c_str(), number.c_str() + number.size(),
-                        numberVal);
-                    fcr.ec != std::error_code{}) {
-                    numberVal = std::numeric_limits<double>::quiet_NaN();
+                if (!scan::parseSimpleNumber(number, numberVal)) {
+                    if (const auto fcr = std::from_chars(number.data(), number.data() + number.size(), numberVal);
+                        fcr.ec != std::errc{}) {
+                        numberVal = std::numeric_limits<double>::quiet_NaN();
+                    }
                 }
-                return numberVal;
-            });
 
-            return TokenData{Token::TOK_NUMBER, number};
-        }
+                return TokenData{Token::TOK_NUMBER, numberVal};
+            }
+
+            // Handle comments and get the next token if there is still more data in the input stream
+            if (currentChar == '#') {
+                skipLine();
+                continue;
+            }
 
-        // Handle comments
-        if (currentChar == '#') {
-            currentChar = skipLine(currentChar);
+            // Handle operator
+            ++m_cur;
+
+            return TokenData{Token::TOK_OPERATOR, currentChar};
+        }
+    }
 
-            // Recursively get the next token if there is still more data in the
-            // input stream
-            if (currentChar != EOF) {
-                return getNextToken();
+private:
+    // Makes sure there is at least one character to look at. Returns false at the end of the input.
+    bool refill() {
+        while (m_cur == m_end) {
+            const std::string_view chunk = m_source->nextChunk();
+            if (chunk.empty()) {
+                return false;
             }
+
+            m_cur = chunk.data();
+            m_end = chunk.data() + chunk.size();
         }
+        return true;
+    }
 
-        if (currentChar == EOF) {
-            return TokenData{Token::TOK_EOF, static_cast<char>(EOF)};
+    // Consumes the longest run found by `scanner`, a callable that maps [begin, end) to where the run stops within it
+    // and keeps any state it needs across calls. Runs that end inside the current chunk are returned in place; only a
+    // run that reaches the end of a chunk is copied so it can continue into the next one.
+    template <typename Scanner>
+    std::string_view scanRun(Scanner &&scanner) {
+        const char *begin = m_cur;
+        m_cur = scanner(m_cur, m_end);
+
+        if (m_cur != m_end) {
+            return {begin, m_cur};
         }
 
-        // Handle operator
-        const char op = currentChar;
-        currentChar = std::getchar();
+        m_scratch.assign(begin, m_cur);
 
-        return TokenData{Token::TOK_OPERATOR, op};
-    }
+        while (refill()) {
+            begin = m_cur;
+            m_cur = scanner(m_cur, m_end);
+            m_scratch.append(begin, m_cur);
 
-private:
-    static char skipSpaces(char c) {
-        while (std::isspace(c)) {
-            c = std::getchar();
+            if (m_cur != m_end) {
+                break;
+            }
         }
-        return c;
+
+        return m_scratch;
     }
 
-    static char skipLine(char c) {
-        while (c != EOF && c != '\r' && c != '\n') {
-            c = std::getchar();
+    void skipSpaces() {
+        while (refill()) {
+            m_cur = m_scan.m_skipSpaces(m_cur, m_end);
+            if (m_cur != m_end) {
+                return;
+            }
         }
-        return c;
     }
 
-    static bool beginsIdentifier(char c) {
-        return c == '_' || std::isalpha(c);
+    void skipLine() {
+        while (refill()) {
+            m_cur = m_scan.m_skipToLineEnd(m_cur, m_end);
+            if (m_cur != m_end) {
+                return;
+            }
+        }
     }
 
-    static bool partOfIdentifier(char c) {
-        return c == '_' || std::isalnum(c);
+    static bool beginsIdentifier(char c) {
+        return scan::isIdentifierStart(c);
     }
 
     static bool beginsNumber(char c) {
-        return c == '.' || std::isdigit(c);
+        return c == '.' || scan::isDigit(c);
     }
 
 private:
-    char m_lastChar = ' ';
+    std::unique_ptr<SourceBuffer> m_source;
+
+    // Unread part of the current chunk
+    const char *m_cur;
+    const char *m_end;
+
+    // Run scanners picked for the running CPU
+    const scan::Kernels &m_scan;
+
+    // Backing storage for tokens spanning two chunks
+    std::string m_scratch;
+
+    // Keywords are recognized by comparing interned symbols
+    Symbol m_defKeyword;
+    Symbol m_externKeyword;
+
+    std::uint64_t m_tokensLexed;
 };
 
 #endif  // !_LEXER_HPP_
@@ -0,0 +1,101 @@
+#ifndef _MEMOIZER_HPP_
+#define _MEMOIZER_HPP_
+
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Memoization of pure functions(--memoize).
+//
+// Every function takes and returns doubles, so a function that transitively calls no extern computes its result from
+// its arguments alone: it is pure. memoize() finds the pure functions of a module and puts a cache in front of each:
+// the body is renamed to `name.memo` and `name` becomes a wrapper that looks the arguments up first and only calls the
+// body on a miss. Every call goes through the wrapper, the recursive ones included, so a call tree that computes the
+// same values over and over computes each of them once.
+//
+// The caches live in the host: one open-addressing table per function, keyed on the bit patterns of the arguments and
+// bounded in size. Functions without arguments are not memoized, those include the top-level expressions that run once.
+class Memoizer {
+    // Names of the hooks the wrappers call
+    static constexpr const char *kLookupHook = "__kaleidoscope_memo_lookup";
+    static constexpr const char *kStoreHook = "__kaleidoscope_memo_store";
+
+    static constexpr const char *kBodySuffix = ".memo";
+
+public:
+    // Every table holds at most `maxEntries` results(rounded down to a power of two)
+    Memoizer(llvm::orc::KaleidoscopeJIT &jit, std::size_t maxEntries);
+    Memoizer(const Memoizer &) = delete;
+    Memoizer &operator=(const Memoizer &) = delete;
+    Memoizer(Memoizer &&) = delete;
+    Memoizer &operator=(Memoizer &&) = delete;
+    ~Memoizer() = default;
+
+    // Wraps the pure functions defined in `module` before it goes to the JIT. A function declared in `module` is pure
+    // if `exportedFunctions` says so; the pure functions of `module` that are exported are marked there in turn.
+    void memoize(llvm::Module &module, ExportedFunctions &exportedFunctions);
+
+    // Hits, misses and evictions of every table
+    void printStats() const;
+
+private:
+    class MemoTable {
+        // Slots probed for a key before a full table evicts the first of them
+        static constexpr std::size_t kMaxProbes = 8;
+        static constexpr std::size_t kInitialSlots = 64;
+
+    public:
+        MemoTable(std::string name, std::size_t arity, std::size_t maxSlots);
+
+        bool lookup(const double *args, double &result);
+        void store(const double *args, double result);
+
+        std::string m_name;
+        std::uint64_t m_hits = 0;
+        std::uint64_t m_misses = 0;
+        std::uint64_t m_evictions = 0;
+        std::size_t m_size = 0;
+
+    private:
+        std::size_t homeSlot(const double *args) const;
+        bool matches(std::size_t slot, const double *args) const;
+        void put(std::size_t slot, const double *args, double result);
+
+        // Doubles the slots and inserts everything again
+        void grow();
+
+        const std::size_t m_arity;
+        const std::size_t m_maxSlots;
+
+        // Slot i: the arguments m_keys[i * m_arity, (i + 1) * m_arity), the result m_values[i]
+        std::vector<double> m_keys;
+        std::vector<double> m_values;
+        std::vector<bool> m_used;
+    };
+
+    static int lookupHook(MemoTable *table, const double *args, double *result);
+    static void storeHook(MemoTable *table, const double *args, double result);
+
+    // Pure functions defined in `module`: the fixpoint of "calls only pure functions", starting from all of them
+    std::unordered_set<const llvm::Function *> pureFunctions(const llvm::Module &module,
+                                                             const ExportedFunctions &exportedFunctions) const;
+
+    // Renames `func` to the body and generates the wrapper under its name
+    void wrap(llvm::Function &func);
+
+    const std::size_t m_maxSlots;
+
+    // Referenced by address from the generated code, never moved
+    std::deque<MemoTable> m_tables;
+};
+
+#endif  // !_MEMOIZER_HPP_
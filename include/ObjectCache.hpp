@@ -0,0 +1,104 @@
+#ifndef _OBJECT_CACHE_HPP_
+#define _OBJECT_CACHE_HPP_
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Compiled objects in a directory on disk, one file per module, named after the key it was stored under. The total
+// size of the files is capped, the least recently used objects are removed first. Several processes may share a
+// directory: files are only ever replaced as a whole, and the recency of use is the modification time of a file.
+// Thread-safe.
+class ObjectCacheDirectory {
+    static constexpr const char *kExtension = ".o";
+
+public:
+    struct Stats {
+        std::size_t m_hits = 0;
+        std::size_t m_misses = 0;
+        std::size_t m_stored = 0;
+        std::size_t m_evicted = 0;
+        std::uint64_t m_bytes = 0;  // in the directory
+    };
+
+    // Returns nullptr(and reports the reason) if `path` is not a directory and cannot be created as one. Objects
+    // already in it count as used in the order of their modification times, they are evicted down to `maxBytes`.
+    static std::unique_ptr<ObjectCacheDirectory> open(const std::string &path, std::uint64_t maxBytes);
+
+    ObjectCacheDirectory(const ObjectCacheDirectory &) = delete;
+    ObjectCacheDirectory &operator=(const ObjectCacheDirectory &) = delete;
+    ObjectCacheDirectory(ObjectCacheDirectory &&) = delete;
+    ObjectCacheDirectory &operator=(ObjectCacheDirectory &&) = delete;
+    ~ObjectCacheDirectory() = default;
+
+    // The object stored under `key`, nullptr on a miss
+    std::unique_ptr<llvm::MemoryBuffer> load(const std::string &key);
+
+    // Stores `object` under `key` and evicts objects until the directory fits its size cap again. An object bigger
+    // than the cap is not stored.
+    void store(const std::string &key, llvm::MemoryBufferRef object);
+
+    Stats stats() const;
+
+private:
+    ObjectCacheDirectory(std::filesystem::path path, std::uint64_t maxBytes);
+
+    struct Entry {
+        std::string m_key;
+        std::uint64_t m_size;
+    };
+
+    std::filesystem::path pathOf(const std::string &key) const;
+
+    // Moves the entry of `key` to the front of m_lru
+    void touch(const std::string &key);
+
+    void evictDownTo(std::uint64_t maxBytes);
+
+    const std::filesystem::path m_path;
+    const std::uint64_t m_maxBytes;
+
+    mutable std::mutex m_mutex;
+
+    // Most recently used first
+    std::list<Entry> m_lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+
+    Stats m_stats;
+};
+
+// llvm::ObjectCache over an ObjectCacheDirectory for the objects of one code generator(`targetMachine` or any other
+// TargetMachine configured the same way). The key of a module is a hash of its IR(as the compiler receives it, i.e.
+// optimized) and of everything about the code generator that changes the object: target triple, CPU, features and
+// optimization level.
+class TargetObjectCache : public llvm::ObjectCache {
+public:
+    TargetObjectCache(ObjectCacheDirectory &directory, const llvm::TargetMachine &targetMachine);
+
+    void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override;
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override;
+
+private:
+    std::string keyOf(const llvm::Module &module) const;
+
+    ObjectCacheDirectory &m_directory;
+    const std::string m_target;
+
+    // Code generation may change the module, its key is computed once: when the compiler asks for the object. Entries
+    // live until the object is compiled.
+    std::mutex m_pendingMutex;
+    std::unordered_map<const llvm::Module *, std::string> m_pendingKeys;
+};
+
+#endif  // !_OBJECT_CACHE_HPP_
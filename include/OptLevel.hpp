@@ -0,0 +1,40 @@
+#ifndef _OPT_LEVEL_HPP_
+#define _OPT_LEVEL_HPP_
+
+#include <optional>
+#include <string_view>
+
+// How generated code is optimized before it is compiled
+enum class OptLevel {
+    // The function pipeline(InstCombine, Reassociate, GVN, SimplifyCFG) over every function as soon as it is generated
+    Function,
+
+    // LLVM's default module pipelines, over the whole module right before the JIT compiles it
+    O0,
+    O1,
+    O2,
+    O3,
+};
+
+// Whether `level` runs a module pipeline
+constexpr bool isModuleLevel(OptLevel level) {
+    return level != OptLevel::Function;
+}
+
+// The level of a -O<level> command line argument, std::nullopt for anything else
+constexpr std::optional<OptLevel> parseOptLevel(std::string_view arg) {
+    if (arg == "-Ofunction") {
+        return OptLevel::Function;
+    } else if (arg == "-O0") {
+        return OptLevel::O0;
+    } else if (arg == "-O1") {
+        return OptLevel::O1;
+    } else if (arg == "-O2") {
+        return OptLevel::O2;
+    } else if (arg == "-O3") {
+        return OptLevel::O3;
+    }
+    return std::nullopt;
+}
+
+#endif  // !_OPT_LEVEL_HPP_
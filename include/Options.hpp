@@ -0,0 +1,100 @@
+#ifndef _OPTIONS_HPP_
+#define _OPTIONS_HPP_
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include "OptLevel.hpp"
+
+// What runs the program: LLVM's JIT, or the bytecode interpreter that starts without compiling anything
+enum class Engine { Jit, Interp };
+
+// Command line of the kaleidoscope executable
+struct Options {
+    // Program to run, stdin if empty
+    std::string m_inputFile;
+
+    // Compile the whole input into one module, hand it to the JIT once, then run the top-level expressions in order
+    bool m_batch = false;
+
+    // Print the generated IR in batch mode
+    bool m_emitIR = false;
+
+    OptLevel m_optLevel = OptLevel::Function;
+
+    Engine m_engine = Engine::Jit;
+
+    // Compile every function on its first call instead of when its module is handed to the JIT
+    bool m_lazy = false;
+
+    // Worker threads compiling modules for the JIT, 1 compiles on the main thread
+    std::size_t m_jitThreads = 1;
+
+    // Batch mode only: threads lexing, parsing and generating code for pieces of the program(see ParallelFrontEnd), 1
+    // does it all on the main thread as the items are read
+    std::size_t m_parseThreads = 1;
+
+    // Compile every function quickly first, then again with full optimization once it was called m_tierThreshold times
+    bool m_tiered = false;
+    std::size_t m_tierThreshold = 1000;
+
+    // Allow a function to be defined again: its callers call the new definition from then on(see HotSwapper). REPL
+    // only.
+    bool m_hotSwap = false;
+
+    // Serve sessions on a Unix domain socket at m_serveSocket instead of running a program(see Server), on
+    // m_serveThreads workers(0: one per core). Every session can call the functions of m_preloadFile, compiled once.
+    std::string m_serveSocket;
+    std::size_t m_serveThreads = 0;
+    std::string m_preloadFile;
+
+    // Directory of compiled objects kept across runs, none if empty. Capped at m_objectCacheMegabytes, the least
+    // recently used objects are removed first.
+    std::string m_objectCache;
+    std::size_t m_objectCacheMegabytes = 256;
+
+    // Print the hits and misses of the object cache at exit
+    bool m_cacheStats = false;
+
+    // Cache the results of the functions that call no extern(see Memoizer), at most m_memoEntries per function. The
+    // hits and misses of every function are printed at exit with m_memoStats.
+    bool m_memoize = false;
+    std::size_t m_memoEntries = 1 << 16;
+    bool m_memoStats = false;
+
+    // Generate a vectorized `f_batch` over arrays next to every function `f`(see BatchEntryPoints)
+    bool m_batchEntries = false;
+
+    // Print every optimization pass as it runs, and/or profile the passes and print a report at exit(see
+    // PassProfiler)
+    bool m_debugPasses = false;
+    bool m_passProfile = false;
+
+    // Time the compiler phases and count what they produce(see Trace.hpp): write the spans to m_traceFile as
+    // trace-event JSON and/or print a summary at exit
+    std::string m_traceFile;
+    bool m_traceSummary = false;
+
+    // Ahead-of-time compilation instead of running anything: the object file and/or static library to write, and the
+    // C header declaring their functions(next to the first output, with a .h extension, unless given)
+    std::string m_emitObj;
+    std::string m_emitLib;
+    std::string m_emitHeader;
+
+    // Target of the ahead-of-time compilation, the host if empty. A CPU without a triple is a CPU of the host's
+    // architecture.
+    std::string m_targetTriple;
+    std::string m_targetCPU;
+
+    bool aheadOfTime() const {
+        return !m_emitObj.empty() || !m_emitLib.empty();
+    }
+
+    // Prints the reason and the usage and returns std::nullopt for a bad command line
+    static std::optional<Options> parse(int argc, char **argv);
+
+    static void printUsage(const char *programName);
+};
+
+#endif  // !_OPTIONS_HPP_
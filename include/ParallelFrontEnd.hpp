@@ -0,0 +1,88 @@
+#ifndef _PARALLEL_FRONT_END_HPP_
+#define _PARALLEL_FRONT_END_HPP_
+
+#include "ConstantFolder.hpp"
+#include "ExpressionsAST.hpp"
+#include "LLVMContextData.hpp"
+#include "Parser.hpp"
+#include "Symbol.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A top-level expression of a batch program: the function wrapping it, or its value if it was folded
+struct TopLevelExpression {
+    Symbol m_name;
+    std::optional<double> m_value;
+};
+
+// Front end of batch mode over a whole program held in memory(--parse-threads).
+//
+// A quick scan splits the program into pieces that begin at top-level items: at a 'def' or an 'extern', or right after
+// a top-level ';'. Every piece is lexed and parsed on a thread of its own. A single pass over the parsed items then
+// merges their prototypes into one table and folds the constant expressions, in input order. Every piece is finally
+// generated into the current module of a context of its own, again in parallel; the table tells it the functions of
+// the pieces before it.
+//
+// A program compiles as it would in one piece: an item only sees the items before it, calls to a function defined
+// further down fail as they always do. Only the recovery from a syntax error may differ, at the beginning of a piece.
+class ParallelFrontEnd {
+    // Pieces smaller than this are not worth a thread of their own
+    static constexpr std::size_t kMinPieceBytes = 16 * 1024;
+
+public:
+    // Folds with `folder`, and names the expressions it compiles `expressionPrefix` followed by a number
+    ParallelFrontEnd(ConstantFolder &folder, std::string_view expressionPrefix);
+    ParallelFrontEnd(const ParallelFrontEnd &) = delete;
+    ParallelFrontEnd &operator=(const ParallelFrontEnd &) = delete;
+    ParallelFrontEnd(ParallelFrontEnd &&) = delete;
+    ParallelFrontEnd &operator=(ParallelFrontEnd &&) = delete;
+    ~ParallelFrontEnd() = default;
+
+    // At most `pieces` consecutive pieces of `program`, every one of them beginning at a top-level item
+    static std::vector<std::string_view> split(std::string_view program, std::size_t pieces);
+
+    // Generates code for `program`, piece i into the current module of contexts[i], and appends its top-level
+    // expressions to `expressions` in input order. The errors are printed in input order once everything is generated.
+    // The modules have to be handed over in the order of the contexts. Returns the number of items that failed to
+    // parse or compile.
+    int compile(std::string_view program, std::span<const std::unique_ptr<LLVMContextData>> contexts,
+                std::vector<TopLevelExpression> &expressions);
+
+private:
+    // A top-level item and what became of it
+    struct Item {
+        Parser::TopLevel m_kind;
+
+        // Definition and Expression, nullptr if it failed to parse
+        std::unique_ptr<FunctionAST> m_function;
+
+        // Extern, nullptr if it failed to parse
+        std::unique_ptr<PrototypeAST> m_prototype;
+
+        // Expression folded while merging, it is not compiled
+        std::optional<double> m_value;
+
+        bool m_compiled = false;
+
+        // Errors while parsing and generating it, printed in input order
+        std::vector<std::string> m_messages;
+    };
+
+    static std::vector<Item> parse(std::string_view piece);
+
+    // Declares the prototypes of `items` in `table` and folds what it can, `expressionIndex` numbers the expressions
+    void merge(std::vector<Item> &items, ExportedFunctions &table, std::size_t &expressionIndex);
+
+    static void generate(std::vector<Item> &items, LLVMContextData &ctxData);
+
+    ConstantFolder &m_folder;
+    const std::string m_expressionPrefix;
+};
+
+#endif  // !_PARALLEL_FRONT_END_HPP_
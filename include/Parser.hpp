@@ -3,147 +3,116 @@
 
 #include "ExpressionsAST.hpp"
 #include "Lexer.hpp"
-#include "LLVMContextData.hpp"
+#include "Trace.hpp"
 
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
-
-#include "KaleidoscopeJIT.h"
+#include "llvm/ADT/SmallVector.h"
 
 #include <cassert>
+#include <functional>
 #include <map>
+#include <optional>
 
+// Recursive-descent parser for the Kaleidoscope grammar. It only builds ASTs; what happens with every top-level item
+// is up to the caller(see Driver).
 class Parser {
     static const inline std::map<char, int> BinOpPrecedence{
         {'<', 10}, {'+', 20}, {'-', 20}, {'*', 40}};
 
     static const char EOS = ';'; // end of statement
 
-    static constexpr const char *kModuleName = "Kaleidoscope goes jiitttt";
-    static constexpr const char *kAnonExprIdentifier = "__anon_expr";
+public:
+    /// top ::= definition | external | expression | ';'
+    enum class TopLevel {
+        EndOfInput,
+        Definition,
+        Extern,
+        Expression,
+        Separator
+    };
 
-    static std::unique_ptr<LLVMContextData> initializeLLVMContextData(std::string_view moduleName,
-                                                                                    const llvm::orc::KaleidoscopeJIT &JIT) {
-        auto llvmCtxData = std::make_unique<LLVMContextData>(moduleName);
-        llvmCtxData->m_llvmModule->setDataLayout(JIT.getDataLayout());
-        return llvmCtxData;
+    Parser(Lexer &lexer)
+        : m_lexer(lexer) {
     }
 
-    void updateLLVMContextData(std::string_view moduleName = kModuleName) {
-        m_llvmCtxData = initializeLLVMContextData(kModuleName, *m_JIT);
+    // Reads the first token, call before anything else
+    void start() {
+        advanceCurrentToken();
     }
 
-public:
-    Parser(Lexer &lexer)
-        : m_lexer(lexer)
-        , m_llvmCtxData()
-        , m_JIT() {
-        llvm::InitializeNativeTarget();
-        llvm::InitializeNativeTargetAsmParser();
-        llvm::InitializeNativeTargetAsmPrinter();
-
-        llvm::ExitOnError{}(llvm::orc::KaleidoscopeJIT::Create().moveInto(m_JIT));
-        m_llvmCtxData = initializeLLVMContextData(kModuleName, *m_JIT);
+    // Kind of the top-level item starting at the current token
+    TopLevel peekTopLevel() const {
+        switch (m_currentToken.m_token) {
+            case Token::TOK_EOF:
+                return TopLevel::EndOfInput;
+            case Token::TOK_DEF:
+                return TopLevel::Definition;
+            case Token::TOK_EXTERN:
+                return TopLevel::Extern;
+            case Token::TOK_OPERATOR:
+                if (isOperator(m_currentToken, EOS)) {
+                    return TopLevel::Separator;
+                }
+                // fallthrough to top-level expression for operators that are not ';'
+            default:
+                return TopLevel::Expression;
+        }
     }
 
-    ~Parser() {
-        // Print everything on exit
-        m_llvmCtxData->m_llvmModule->print(llvm::outs(), nullptr);
+    // Eats a top-level ';'
+    void skipSeparator() {
+        advanceCurrentToken();
     }
 
-    /// top ::= definition | external | expression | ';'
-    void mainLoop() {
-        const auto printPrompt = [] { std::cout << "ready> "; };
-
-        printPrompt();
+    /// definition ::= 'def' prototype expression
+    std::unique_ptr<FunctionAST> parseDefinition() {
+        trace::Scope scope{"parse"};
+        m_pool.clear();
 
-        // Read the first token
+        // eat def
         advanceCurrentToken();
 
-        while (true) {
-            switch (m_currentToken.m_token) {
-                case Token::TOK_EOF:
-                    std::cout << "EOF\n";
-                    return;
-                case Token::TOK_DEF:
-                    handleDefinition();
-                    break;
-                case Token::TOK_EXTERN:
-                    handleExtern();
-                    break;
-                case Token::TOK_OPERATOR:
-                    // Ignore top-level semicolons
-                    if (isOperator(m_currentToken, EOS)) {
-                        printPrompt();
-                        advanceCurrentToken();
-                        break;
-                    }
-                    // fallthrough to top-level expression for operators that are not ';'
-                default:
-                    handleTopLevelExpression();
-                    break;
-            }
+        auto proto = parsePrototype();
+        if (!proto) {
+            return nullptr;
         }
-    }
-
-private:
-    void handleDefinition() {
-        if (const auto funcDef = parseDefinition(); funcDef) {
-            std::cout << "Parsed a function definition\n";
 
-            if (const auto value = funcDef->codegen(*m_llvmCtxData); value) {
-                value->print(llvm::outs());
-                std::cout << '\n';
-            }
+        if (!parseExpression()) {
+            return nullptr;
         }
-    }
 
-    void handleExtern() {
-        if (const auto externProto = parseExtern(); externProto) {
-            std::cout << "Parsed an extern\n";
-
-            if (const auto value = externProto->codegen(*m_llvmCtxData); value) {
-                value->print(llvm::outs());
-                std::cout << '\n';
-            }
-        }
+        trace::count(trace::Counter::AstNodes, m_pool.size());
+        return std::make_unique<FunctionAST>(std::move(*proto), std::move(m_pool));
     }
 
-    void handleTopLevelExpression() {
-        if (const auto anonFunc = parseTopLevelExpr(); anonFunc) {
-            std::cout << "Parsed a top-level expr\n";
-
-            if (const auto value = anonFunc->codegen(*m_llvmCtxData); value) {
-                value->print(llvm::outs());
-                std::cout << '\n';
-
-                // Remove anon function from the LLVM Module(unlink + delete)
-                // value->eraseFromParent();
-
-                // Create a ResourceTracker to track JIT'd memory allocated to our anonymous
-                // expression -- that way we can free it after executing
-                auto resourceTracker = m_JIT->getMainJITDylib().createResourceTracker();
+    /// external ::= 'extern' prototype
+    std::unique_ptr<PrototypeAST> parseExtern() {
+        trace::Scope scope{"parse"};
 
-                auto threadSafeModule =
-                    llvm::orc::ThreadSafeModule(std::move(m_llvmCtxData->m_llvmModule), std::move(m_llvmCtxData->m_llvmContext));
+        // eat extern
+        advanceCurrentToken();
+        return parsePrototype();
+    }
 
-                llvm::ExitOnError{}(m_JIT->addModule(std::move(threadSafeModule), resourceTracker));
+    /// toplevelexpr ::= expression
+    // The expression becomes the body of a nullary function called `name`
+    std::unique_ptr<FunctionAST> parseTopLevelExpr(Symbol name) {
+        trace::Scope scope{"parse"};
+        m_pool.clear();
 
-                // We lost the module -> create new one(just build the whole LLVM context with all passes and managers)
-                updateLLVMContextData();
+        if (!parseExpression()) {
+            return nullptr;
+        }
 
-                // Search the JIT for the __anon_expr symbol
-                auto exprSymbol = llvm::ExitOnError{}(m_JIT->lookup(kAnonExprIdentifier));
+        trace::count(trace::Counter::AstNodes, m_pool.size());
 
-                // Get the symbol's address and cast it to the right type (takes no arguments, returns a double) so we can call
-                // it as a native function
-                double (*nativeAnonFunc)() = exprSymbol.getAddress().toPtr<double (*)()>();
-                std::cout << "Evaluated to " << nativeAnonFunc() << '\n';
+        // Make an anonymous proto
+        auto proto = std::make_unique<PrototypeAST>(name, std::vector<Symbol>());
+        return std::make_unique<FunctionAST>(std::move(*proto), std::move(m_pool));
+    }
 
-                // Delete the anonymous expression module from the JIT
-                llvm::ExitOnError{}(resourceTracker->remove());
-            }
-        }
+    // Takes back the storage of a handled function's body for the next item
+    void recycle(FunctionAST &func) {
+        m_pool = std::move(func.m_body);
     }
 
 private:
@@ -151,14 +120,12 @@ private:
     ///   ::= identifierexpr
     ///   ::= numberexpr
     ///   ::= parenexpr
-    std::unique_ptr<ExprAST> parsePrimary() {
+    std::optional<ExprId> parsePrimary() {
         switch (m_currentToken.m_token) {
             case Token::TOK_IDENTIFIER:
-                return parseIdentifierExpr(
-                    std::get<std::string>(std::move(m_currentToken.m_value)));
+                return parseIdentifierExpr(m_currentToken.m_value.m_symbol);
             case Token::TOK_NUMBER:
-                return parseNumberExpr(
-                    std::get<double>(std::move(m_currentToken.m_value)));
+                return parseNumberExpr(m_currentToken.m_value.m_number);
             case Token::TOK_OPERATOR:
                 if (openParen(m_currentToken)) {
                     return parseParenExpr();
@@ -175,8 +142,7 @@ private:
 
     /// binoprhs
     ///   ::= ('+' primary)*
-    std::unique_ptr<ExprAST> parseBinOpRhs(int minExprPrec,
-                                           std::unique_ptr<ExprAST> lhs) {
+    std::optional<ExprId> parseBinOpRhs(int minExprPrec, ExprId lhs) {
         // If this is a binop, find its precedence.
         while (true) {
             const int tokPrec = getTokenPrecedence(m_currentToken);
@@ -194,7 +160,7 @@ private:
 
             auto rhs = parsePrimary();
             if (!rhs) {
-                return nullptr;
+                return std::nullopt;
             }
 
             const int nextTokPrec = getTokenPrecedence(m_currentToken);
@@ -202,31 +168,30 @@ private:
             // If BinOp binds less tightly with RHS than the operator after RHS,
             // let the pending operator take RHS as its LHS.
             if (tokPrec < nextTokPrec) {
-                rhs = parseBinOpRhs(minExprPrec + 1, std::move(rhs));
+                rhs = parseBinOpRhs(minExprPrec + 1, *rhs);
                 if (!rhs) {
-                    return nullptr;
+                    return std::nullopt;
                 }
             }
 
             assert(binOp.m_token == Token::TOK_OPERATOR &&
                    "First BinOp in sequence is not a binary operator");
 
-            lhs = std::make_unique<BinaryExprAST>(
-                std::get<char>(binOp.m_value), std::move(lhs), std::move(rhs));
+            lhs = m_pool.addBinary(binOp.m_value.m_op, lhs, *rhs);
         }
 
-        return nullptr;
+        return std::nullopt;
     }
 
     /// expression
     ///   ::= primary binoprhs
-    std::unique_ptr<ExprAST> parseExpression() {
+    std::optional<ExprId> parseExpression() {
         auto lhs = parsePrimary();
         if (!lhs) {
-            return nullptr;
+            return std::nullopt;
         }
 
-        return parseBinOpRhs(0, std::move(lhs));
+        return parseBinOpRhs(0, *lhs);
     }
 
     /// prototype
@@ -236,7 +201,7 @@ private:
             return utils::logErrorProto("Expected function name in prototype");
         }
 
-        std::string fnName = std::get<std::string>(m_currentToken.m_value);
+        const Symbol fnName = m_currentToken.m_value.m_symbol;
 
         // eat function identifier
         advanceCurrentToken();
@@ -249,14 +214,14 @@ private:
         advanceCurrentToken();
 
         // Read the list of argument names
-        std::vector<std::string> args;
+        std::vector<Symbol> args;
 
         while (true) {
             if (m_currentToken.m_token != Token::TOK_IDENTIFIER) {
                 break;
             }
 
-            args.push_back(std::get<std::string>(m_currentToken.m_value));
+            args.push_back(m_currentToken.m_value.m_symbol);
 
             // eat arg identifier
             advanceCurrentToken();
@@ -269,53 +234,12 @@ private:
         // eat )
         advanceCurrentToken();
 
-        return std::make_unique<PrototypeAST>(std::move(fnName),
-                                              std::move(args));
-    }
-
-    /// definition ::= 'def' prototype expression
-    std::unique_ptr<FunctionAST> parseDefinition() {
-        // eat def
-        advanceCurrentToken();
-
-        auto proto = parsePrototype();
-        if (!proto) {
-            return nullptr;
-        }
-
-        auto expr = parseExpression();
-        if (!expr) {
-            return nullptr;
-        }
-
-        return std::make_unique<FunctionAST>(std::move(*proto),
-                                             std::move(expr));
-    }
-
-    /// external ::= 'extern' prototype
-    std::unique_ptr<PrototypeAST> parseExtern() {
-        // eat extern
-        advanceCurrentToken();
-        return parsePrototype();
-    }
-
-    /// toplevelexpr ::= expression
-    std::unique_ptr<FunctionAST> parseTopLevelExpr() {
-        auto expr = parseExpression();
-        if (!expr) {
-            return nullptr;
-        }
-
-        // Make an anonymous proto
-        auto proto =
-            std::make_unique<PrototypeAST>(kAnonExprIdentifier, std::vector<std::string>());
-        return std::make_unique<FunctionAST>(std::move(*proto),
-                                             std::move(expr));
+        return std::make_unique<PrototypeAST>(fnName, std::move(args));
     }
 
     /// numberexpr ::= number
-    std::unique_ptr<ExprAST> parseNumberExpr(double value) {
-        auto result = std::make_unique<NumberExprAST>(value);
+    std::optional<ExprId> parseNumberExpr(double value) {
+        const ExprId result = m_pool.addNumber(value);
 
         // eat number
         advanceCurrentToken();
@@ -326,20 +250,20 @@ private:
     /// identifierexpr
     ///   ::= identifier
     ///   ::= identifier '(' expression* ')'
-    std::unique_ptr<ExprAST> parseIdentifierExpr(std::string value) {
+    std::optional<ExprId> parseIdentifierExpr(Symbol value) {
         // eat identifier
         advanceCurrentToken();
 
         // Handle variable
         if (!openParen(m_currentToken)) {
-            return std::make_unique<VariableExprAST>(std::move(value));
+            return m_pool.addVariable(value);
         }
 
         // eat (
         advanceCurrentToken();
 
         // Handle function call
-        std::vector<std::unique_ptr<ExprAST>> args;
+        llvm::SmallVector<ExprId, 8> args;
 
         while (true) {
             if (closeParen(m_currentToken)) {
@@ -348,10 +272,10 @@ private:
 
             auto arg = parseExpression();
             if (!arg) {
-                return nullptr;
+                return std::nullopt;
             }
 
-            args.push_back(std::move(arg));
+            args.push_back(*arg);
 
             if (!comma(m_currentToken)) {
                 if (closeParen(m_currentToken)) {
@@ -368,11 +292,11 @@ private:
         // eat )
         advanceCurrentToken();
 
-        return std::make_unique<CallExprAST>(std::move(value), std::move(args));
+        return m_pool.addCall(value, args);
     }
 
     /// parenexpr ::= '(' expression ')'
-    std::unique_ptr<ExprAST> parseParenExpr() {
+    std::optional<ExprId> parseParenExpr() {
         // eat (
         advanceCurrentToken();
 
@@ -397,7 +321,7 @@ private:
 
     static bool isOperator(const TokenData &td, char op) {
         return td.m_token == Token::TOK_OPERATOR &&
-               std::get<char>(td.m_value) == op;
+               td.m_value.m_op == op;
     }
 
     static bool openParen(const TokenData &td) {
@@ -415,7 +339,7 @@ private:
     static int getTokenPrecedence(const TokenData &td) {
         const char c = std::invoke([&td] {
             if (td.m_token == Token::TOK_OPERATOR) {
-                return std::get<char>(td.m_value);
+                return td.m_value.m_op;
             }
             return '\0';
         });
@@ -426,11 +350,11 @@ private:
 
 private:
     Lexer &m_lexer;
-    TokenData m_currentToken;
-
-    std::unique_ptr<LLVMContextData> m_llvmCtxData;
+    TokenData m_currentToken{};
 
-    std::unique_ptr<llvm::orc::KaleidoscopeJIT> m_JIT;
+    // Expression of the item being parsed, handed over to its FunctionAST once complete and given back through
+    // recycle() so that its storage is reused by the next item
+    ExprPool m_pool;
 };
 
 #endif  // !_PARSER_H_
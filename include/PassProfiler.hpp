@@ -0,0 +1,60 @@
+#ifndef _PASS_PROFILER_HPP_
+#define _PASS_PROFILER_HPP_
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/PassInstrumentation.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Wall time and IR instruction delta of every pass run by the pipelines it is registered with, added up per pass and
+// per function. The time of a pass includes the analyses it asks for. Pass managers and adaptors are not passes of
+// their own, their time is that of the passes they run. Thread-safe, several pipelines may run at the same time(every
+// one of them on a single thread).
+class PassProfiler {
+public:
+    PassProfiler() = default;
+    PassProfiler(const PassProfiler &) = delete;
+    PassProfiler &operator=(const PassProfiler &) = delete;
+    PassProfiler(PassProfiler &&) = delete;
+    PassProfiler &operator=(PassProfiler &&) = delete;
+    ~PassProfiler() = default;
+
+    // Profiles the passes run through `callbacks`, which must not outlive the profiler
+    void registerCallbacks(llvm::PassInstrumentationCallbacks &callbacks);
+
+    // The passes by time spent in them and the functions that took longest to optimize, to std::cout
+    void printReport() const;
+
+private:
+    struct Totals {
+        std::uint64_t m_runs = 0;
+        std::chrono::nanoseconds m_time{};
+        std::int64_t m_instructionDelta = 0;
+    };
+
+    void record(llvm::StringRef pass, const std::string &function, std::chrono::nanoseconds time,
+                std::int64_t instructionDelta);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Totals> m_passes;
+    std::unordered_map<std::string, Totals> m_functions;
+};
+
+// How the optimization pipelines are instrumented, not at all by default
+struct PassInstrumentation {
+    // Print every pass as it runs(LLVM's StandardInstrumentations)
+    bool m_debugLogging = false;
+
+    // Shared by all the pipelines of a program, must outlive them
+    PassProfiler *m_profiler = nullptr;
+
+    bool enabled() const {
+        return m_debugLogging || m_profiler;
+    }
+};
+
+#endif  // !_PASS_PROFILER_HPP_
@@ -0,0 +1,158 @@
+#ifndef _SERVER_HPP_
+#define _SERVER_HPP_
+
+#include "ConstantFolder.hpp"
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "OptLevel.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Evaluation server on a Unix domain socket(--serve).
+//
+// Every connection is a session of its own, like a REPL: a request is a line of Kaleidoscope(any number of items), the
+// answer a line too, "ok" followed by the value of every top-level expression of the request, or "error" followed by
+// what went wrong. The definitions of a session stay until it disconnects and only that session sees them.
+//
+// Each session generates code in a context of its own(a ThreadSafeContext) into a JITDylib of its own. All of them are
+// linked against the main JITDylib, which holds the preloaded library: it is compiled once, when the server starts,
+// and every session can call its functions but not define them again. The requests are compiled and run by a pool of
+// worker threads shared by all the sessions; the requests of one session run one after the other, in order, those of
+// different sessions in parallel.
+//
+// A session runs arbitrary code in the server process, externs included. The socket is only accessible to its owner.
+class Server {
+    static constexpr const char *kModuleName = "Kaleidoscope session";
+    static constexpr const char *kAnonExprIdentifier = "__anon_expr";
+
+    // A session sending a longer line is disconnected
+    static constexpr std::size_t kMaxRequestBytes = 1 << 20;
+
+public:
+    // Listens at `socketPath`(a stale socket there is replaced) with `threads` workers, after compiling `library` into
+    // the main JITDylib. nullptr(and the reason printed) if the library does not compile or the socket cannot be set
+    // up.
+    static std::unique_ptr<Server> open(const std::string &socketPath, unsigned threads, OptLevel optLevel,
+                                        std::string_view library);
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+    Server(Server &&) = delete;
+    Server &operator=(Server &&) = delete;
+    ~Server();
+
+    // Accepts sessions and serves their requests until stop(), then closes the sessions still connected
+    void run();
+
+    // Makes run() return, right away if it was not called yet. Callable from any thread and from a signal handler.
+    void stop();
+
+    // Requests answered so far
+    std::uint64_t requests() const {
+        return m_requests.load(std::memory_order_relaxed);
+    }
+
+private:
+    // A connected client. m_input belongs to the thread of run(), m_requests and m_scheduled are guarded by m_mutex,
+    // the rest belongs to the worker running the session's requests.
+    struct Session {
+        Session(Server &server, int fd, std::uint64_t id);
+        Session(const Session &) = delete;
+        Session &operator=(const Session &) = delete;
+        Session(Session &&) = delete;
+        Session &operator=(Session &&) = delete;
+
+        // Frees the code of the session and closes the connection
+        ~Session();
+
+        Server &m_server;
+        const int m_fd;
+        const std::uint64_t m_id;
+
+        // Received, not a whole line yet
+        std::string m_input;
+
+        // Whole lines waiting for a worker
+        std::deque<std::string> m_requests;
+
+        // In m_runQueue or being run by a worker
+        bool m_scheduled = false;
+
+        // Set up by the worker running the first request, so that accepting a client stays cheap
+        llvm::orc::JITDylib *m_dylib = nullptr;
+        std::unique_ptr<LLVMContextData> m_ctxData;
+        ConstantFolder m_folder;
+
+        // The current module of m_ctxData holds definitions or externs
+        bool m_pendingItems = false;
+    };
+
+    Server(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit, OptLevel optLevel, unsigned threads);
+
+    // Compiles the definitions and externs of `library` into the main JITDylib, right away. False(and the reason
+    // printed) if any item fails.
+    bool preload(std::string_view library);
+
+    // Binds and listens at `socketPath`, false(and the reason printed) if it cannot
+    bool listen(const std::string &socketPath);
+
+    // The loop of a worker thread: runs the requests of the sessions in m_runQueue, one request at a time
+    void work();
+
+    // Evaluates `request` in `session` and returns the answer, a whole line
+    std::string evaluate(Session &session, std::string_view request);
+
+    // Creates the JITDylib and the context of `session`, false(and the reason in `messages`) if it cannot
+    bool startSession(Session &session, std::vector<std::string> &messages);
+
+    // Compiles the top-level expression generated into the current module of `session` and runs it
+    std::optional<double> runExpression(Session &session, std::vector<std::string> &messages);
+
+    // Hands the current module of `session` over to its JITDylib for good
+    void handOverDefinitions(Session &session, std::vector<std::string> &messages);
+
+    // Thread of run(): reads from `session`, its whole lines go to m_runQueue. False once the client disconnected or
+    // sent an overlong line.
+    bool receive(const std::shared_ptr<Session> &session);
+
+    std::unique_ptr<llvm::orc::KaleidoscopeJIT> m_JIT;
+    const OptLevel m_optLevel;
+    const unsigned m_threads;
+
+    // The functions of the library and those of them that fold, every session starts from a copy
+    ExportedFunctions m_libraryFunctions;
+    ConstantFolder m_libraryFolder;
+
+    std::string m_socketPath;
+    int m_listenFd = -1;
+
+    // stop() writes to the one end, run() polls the other
+    int m_wakeFds[2] = {-1, -1};
+
+    // Thread of run() only
+    std::unordered_map<int, std::shared_ptr<Session>> m_sessions;
+    std::uint64_t m_sessionIds = 0;
+
+    // Sessions with requests and no worker, in the order they got them
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::deque<std::shared_ptr<Session>> m_runQueue;
+    bool m_stopping = false;
+
+    std::vector<std::thread> m_workers;
+    std::atomic<std::uint64_t> m_requests = 0;
+};
+
+#endif  // !_SERVER_HPP_
@@ -0,0 +1,90 @@
+#ifndef _SOURCE_BUFFER_HPP_
+#define _SOURCE_BUFFER_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <unistd.h>
+
+// Input of the Lexer. A source hands out its contents as a sequence of contiguous chunks, so the lexer can scan
+// directly over memory instead of pulling one character at a time. An empty chunk signals the end of the input.
+// A chunk stays valid until the next call to nextChunk().
+class SourceBuffer {
+public:
+    SourceBuffer() = default;
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    SourceBuffer(SourceBuffer &&) = delete;
+    SourceBuffer &operator=(SourceBuffer &&) = delete;
+    virtual ~SourceBuffer() = default;
+
+    virtual std::string_view nextChunk() = 0;
+
+    // The rest of the input in one piece, for the parts of the compiler that need all of it at once
+    std::string readAll();
+};
+
+// In-memory source, the whole input is handed out as a single chunk. The caller keeps the data alive.
+class StringSource : public SourceBuffer {
+public:
+    explicit StringSource(std::string_view data)
+        : m_data(data) {
+    }
+
+    std::string_view nextChunk() override {
+        return std::exchange(m_data, std::string_view{});
+    }
+
+private:
+    std::string_view m_data;
+};
+
+// Read-only memory mapping of a whole file, handed out as a single chunk.
+class MappedFileSource : public SourceBuffer {
+    MappedFileSource(const char *data, std::size_t size)
+        : m_data(data)
+        , m_size(size)
+        , m_consumed(false) {
+    }
+
+public:
+    // Returns nullptr(and reports the reason) if the file cannot be opened or mapped
+    static std::unique_ptr<MappedFileSource> open(const char *path);
+
+    ~MappedFileSource() override;
+
+    std::string_view nextChunk() override {
+        if (std::exchange(m_consumed, true)) {
+            return {};
+        }
+        return {m_data, m_size};
+    }
+
+private:
+    const char *m_data;
+    std::size_t m_size;
+    bool m_consumed;
+};
+
+// Reads a file descriptor(stdin by default) in large blocks. A single read() returns whatever is available, so
+// interactive input is still handed to the lexer line by line.
+class StreamSource : public SourceBuffer {
+public:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+
+    explicit StreamSource(int fd = STDIN_FILENO)
+        : m_fd(fd)
+        , m_buffer(std::make_unique<char[]>(kBlockSize)) {
+    }
+
+    std::string_view nextChunk() override;
+
+private:
+    int m_fd;
+    std::unique_ptr<char[]> m_buffer;
+};
+
+#endif  // !_SOURCE_BUFFER_HPP_
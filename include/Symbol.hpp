@@ -0,0 +1,56 @@
+#ifndef _SYMBOL_HPP_
+#define _SYMBOL_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Interned identifier. Every distinct name is stored once in a process-wide table and a Symbol is a handle to that
+// entry, so two symbols are equal iff they name the same string and comparing or hashing them is a pointer operation.
+// Interning a name that is already known does not allocate.
+class Symbol {
+public:
+    // The null symbol, it names nothing
+    constexpr Symbol() = default;
+
+    // Thread-safe
+    static Symbol intern(std::string_view name);
+
+    std::string_view str() const {
+        return m_name ? std::string_view{*m_name} : std::string_view{};
+    }
+
+    const char *c_str() const {
+        return m_name ? m_name->c_str() : "";
+    }
+
+    explicit operator bool() const {
+        return m_name != nullptr;
+    }
+
+    bool operator==(const Symbol &other) const {
+        return m_name == other.m_name;
+    }
+
+    std::size_t hash() const {
+        return std::hash<const void *>{}(m_name);
+    }
+
+private:
+    explicit constexpr Symbol(const std::string *name)
+        : m_name(name) {
+    }
+
+    // Entry in the symbol table, never moved or freed
+    const std::string *m_name = nullptr;
+};
+
+template <>
+struct std::hash<Symbol> {
+    std::size_t operator()(const Symbol &symbol) const noexcept {
+        return symbol.hash();
+    }
+};
+
+#endif  // !_SYMBOL_HPP_
@@ -0,0 +1,108 @@
+#ifndef _TIERED_COMPILER_HPP_
+#define _TIERED_COMPILER_HPP_
+
+#include "KaleidoscopeJIT.h"
+#include "PassProfiler.hpp"
+#include "Symbol.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Two-tier compilation on top of the JIT.
+//
+// Tier 0: every function of a module handed over through addModule() is compiled right away without any optimization,
+// behind an indirect stub that carries its name, so that every call(even from the function itself) goes through the
+// stub. The tier-0 body counts its calls and the call that reaches the threshold asks for tier 1.
+//
+// Tier 1: a background thread recompiles the function from the copy of its IR saved before instrumentation, with the
+// O3 pipeline(inlining, loop and SLP vectorization). The bodies of the functions it calls are linked in for inlining.
+// The stub is then pointed at the new body, so all callers switch over on their next call.
+class TieredCompiler {
+    // Name of the hook tier-0 code calls when a function gets hot
+    static constexpr const char *kTierUpHook = "__kaleidoscope_tier_up";
+
+    static constexpr const char *kTier0Suffix = ".tier0";
+    static constexpr const char *kTier1Suffix = ".tier1";
+
+public:
+    // `profiler`, if any, profiles the tier-1 pipeline
+    TieredCompiler(llvm::orc::KaleidoscopeJIT &jit, std::uint64_t threshold, PassProfiler *profiler = nullptr);
+    TieredCompiler(const TieredCompiler &) = delete;
+    TieredCompiler &operator=(const TieredCompiler &) = delete;
+    TieredCompiler(TieredCompiler &&) = delete;
+    TieredCompiler &operator=(TieredCompiler &&) = delete;
+
+    // Stops the background thread, pending recompilations are dropped
+    ~TieredCompiler();
+
+    // Compiles the functions defined in `threadSafeModule` at tier 0 and makes them callable under their names
+    llvm::Error addModule(llvm::orc::ThreadSafeModule threadSafeModule);
+
+    // Number of functions running at tier 1
+    std::size_t promotedFunctions() const {
+        return m_promoted.load(std::memory_order_acquire);
+    }
+
+private:
+    struct TieredFunction {
+        Symbol m_name;
+
+        // The function as generated, in a module of its own where everything else is declared
+        llvm::SmallVector<char, 0> m_bitcode;
+    };
+
+    // Called by tier-0 code, on the thread that runs it
+    static void tierUpHook(TieredCompiler *self, std::uint64_t id);
+
+    // Saves the IR of `func` for tier 1 and returns its id
+    std::uint64_t saveFunction(const llvm::Function &func);
+
+    // Turns `func` into its tier-0 body: renamed, called through its stub, counting its calls
+    void instrumentFunction(llvm::Function &func, std::uint64_t id);
+
+    // Compiles `threadSafeModule` at tier 0 and points the stubs of `names` at `tier0Names`, its instrumented functions
+    llvm::Error addTier0(llvm::orc::ThreadSafeModule threadSafeModule, const std::vector<std::string> &names,
+                         const std::vector<std::string> &tier0Names);
+
+    void backgroundLoop();
+
+    // Compiles function `id` at tier 1 and points its stub at the result
+    llvm::Error promote(std::uint64_t id);
+
+    llvm::orc::KaleidoscopeJIT &m_jit;
+    const std::uint64_t m_threshold;
+
+    // Guards m_functions and m_ids, which the background thread reads
+    std::mutex m_functionsMutex;
+    std::deque<TieredFunction> m_functions;
+    std::unordered_map<Symbol, std::uint64_t> m_ids;
+
+    // Owned by the background thread
+    std::unique_ptr<llvm::TargetMachine> m_targetMachine;
+
+    PassProfiler *const m_profiler;
+
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueChanged;
+    std::deque<std::uint64_t> m_queue;
+    bool m_stopping = false;
+
+    std::atomic<std::size_t> m_promoted{0};
+
+    std::thread m_background;
+};
+
+#endif  // !_TIERED_COMPILER_HPP_
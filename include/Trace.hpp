@@ -0,0 +1,98 @@
+#ifndef _TRACE_HPP_
+#define _TRACE_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Timers and counters of the compiler phases(--trace, --trace-summary). Nothing is recorded before enable(): a span or
+// a counter is then a relaxed load of a flag and a branch.
+namespace trace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Counter : std::uint8_t {
+    TokensLexed,
+    AstNodes,
+    IrInstructionsBefore,  // of the code going into the optimizer
+    IrInstructionsAfter,   // of the same code coming out of it
+    MachineCodeBytes,      // of the text sections of the compiled objects
+    JitLookups,
+    Count
+};
+
+namespace detail {
+inline std::atomic<bool> s_enabled = false;
+inline std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(Counter::Count)> s_counters{};
+
+void record(const char *name, std::string_view detail, Clock::time_point begin, Clock::time_point end);
+}  // namespace detail
+
+// Starts recording, before any thread that may record anything is started
+void enable();
+
+inline bool enabled() {
+    return detail::s_enabled.load(std::memory_order_relaxed);
+}
+
+inline void count(Counter counter, std::uint64_t amount = 1) {
+    if (enabled()) {
+        detail::s_counters[static_cast<std::size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+// A span of the phase `name` from construction to finish() or destruction, on the constructing thread. `name` must
+// outlive the trace(a literal), `detail`(the function or module it is about) only the span.
+class Scope {
+public:
+    explicit Scope(const char *name, std::string_view detail = {})
+        : m_name(enabled() ? name : nullptr)
+        , m_detail(m_name ? detail : std::string_view{})
+        , m_begin(m_name ? Clock::now() : Clock::time_point{}) {
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    Scope(Scope &&) = delete;
+    Scope &operator=(Scope &&) = delete;
+
+    ~Scope() {
+        finish();
+    }
+
+    // Ends the span early, for phases followed by another one in the same block
+    void finish() {
+        if (m_name) {
+            detail::record(m_name, m_detail, m_begin, Clock::now());
+            m_name = nullptr;
+        }
+    }
+
+private:
+    const char *m_name;
+    std::string_view m_detail;
+    Clock::time_point m_begin;
+};
+
+// Records from construction to destruction if any output is asked for, then writes the spans and counters as
+// trace-event JSON to `traceFile`(for chrome://tracing and Perfetto) and/or prints their summary to std::cout
+class Session {
+public:
+    Session(std::string traceFile, bool summary);
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+    Session(Session &&) = delete;
+    Session &operator=(Session &&) = delete;
+    ~Session();
+
+private:
+    const std::string m_traceFile;
+    const bool m_summary;
+};
+
+}  // namespace trace
+
+#endif  // !_TRACE_HPP_
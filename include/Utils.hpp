@@ -1,13 +1,51 @@
 #ifndef _UTILS_HPP_
 #define _UTILS_HPP_
 
-class ExprAST;
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
 class PrototypeAST;
 
 namespace utils {
-inline std::unique_ptr<ExprAST> logError(const char *str) {
-    std::cout << "Error: " << str << '\n';
-    return nullptr;
+// Collects the errors logged on the constructing thread while it is alive, instead of printing them(see
+// kaleidoscope::Engine, which returns them)
+class ScopedErrorCapture {
+public:
+    explicit ScopedErrorCapture(std::vector<std::string> &messages)
+        : m_previous(std::exchange(s_messages, &messages)) {
+    }
+    ScopedErrorCapture(const ScopedErrorCapture &) = delete;
+    ScopedErrorCapture &operator=(const ScopedErrorCapture &) = delete;
+    ScopedErrorCapture(ScopedErrorCapture &&) = delete;
+    ScopedErrorCapture &operator=(ScopedErrorCapture &&) = delete;
+
+    ~ScopedErrorCapture() {
+        s_messages = m_previous;
+    }
+
+    // Where the errors of this thread go, nullptr for std::cout
+    static std::vector<std::string> *messages() {
+        return s_messages;
+    }
+
+private:
+    static inline thread_local std::vector<std::string> *s_messages = nullptr;
+
+    std::vector<std::string> *const m_previous;
+};
+
+// Converts to an empty std::optional<ExprId> for the parser's expression productions
+inline std::nullopt_t logError(const char *str) {
+    if (std::vector<std::string> *const messages = ScopedErrorCapture::messages(); messages) {
+        messages->emplace_back(str);
+    } else {
+        std::cout << "Error: " << str << '\n';
+    }
+    return std::nullopt;
 }
 
 inline std::unique_ptr<PrototypeAST> logErrorProto(const char *str) {
@@ -0,0 +1,269 @@
+#include "AotCompiler.hpp"
+
+#include "BatchEntryPoints.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+AotCompiler::AotCompiler(Lexer &lexer, const Options &options)
+    : m_parser(lexer)
+    , m_options(options)
+    , m_ctxData() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+}
+
+int AotCompiler::run() {
+    auto targetMachine = createTargetMachine();
+    if (!targetMachine) {
+        std::cout << "Error: " << llvm::toString(targetMachine.takeError()) << '\n';
+        return 1;
+    }
+
+    const llvm::DataLayout dataLayout = (*targetMachine)->createDataLayout();
+    const std::string triple = (*targetMachine)->getTargetTriple().str();
+
+    if (m_options.m_passProfile) {
+        m_passProfiler = std::make_unique<PassProfiler>();
+    }
+
+    m_ctxData = std::make_unique<LLVMContextData>(std::make_shared<ExportedFunctions>(), m_options.m_optLevel,
+                                                  std::move(*targetMachine),
+                                                  PassInstrumentation{m_options.m_debugPasses, m_passProfiler.get()});
+    m_ctxData->startModule(kModuleName, dataLayout);
+    m_ctxData->m_llvmModule->setTargetTriple(triple);
+
+    int errors = 0;
+    m_parser.start();
+
+    for (auto item = m_parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = m_parser.peekTopLevel()) {
+        switch (item) {
+            case Parser::TopLevel::Definition:
+                if (const auto func = m_parser.parseDefinition(); func) {
+                    errors += !func->codegen(*m_ctxData);
+                    m_parser.recycle(*func);
+                } else {
+                    ++errors;
+                }
+                break;
+            case Parser::TopLevel::Extern: {
+                const auto externProto = m_parser.parseExtern();
+                errors += !(externProto && externProto->codegen(*m_ctxData));
+                break;
+            }
+            case Parser::TopLevel::Separator:
+                m_parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression:
+                // Parsed for the errors only, a library has nothing to run them
+                if (const auto anonFunc = m_parser.parseTopLevelExpr(Symbol::intern("__anon_expr")); anonFunc) {
+                    m_parser.recycle(*anonFunc);
+                } else {
+                    ++errors;
+                }
+                break;
+            case Parser::TopLevel::EndOfInput:
+                break;
+        }
+    }
+
+    llvm::Module &module = *m_ctxData->m_llvmModule;
+    if (m_options.m_batchEntries) {
+        // Vectorized for the same target, which was created successfully above
+        BatchEntryPoints batchEntries{llvm::cantFail(createTargetMachine())};
+        batchEntries.generate(module, *m_ctxData->m_exportedFunctions);
+    }
+
+    if (isModuleLevel(m_options.m_optLevel)) {
+        m_ctxData->m_llvmOpt.optimize(module);
+    }
+
+    if (m_options.m_emitIR) {
+        module.print(llvm::outs(), nullptr);
+    }
+
+    auto object = emitObject();
+    if (!object) {
+        std::cout << "Error: " << llvm::toString(object.takeError()) << '\n';
+        return errors + 1;
+    }
+
+    const auto report = [&errors](llvm::Error error) {
+        if (error) {
+            std::cout << "Error: " << llvm::toString(std::move(error)) << '\n';
+            ++errors;
+        }
+    };
+
+    if (!m_options.m_emitObj.empty()) {
+        report(writeFile(m_options.m_emitObj, (*object)->getBuffer()));
+    }
+    if (!m_options.m_emitLib.empty()) {
+        report(writeLibrary(m_options.m_emitLib, (*object)->getMemBufferRef()));
+    }
+
+    const std::string header = headerPath(m_options.m_emitObj.empty() ? m_options.m_emitLib : m_options.m_emitObj);
+    report(writeFile(header, generateHeader(std::filesystem::path(header).filename().string())));
+
+    if (m_passProfiler) {
+        m_passProfiler->printReport();
+    }
+
+    return errors;
+}
+
+llvm::Expected<std::unique_ptr<llvm::TargetMachine>> AotCompiler::createTargetMachine() const {
+    std::string triple = m_options.m_targetTriple;
+    std::string cpu = m_options.m_targetCPU;
+    std::string features;
+
+    // The host CPU and all of its features, unless the target or the CPU is given
+    if (triple.empty()) {
+        auto host = llvm::orc::JITTargetMachineBuilder::detectHost();
+        if (!host) {
+            return host.takeError();
+        }
+
+        triple = host->getTargetTriple().str();
+        if (cpu.empty()) {
+            cpu = host->getCPU();
+            features = host->getFeatures().getString();
+        }
+    }
+
+    std::string error;
+    const llvm::Target *const target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "cannot compile for '" + triple + "': " + error);
+    }
+
+    llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default;
+    if (m_options.m_optLevel == OptLevel::O0) {
+        level = llvm::CodeGenOpt::None;
+    } else if (m_options.m_optLevel == OptLevel::O3) {
+        level = llvm::CodeGenOpt::Aggressive;
+    }
+
+    // Position independent, the object may end up in an executable or a shared library
+    std::unique_ptr<llvm::TargetMachine> targetMachine{target->createTargetMachine(
+        triple, cpu, features, llvm::TargetOptions{}, llvm::Reloc::PIC_, {}, level)};
+    if (!targetMachine) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "cannot compile for '" + triple + "'");
+    }
+    return targetMachine;
+}
+
+llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> AotCompiler::emitObject() {
+    llvm::SmallVector<char, 0> object;
+    llvm::raw_svector_ostream stream{object};
+
+    llvm::legacy::PassManager passManager;
+    if (m_ctxData->m_targetMachine->addPassesToEmitFile(passManager, stream, nullptr, llvm::CGFT_ObjectFile)) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "the target cannot emit object files");
+    }
+    passManager.run(*m_ctxData->m_llvmModule);
+
+    const std::string name =
+        std::filesystem::path(m_options.m_emitObj.empty() ? m_options.m_emitLib : m_options.m_emitObj)
+            .replace_extension(".o")
+            .filename()
+            .string();
+    return llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef{object.data(), object.size()}, name);
+}
+
+llvm::Error AotCompiler::writeFile(const std::string &path, llvm::StringRef contents) const {
+    std::error_code error;
+    llvm::raw_fd_ostream file{path, error};
+    if (error) {
+        return llvm::createStringError(error, "cannot write '" + path + "': " + error.message());
+    }
+
+    file << contents;
+    file.close();
+    if (file.has_error()) {
+        const std::error_code writeError = file.error();
+        file.clear_error();
+        return llvm::createStringError(writeError, "cannot write '" + path + "': " + writeError.message());
+    }
+    return llvm::Error::success();
+}
+
+llvm::Error AotCompiler::writeLibrary(const std::string &path, llvm::MemoryBufferRef object) const {
+    const llvm::object::Archive::Kind kind = m_ctxData->m_targetMachine->getTargetTriple().isOSDarwin()
+                                                 ? llvm::object::Archive::K_DARWIN
+                                                 : llvm::object::Archive::K_GNU;
+
+    std::vector<llvm::NewArchiveMember> members;
+    members.emplace_back(object);
+
+    // Deterministic: no timestamps, the same input gives the same archive
+    return llvm::writeArchive(path, members, /*WriteSymtab=*/true, kind, /*Deterministic=*/true, /*Thin=*/false);
+}
+
+std::string AotCompiler::generateHeader(const std::string &fileName) const {
+    std::string guard;
+    for (const char c : fileName) {
+        guard += std::isalnum(static_cast<unsigned char>(c)) ? std::toupper(static_cast<unsigned char>(c)) : '_';
+    }
+    guard += '_';
+
+    std::string header = "// Generated by kaleidoscope";
+    if (!m_options.m_inputFile.empty()) {
+        header += " from " + m_options.m_inputFile;
+    }
+    header += ", do not edit.\n\n";
+    header += "#ifndef " + guard + "\n#define " + guard + "\n\n";
+    if (m_options.m_batchEntries) {
+        header += "#include <stddef.h>\n\n";
+    }
+    header += "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n";
+
+    for (const llvm::Function &func : *m_ctxData->m_llvmModule) {
+        if (func.isDeclaration()) {
+            continue;
+        }
+
+        // The arrays, `out` and `n` of a batch entry point
+        const auto it = m_ctxData->m_exportedFunctions->find(Symbol::intern(std::string_view{func.getName()}));
+        if (it != m_ctxData->m_exportedFunctions->end() && it->second.m_batchEntry) {
+            header += "void " + func.getName().str() + '(';
+            for (const llvm::Argument &arg : func.args()) {
+                header += arg.getArgNo() == 0 ? "" : ", ";
+                if (arg.getArgNo() + 2 < func.arg_size()) {
+                    header += "const double *" + arg.getName().str();
+                } else {
+                    header += arg.getArgNo() + 1 < func.arg_size() ? "double *out" : "size_t n";
+                }
+            }
+            header += ");\n";
+            continue;
+        }
+
+        header += "double " + func.getName().str() + '(';
+        for (const llvm::Argument &arg : func.args()) {
+            header += (arg.getArgNo() == 0 ? "double " : ", double ") + arg.getName().str();
+        }
+        header += func.arg_empty() ? "void);\n" : ");\n";
+    }
+
+    header += "\n#ifdef __cplusplus\n}\n#endif\n\n#endif  // " + guard + '\n';
+    return header;
+}
+
+std::string AotCompiler::headerPath(const std::string &output) const {
+    if (!m_options.m_emitHeader.empty()) {
+        return m_options.m_emitHeader;
+    }
+    return std::filesystem::path(output).replace_extension(".h").string();
+}
@@ -0,0 +1,148 @@
+#include "BatchEntryPoints.hpp"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Vectorize/LoopVectorize.h"
+
+#include <vector>
+
+BatchEntryPoints::BatchEntryPoints(std::unique_ptr<llvm::TargetMachine> targetMachine)
+    : m_targetMachine(targetMachine ? std::move(targetMachine) : createHostTargetMachine(OptLevel::O2)) {
+    // The target analyses tell the vectorizer the SIMD width and the costs
+    llvm::PassBuilder passBuilder{m_targetMachine.get()};
+    passBuilder.registerModuleAnalyses(m_MAM);
+    passBuilder.registerCGSCCAnalyses(m_CGAM);
+    passBuilder.registerFunctionAnalyses(m_FAM);
+    passBuilder.registerLoopAnalyses(m_LAM);
+    passBuilder.crossRegisterProxies(m_LAM, m_FAM, m_CGAM, m_MAM);
+
+    // Clean up the inlined bodies, vectorize the loop(it puts the loop into the form it needs itself), clean up the
+    // vector code
+    m_FPM.addPass(llvm::SimplifyCFGPass());
+    m_FPM.addPass(llvm::InstCombinePass());
+    m_FPM.addPass(llvm::LoopVectorizePass());
+    m_FPM.addPass(llvm::InstCombinePass());
+    m_FPM.addPass(llvm::SimplifyCFGPass());
+}
+
+std::string BatchEntryPoints::nameOf(std::string_view name) {
+    return std::string{name} + kSuffix;
+}
+
+void BatchEntryPoints::generate(llvm::Module &module, ExportedFunctions &exportedFunctions) {
+    // Not while iterating, every batch entry point adds a function to the module
+    std::vector<llvm::Function *> functions;
+    for (llvm::Function &func : module) {
+        if (!func.isDeclaration() && !func.arg_empty() && func.hasExternalLinkage() &&
+            func.getReturnType()->isDoubleTy()) {
+            functions.push_back(&func);
+        }
+    }
+
+    for (llvm::Function *const func : functions) {
+        llvm::Function *const batchFunc = generateLoop(*func, exportedFunctions);
+        if (!batchFunc) {
+            continue;
+        }
+
+        inlineCalls(*batchFunc);
+        m_FPM.run(*batchFunc, m_FAM);
+        m_FAM.clear();
+
+        auto &exported = exportedFunctions[Symbol::intern(std::string_view{batchFunc->getName()})];
+        exported.m_arity = batchFunc->arg_size();
+        exported.m_defined = true;
+        exported.m_batchEntry = true;
+    }
+}
+
+llvm::Function *BatchEntryPoints::generateLoop(llvm::Function &func, const ExportedFunctions &exportedFunctions) {
+    llvm::Module &module = *func.getParent();
+    const std::string name = nameOf(func.getName().str());
+    if (module.getFunction(name) || exportedFunctions.contains(Symbol::intern(name))) {
+        return nullptr;
+    }
+
+    llvm::LLVMContext &llvmContext = module.getContext();
+    llvm::Type *const doubleType = llvm::Type::getDoubleTy(llvmContext);
+    llvm::Type *const doublePointerType = llvm::PointerType::getUnqual(doubleType);
+    llvm::IntegerType *const sizeType = module.getDataLayout().getIntPtrType(llvmContext);
+
+    // One array per argument, then `out` and `n`
+    std::vector<llvm::Type *> argTypes(func.arg_size() + 1, doublePointerType);
+    argTypes.push_back(sizeType);
+
+    llvm::Function *const batchFunc =
+        llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), argTypes, false),
+                               llvm::Function::ExternalLinkage, name, module);
+    batchFunc->addFnAttr(llvm::Attribute::NoUnwind);
+
+    // No array overlaps another one, without that the vectorizer would check at run time
+    for (llvm::Argument &arg : batchFunc->args()) {
+        if (arg.getType() == doublePointerType) {
+            arg.addAttr(llvm::Attribute::NoAlias);
+            arg.addAttr(llvm::Attribute::NoCapture);
+            arg.addAttr(arg.getArgNo() < func.arg_size() ? llvm::Attribute::ReadOnly : llvm::Attribute::WriteOnly);
+        }
+        arg.setName(arg.getArgNo() < func.arg_size() ? func.getArg(arg.getArgNo())->getName()
+                    : arg.getArgNo() == func.arg_size() ? llvm::StringRef{"out"}
+                                                        : llvm::StringRef{"n"});
+    }
+
+    llvm::Argument *const out = batchFunc->getArg(func.arg_size());
+    llvm::Argument *const count = batchFunc->getArg(func.arg_size() + 1);
+
+    llvm::BasicBlock *const entry = llvm::BasicBlock::Create(llvmContext, "entry", batchFunc);
+    llvm::BasicBlock *const loop = llvm::BasicBlock::Create(llvmContext, "loop", batchFunc);
+    llvm::BasicBlock *const exit = llvm::BasicBlock::Create(llvmContext, "exit", batchFunc);
+
+    // entry: nothing to do for n == 0, the loop below runs at least once
+    llvm::IRBuilder<> builder{entry};
+    builder.CreateCondBr(builder.CreateICmpEQ(count, llvm::ConstantInt::get(sizeType, 0)), exit, loop);
+
+    // loop: out[i] = func(args[i]...)
+    builder.SetInsertPoint(loop);
+    llvm::PHINode *const index = builder.CreatePHI(sizeType, 2, "i");
+    index->addIncoming(llvm::ConstantInt::get(sizeType, 0), entry);
+
+    std::vector<llvm::Value *> argValues;
+    for (std::size_t i = 0; i < func.arg_size(); ++i) {
+        llvm::Value *const element = builder.CreateInBoundsGEP(doubleType, batchFunc->getArg(i), index);
+        argValues.push_back(builder.CreateLoad(doubleType, element, func.getArg(i)->getName()));
+    }
+
+    llvm::Value *const result = builder.CreateCall(&func, argValues, "calltmp");
+    builder.CreateStore(result, builder.CreateInBoundsGEP(doubleType, out, index));
+
+    llvm::Value *const next = builder.CreateAdd(index, llvm::ConstantInt::get(sizeType, 1), "next", true, true);
+    index->addIncoming(next, loop);
+    builder.CreateCondBr(builder.CreateICmpULT(next, count), loop, exit);
+
+    // exit:
+    builder.SetInsertPoint(exit);
+    builder.CreateRetVoid();
+
+    return batchFunc;
+}
+
+void BatchEntryPoints::inlineCalls(llvm::Function &batchFunc) {
+    // Breadth first: the function itself, then what it calls, and so on until nothing is left or the body is too big
+    for (bool inlined = true; inlined && batchFunc.getInstructionCount() < kMaxInlinedInstructions;) {
+        std::vector<llvm::CallInst *> calls;
+        for (llvm::BasicBlock &block : batchFunc) {
+            for (llvm::Instruction &instruction : block) {
+                auto *const call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+                if (call && call->getCalledFunction() && !call->getCalledFunction()->isDeclaration()) {
+                    calls.push_back(call);
+                }
+            }
+        }
+
+        inlined = false;
+        for (llvm::CallInst *const call : calls) {
+            llvm::InlineFunctionInfo info;
+            inlined = llvm::InlineFunction(*call, info).isSuccess() || inlined;
+        }
+    }
+}
@@ -0,0 +1,174 @@
+#include "Bytecode.hpp"
+
+#include "Utils.hpp"
+
+#include <algorithm>
+
+#include <dlfcn.h>
+
+bool BytecodeProgram::declare(const PrototypeAST &proto) {
+    const Symbol name = proto.getName();
+    const auto arity = static_cast<std::uint32_t>(proto.getArgs().size());
+
+    if (const auto it = m_indices.find(name); it != m_indices.end()) {
+        if (m_functions[it->second].m_arity != arity) {
+            utils::logError("extern does not match the # arguments of an earlier declaration");
+            return false;
+        }
+        return true;
+    }
+
+    BytecodeFunction func{name, arity, arity};
+    func.m_hostAddress = ::dlsym(RTLD_DEFAULT, name.c_str());
+
+    m_indices.emplace(name, static_cast<std::uint32_t>(m_functions.size()));
+    m_functions.push_back(std::move(func));
+    return true;
+}
+
+bool BytecodeProgram::define(const FunctionAST &func) {
+    const Symbol name = func.m_prototype.getName();
+    const std::vector<Symbol> &params = func.m_prototype.getArgs();
+
+    auto it = m_indices.find(name);
+    const bool known = it != m_indices.end();
+    if (known) {
+        const BytecodeFunction &existing = m_functions[it->second];
+        if (existing.isDefined()) {
+            utils::logError("codegen() function cannot be redefined");
+            return false;
+        }
+        if (existing.m_arity != params.size()) {
+            utils::logError("codegen() function does not match the # arguments of its declaration");
+            return false;
+        }
+    } else {
+        // Known before its body is compiled, it may call itself
+        it = m_indices.emplace(name, static_cast<std::uint32_t>(m_functions.size())).first;
+        m_functions.push_back({name, static_cast<std::uint32_t>(params.size())});
+    }
+
+    BytecodeFunction compiled{name, static_cast<std::uint32_t>(params.size())};
+    if (!compile(func.m_body, params, compiled)) {
+        utils::logError("codegen() of function body failed");
+
+        // Gone again, like the function codegen erases
+        if (!known) {
+            m_indices.erase(it);
+            m_functions.pop_back();
+        }
+        return false;
+    }
+
+    m_functions[it->second] = std::move(compiled);
+    return true;
+}
+
+std::optional<BytecodeFunction> BytecodeProgram::compileExpression(const FunctionAST &func) const {
+    BytecodeFunction compiled{func.m_prototype.getName()};
+    if (!compile(func.m_body, func.m_prototype.getArgs(), compiled)) {
+        utils::logError("codegen() of function body failed");
+        return std::nullopt;
+    }
+    return compiled;
+}
+
+const BytecodeFunction *BytecodeProgram::find(Symbol name) const {
+    const auto it = m_indices.find(name);
+    return it != m_indices.end() ? &m_functions[it->second] : nullptr;
+}
+
+bool BytecodeProgram::compile(const ExprPool &body, const std::vector<Symbol> &params, BytecodeFunction &func) const {
+    const auto arity = static_cast<std::uint32_t>(params.size());
+
+    // Register of every node. A node only consumes the values of the subtrees right before it in post-order, so the
+    // temporaries are allocated and freed like a stack and the frame stays as small as the deepest expression.
+    std::vector<std::uint32_t> registers(body.size());
+    std::uint32_t temporaries = 0;
+    std::uint32_t maxTemporaries = 0;
+
+    const auto isTemporary = [arity](std::uint32_t reg) { return reg >= arity; };
+    const auto allocate = [&] {
+        maxTemporaries = std::max(maxTemporaries, temporaries + 1);
+        return arity + temporaries++;
+    };
+
+    for (ExprId id = 0; id < body.size(); ++id) {
+        switch (body.kind(id)) {
+            case ExprKind::Number:
+                registers[id] = allocate();
+                func.m_code.push_back(
+                    {Opcode::LoadConst, registers[id], static_cast<std::uint32_t>(func.m_constants.size()), 0});
+                func.m_constants.push_back(body.number(id));
+                break;
+
+            case ExprKind::Variable: {
+                // The last argument of that name, like codegen
+                const auto it = std::find(params.rbegin(), params.rend(), body.symbol(id));
+                if (it == params.rend()) {
+                    utils::logError("Unknown variable name");
+                    return false;
+                }
+                registers[id] = static_cast<std::uint32_t>(params.rend() - it - 1);
+                break;
+            }
+
+            case ExprKind::Binary: {
+                Opcode op;
+                switch (body.op(id)) {
+                    case '+':
+                        op = Opcode::Add;
+                        break;
+                    case '-':
+                        op = Opcode::Sub;
+                        break;
+                    case '*':
+                        op = Opcode::Mul;
+                        break;
+                    case '<':
+                        op = Opcode::Less;
+                        break;
+                    default:
+                        utils::logError("Invalid binary operator");
+                        return false;
+                }
+
+                const std::uint32_t lhs = registers[body.lhs(id)];
+                const std::uint32_t rhs = registers[body.rhs(id)];
+                temporaries -= isTemporary(lhs) + isTemporary(rhs);
+
+                registers[id] = allocate();
+                func.m_code.push_back({op, registers[id], lhs, rhs});
+                break;
+            }
+
+            case ExprKind::Call: {
+                const auto callee = m_indices.find(body.symbol(id));
+                if (callee == m_indices.end()) {
+                    utils::logError("Unknown function referenced");
+                    return false;
+                }
+
+                const std::span<const ExprId> argIds = body.args(id);
+                if (m_functions[callee->second].m_arity != argIds.size()) {
+                    utils::logError("Incorrect # arguments passed");
+                    return false;
+                }
+
+                const auto operands = static_cast<std::uint32_t>(func.m_operands.size());
+                for (const ExprId argId : argIds) {
+                    func.m_operands.push_back(registers[argId]);
+                    temporaries -= isTemporary(registers[argId]);
+                }
+
+                registers[id] = allocate();
+                func.m_code.push_back({Opcode::Call, registers[id], callee->second, operands});
+                break;
+            }
+        }
+    }
+
+    func.m_code.push_back({Opcode::Return, 0, registers[body.root()], 0});
+    func.m_registers = arity + maxTemporaries;
+    return true;
+}
@@ -0,0 +1,173 @@
+#include "BytecodeVM.hpp"
+
+#include "Utils.hpp"
+
+#include <array>
+#include <string>
+#include <utility>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KALEIDOSCOPE_COMPUTED_GOTO 1
+#else
+#define KALEIDOSCOPE_COMPUTED_GOTO 0
+#endif
+
+namespace {
+
+using HostCaller = double (*)(void *address, const double *args);
+
+template <std::size_t... I>
+double callHost(void *address, const double *args, std::index_sequence<I...>) {
+    using HostFunction = double (*)(decltype(static_cast<void>(I), 0.0)...);
+    return reinterpret_cast<HostFunction>(address)(args[I]...);
+}
+
+// Callers of host functions `double(double, ...)` by number of arguments
+template <std::size_t... N>
+constexpr std::array<HostCaller, sizeof...(N)> makeHostCallers(std::index_sequence<N...>) {
+    return {[](void *address, const double *args) { return callHost(address, args, std::make_index_sequence<N>{}); }...};
+}
+
+constexpr auto kHostCallers = makeHostCallers(std::make_index_sequence<BytecodeVM::kMaxHostArguments + 1>{});
+
+}  // namespace
+
+BytecodeVM::BytecodeVM()
+    : m_stack(new double[kStackRegisters])
+    , m_frames() {
+    m_frames.reserve(64);
+}
+
+std::optional<double> BytecodeVM::run(const BytecodeProgram &program, const BytecodeFunction &entry) {
+    const BytecodeFunction *const functions = program.functions().data();
+    double *const stackEnd = m_stack.get() + kStackRegisters;
+
+    const BytecodeFunction *func = &entry;
+    const Instruction *pc = entry.m_code.data();
+    const double *constants = entry.m_constants.data();
+    const std::uint32_t *operands = entry.m_operands.data();
+    double *regs = m_stack.get();
+
+    m_frames.clear();
+    if (entry.m_registers > kStackRegisters) {
+        utils::logError("stack overflow");
+        return std::nullopt;
+    }
+
+#if KALEIDOSCOPE_COMPUTED_GOTO
+    // In the order of Opcode
+    static const void *const kDispatch[] = {&&opLoadConst, &&opAdd, &&opSub, &&opMul, &&opLess, &&opCall, &&opReturn};
+
+#define VM_CASE(name) op##name:
+#define VM_DISPATCH() goto *kDispatch[static_cast<std::size_t>(pc->m_op)]
+#define VM_NEXT() goto *kDispatch[static_cast<std::size_t>((++pc)->m_op)]
+
+    VM_DISPATCH();
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_DISPATCH() continue
+#define VM_NEXT() \
+    ++pc;         \
+    continue
+
+    for (;;) {
+        switch (pc->m_op) {
+#endif
+
+    VM_CASE(LoadConst) {
+        regs[pc->m_dst] = constants[pc->m_a];
+        VM_NEXT();
+    }
+
+    VM_CASE(Add) {
+        regs[pc->m_dst] = regs[pc->m_a] + regs[pc->m_b];
+        VM_NEXT();
+    }
+
+    VM_CASE(Sub) {
+        regs[pc->m_dst] = regs[pc->m_a] - regs[pc->m_b];
+        VM_NEXT();
+    }
+
+    VM_CASE(Mul) {
+        regs[pc->m_dst] = regs[pc->m_a] * regs[pc->m_b];
+        VM_NEXT();
+    }
+
+    VM_CASE(Less) {
+        // fcmp ult: less than, or unordered
+        regs[pc->m_dst] = !(regs[pc->m_a] >= regs[pc->m_b]) ? 1.0 : 0.0;
+        VM_NEXT();
+    }
+
+    VM_CASE(Call) {
+        const BytecodeFunction &callee = functions[pc->m_a];
+        const std::uint32_t *const args = operands + pc->m_b;
+
+        if (!callee.isDefined()) {
+            if (!callee.m_hostAddress) {
+                utils::logError(("unresolved external symbol '" + std::string{callee.m_name.str()} + "'").c_str());
+                return std::nullopt;
+            }
+            if (callee.m_arity > kMaxHostArguments) {
+                utils::logError(("cannot call '" + std::string{callee.m_name.str()} + "' with more than " +
+                                 std::to_string(kMaxHostArguments) + " arguments")
+                                    .c_str());
+                return std::nullopt;
+            }
+
+            std::array<double, kMaxHostArguments> argValues;
+            for (std::uint32_t i = 0; i < callee.m_arity; ++i) {
+                argValues[i] = regs[args[i]];
+            }
+            regs[pc->m_dst] = kHostCallers[callee.m_arity](callee.m_hostAddress, argValues.data());
+            VM_NEXT();
+        }
+
+        // The callee's frame starts right after the caller's
+        double *const calleeRegs = regs + func->m_registers;
+        if (callee.m_registers > static_cast<std::size_t>(stackEnd - calleeRegs) || m_frames.size() == kMaxCallDepth) {
+            utils::logError("stack overflow");
+            return std::nullopt;
+        }
+
+        for (std::uint32_t i = 0; i < callee.m_arity; ++i) {
+            calleeRegs[i] = regs[args[i]];
+        }
+
+        m_frames.push_back({func, pc, regs});
+        func = &callee;
+        pc = callee.m_code.data();
+        constants = callee.m_constants.data();
+        operands = callee.m_operands.data();
+        regs = calleeRegs;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(Return) {
+        const double result = regs[pc->m_a];
+        if (m_frames.empty()) {
+            return result;
+        }
+
+        const Frame &caller = m_frames.back();
+        func = caller.m_function;
+        pc = caller.m_pc;
+        regs = caller.m_registers;
+        constants = func->m_constants.data();
+        operands = func->m_operands.data();
+        m_frames.pop_back();
+
+        regs[pc->m_dst] = result;
+        VM_NEXT();
+    }
+
+#if !KALEIDOSCOPE_COMPUTED_GOTO
+        }
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+}
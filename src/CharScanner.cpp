@@ -0,0 +1,207 @@
+#include "CharScanner.hpp"
+
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KALEIDOSCOPE_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace scan {
+namespace {
+
+template <std::uint8_t Class, bool Negate = false>
+const char *skipScalar(const char *begin, const char *end) {
+    while (begin != end && is(*begin, Class) != Negate) {
+        ++begin;
+    }
+    return begin;
+}
+
+const Kernels kScalarKernels{
+    Isa::Scalar,
+    skipScalar<kSpace>,
+    skipScalar<kLineEnd, true>,
+    skipScalar<kIdentifierStart | kDigit>,
+    skipScalar<kDigit>,
+};
+
+#ifdef KALEIDOSCOPE_SCANNER_X86
+
+// The vector kernels build, for each lane, a mask of the bytes that belong to the run. The first clear bit of the
+// mask is where the run stops; a run that covers the whole vector moves on to the next one. The tail shorter than a
+// vector is finished by the scalar loop, so no load ever reads past `end`.
+
+// Unsigned lo <= x <= hi, via saturating subtraction: x - lo <= hi - lo
+inline __m128i inRange(__m128i x, char lo, char hi) {
+    const __m128i shifted = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_subs_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), _mm_setzero_si128());
+}
+
+inline __m128i spaceMask(__m128i v) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', '\r'));
+}
+
+inline __m128i notLineEndMask(__m128i v) {
+    const __m128i lineEnd = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    return _mm_xor_si128(lineEnd, _mm_set1_epi8(-1));
+}
+
+inline __m128i digitMask(__m128i v) {
+    return inRange(v, '0', '9');
+}
+
+inline __m128i identifierMask(__m128i v) {
+    // Folding to lower case maps no non-letter into 'a'..'z'
+    const __m128i letter = inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    return _mm_or_si128(_mm_or_si128(letter, digitMask(v)), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+template <__m128i (*Mask)(__m128i), std::uint8_t Class, bool Negate = false>
+const char *skipSSE2(const char *begin, const char *end) {
+    for (; end - begin >= 16; begin += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        const auto inRun = static_cast<unsigned>(_mm_movemask_epi8(Mask(v)));
+        if (inRun != 0xFFFF) {
+            return begin + std::countr_one(inRun);
+        }
+    }
+    return skipScalar<Class, Negate>(begin, end);
+}
+
+const Kernels kSSE2Kernels{
+    Isa::SSE2,
+    skipSSE2<spaceMask, kSpace>,
+    skipSSE2<notLineEndMask, kLineEnd, true>,
+    skipSSE2<identifierMask, kIdentifierStart | kDigit>,
+    skipSSE2<digitMask, kDigit>,
+};
+
+#define KALEIDOSCOPE_AVX2 __attribute__((target("avx2")))
+
+KALEIDOSCOPE_AVX2 inline __m256i inRange256(__m256i x, char lo, char hi) {
+    const __m256i shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_subs_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))),
+                             _mm256_setzero_si256());
+}
+
+KALEIDOSCOPE_AVX2 inline __m256i spaceMask256(__m256i v) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange256(v, '\t', '\r'));
+}
+
+KALEIDOSCOPE_AVX2 inline __m256i notLineEndMask256(__m256i v) {
+    const __m256i lineEnd =
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    return _mm256_xor_si256(lineEnd, _mm256_set1_epi8(-1));
+}
+
+KALEIDOSCOPE_AVX2 inline __m256i digitMask256(__m256i v) {
+    return inRange256(v, '0', '9');
+}
+
+KALEIDOSCOPE_AVX2 inline __m256i identifierMask256(__m256i v) {
+    const __m256i letter = inRange256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    return _mm256_or_si256(_mm256_or_si256(letter, digitMask256(v)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+template <__m256i (*Mask)(__m256i), __m128i (*Mask128)(__m128i), std::uint8_t Class, bool Negate = false>
+KALEIDOSCOPE_AVX2 const char *skipAVX2(const char *begin, const char *end) {
+    for (; end - begin >= 32; begin += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+        const auto inRun = static_cast<std::uint32_t>(_mm256_movemask_epi8(Mask(v)));
+        if (inRun != 0xFFFFFFFF) {
+            return begin + std::countr_one(inRun);
+        }
+    }
+    return skipSSE2<Mask128, Class, Negate>(begin, end);
+}
+
+const Kernels kAVX2Kernels{
+    Isa::AVX2,
+    skipAVX2<spaceMask256, spaceMask, kSpace>,
+    skipAVX2<notLineEndMask256, notLineEndMask, kLineEnd, true>,
+    skipAVX2<identifierMask256, identifierMask, kIdentifierStart | kDigit>,
+    skipAVX2<digitMask256, digitMask, kDigit>,
+};
+
+#endif  // KALEIDOSCOPE_SCANNER_X86
+
+}  // namespace
+
+const Kernels *kernelsFor(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return &kScalarKernels;
+#ifdef KALEIDOSCOPE_SCANNER_X86
+        case Isa::SSE2:
+            // Part of the x86-64 baseline
+            return &kSSE2Kernels;
+        case Isa::AVX2:
+            return __builtin_cpu_supports("avx2") ? &kAVX2Kernels : nullptr;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+const Kernels &kernels() {
+    static const Kernels &best = [] () -> const Kernels & {
+        for (const Isa isa : {Isa::AVX2, Isa::SSE2}) {
+            if (const Kernels *candidate = kernelsFor(isa)) {
+                return *candidate;
+            }
+        }
+        return kScalarKernels;
+    }();
+    return best;
+}
+
+const char *isaName(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return "scalar";
+        case Isa::SSE2:
+            return "sse2";
+        case Isa::AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+bool parseSimpleNumber(std::string_view text, double &value) {
+    // Powers of ten that are exact doubles
+    static constexpr double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr std::uint64_t kMaxExactInteger = std::uint64_t{1} << 53;
+    constexpr int kMaxDigits = 19;  // never overflows std::uint64_t
+
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    bool seenDot = false;
+
+    for (const char c : text) {
+        if (c == '.') {
+            if (seenDot) {
+                return false;
+            }
+            seenDot = true;
+            continue;
+        }
+        if (!isDigit(c) || ++digits > kMaxDigits) {
+            return false;
+        }
+
+        mantissa = mantissa * 10 + static_cast<std::uint64_t>(c - '0');
+        fractionDigits += seenDot;
+    }
+
+    if (digits == 0 || mantissa > kMaxExactInteger || fractionDigits > 22) {
+        return false;
+    }
+
+    value = static_cast<double>(mantissa) / kPowersOfTen[fractionDigits];
+    return true;
+}
+
+}  // namespace scan
@@ -0,0 +1,121 @@
+#include "ConstantFolder.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+
+void ConstantFolder::define(const FunctionAST &func) {
+    const std::vector<Symbol> &params = func.m_prototype.getArgs();
+    if (isPure(func.m_body, params)) {
+        m_functions.insert_or_assign(func.m_prototype.getName(), PureFunction{params, func.m_body});
+    } else {
+        m_functions.erase(func.m_prototype.getName());
+    }
+}
+
+std::optional<double> ConstantFolder::evaluate(const ExprPool &expr) const {
+    std::size_t nodes = 0;
+    return evaluate(expr, {}, {}, 0, nodes);
+}
+
+bool ConstantFolder::isPure(const ExprPool &body, std::span<const Symbol> params) const {
+    for (ExprId id = 0; id < body.size(); ++id) {
+        switch (body.kind(id)) {
+            case ExprKind::Number:
+            case ExprKind::Binary:
+                break;
+            case ExprKind::Variable:
+                if (std::find(params.begin(), params.end(), body.symbol(id)) == params.end()) {
+                    return false;
+                }
+                break;
+            case ExprKind::Call: {
+                const auto it = m_functions.find(body.symbol(id));
+                if (it == m_functions.end() || it->second.m_params.size() != body.args(id).size()) {
+                    return false;
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+std::optional<double> ConstantFolder::evaluate(const ExprPool &expr, std::span<const Symbol> params,
+                                               std::span<const double> args, std::size_t depth,
+                                               std::size_t &nodes) const {
+    if (expr.empty() || depth > kMaxDepth || (nodes += expr.size()) > kMaxNodes) {
+        return std::nullopt;
+    }
+
+    // Value of every node visited so far. Every node feeds the root, a single non-constant node makes the whole
+    // expression non-constant.
+    llvm::SmallVector<double, 64> values;
+    values.reserve(expr.size());
+
+    for (ExprId id = 0; id < expr.size(); ++id) {
+        switch (expr.kind(id)) {
+            case ExprKind::Number:
+                values.push_back(expr.number(id));
+                break;
+
+            case ExprKind::Variable: {
+                // The last parameter of that name, like codegen, where a later argument replaces an earlier one
+                const auto it = std::find(params.rbegin(), params.rend(), expr.symbol(id));
+                if (it == params.rend()) {
+                    return std::nullopt;
+                }
+                values.push_back(args[params.rend() - it - 1]);
+                break;
+            }
+
+            case ExprKind::Binary: {
+                const double lhs = values[expr.lhs(id)];
+                const double rhs = values[expr.rhs(id)];
+
+                switch (expr.op(id)) {
+                    case '+':
+                        values.push_back(lhs + rhs);
+                        break;
+                    case '-':
+                        values.push_back(lhs - rhs);
+                        break;
+                    case '*':
+                        values.push_back(lhs * rhs);
+                        break;
+                    case '<':
+                        // fcmp ult: less than, or unordered
+                        values.push_back(!(lhs >= rhs) ? 1.0 : 0.0);
+                        break;
+                    default:
+                        return std::nullopt;
+                }
+                break;
+            }
+
+            case ExprKind::Call: {
+                const auto it = m_functions.find(expr.symbol(id));
+                const std::span<const ExprId> argIds = expr.args(id);
+                if (it == m_functions.end() || it->second.m_params.size() != argIds.size()) {
+                    return std::nullopt;
+                }
+
+                llvm::SmallVector<double, 8> argValues;
+                argValues.reserve(argIds.size());
+                for (const ExprId argId : argIds) {
+                    argValues.push_back(values[argId]);
+                }
+
+                const PureFunction &callee = it->second;
+                const auto result = evaluate(callee.m_body, callee.m_params, argValues, depth + 1, nodes);
+                if (!result) {
+                    return std::nullopt;
+                }
+                values.push_back(*result);
+                break;
+            }
+        }
+    }
+
+    return values.back();
+}
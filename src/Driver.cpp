@@ -0,0 +1,435 @@
+#include "Driver.hpp"
+
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+Driver::Driver(Lexer &lexer, const Options &options)
+    : m_parser(lexer)
+    , m_options(options)
+    , m_folder()
+    , m_splitModules(options.m_lazy || options.m_jitThreads > 1 || options.m_tiered || options.m_hotSwap)
+    , m_itemsPerModule(options.m_lazy || options.m_hotSwap ? 1 : kItemsPerParallelModule)
+    , m_pendingItems(0)
+    , m_passProfiler(options.m_passProfile ? std::make_unique<PassProfiler>() : nullptr)
+    , m_exportedFunctions(std::make_shared<ExportedFunctions>())
+    , m_contexts()
+    , m_currentContext(0)
+    , m_objectCache()
+    , m_JIT()
+    , m_tiered()
+    , m_hotSwapper()
+    , m_memoizer()
+    , m_batchEntries() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    // Without a usable directory everything is simply compiled
+    if (!m_options.m_objectCache.empty()) {
+        m_objectCache = ObjectCacheDirectory::open(m_options.m_objectCache, m_options.m_objectCacheMegabytes << 20);
+    }
+
+    llvm::ExitOnError{}(
+        llvm::orc::KaleidoscopeJIT::Create(m_options.m_lazy, m_options.m_jitThreads, m_objectCache.get()).moveInto(m_JIT));
+
+    // The JIT holds the lock of a module's context while compiling it, modules compiled in parallel need contexts of
+    // their own. The lazy JIT splits functions off into contexts of their own anyway. The pieces of the parallel front
+    // end are generated in a context each.
+    const std::size_t contexts =
+        std::max<std::size_t>(m_JIT->isLazy() ? 1 : m_options.m_jitThreads, m_options.m_parseThreads);
+    const PassInstrumentation instrumentation{m_options.m_debugPasses, m_passProfiler.get()};
+    for (std::size_t i = 0; i < contexts; ++i) {
+        m_contexts.push_back(
+            std::make_unique<LLVMContextData>(m_exportedFunctions, m_options.m_optLevel, nullptr, instrumentation));
+        m_contexts.back()->startModule(kModuleName, m_JIT->getDataLayout());
+    }
+
+    if (m_options.m_memoize) {
+        m_memoizer = std::make_unique<Memoizer>(*m_JIT, m_options.m_memoEntries);
+    }
+
+    if (m_options.m_batchEntries) {
+        m_batchEntries = std::make_unique<BatchEntryPoints>();
+    }
+
+    if (m_options.m_hotSwap) {
+        for (const auto &ctxData : m_contexts) {
+            ctxData->m_allowRedefinition = true;
+        }
+        m_hotSwapper = std::make_unique<HotSwapper>(*m_JIT);
+    }
+
+    if (m_options.m_tiered) {
+        // Tier 0 is not optimized at all, tier 1 runs a pipeline of its own
+        for (const auto &ctxData : m_contexts) {
+            ctxData->m_optimizeFunctions = false;
+        }
+        m_tiered = std::make_unique<TieredCompiler>(*m_JIT, m_options.m_tierThreshold, m_passProfiler.get());
+    } else if (m_JIT->isLazy() || isModuleLevel(m_options.m_optLevel)) {
+        // Modules are optimized right before they are compiled, with the pipeline of the context they were generated
+        // in. The JIT holds the lock of that context meanwhile, codegen never runs in it at the same time(calls into
+        // JIT'd code are synchronous and batch mode compiles only after codegen).
+        for (const auto &ctxData : m_contexts) {
+            ctxData->m_optimizeFunctions = false;
+        }
+
+        m_JIT->setOptimizer([this](llvm::orc::ThreadSafeModule threadSafeModule,
+                                   const llvm::orc::MaterializationResponsibility &) {
+            threadSafeModule.withModuleDo([this](llvm::Module &module) {
+                if (m_JIT->isLazy()) {
+                    std::lock_guard lock{m_optimizerMutex};
+                    llvmCtxData().m_llvmOpt.optimize(module);
+                } else if (LLVMContextData *const ctxData = contextOf(module.getContext()); ctxData) {
+                    ctxData->m_llvmOpt.optimize(module);
+                }
+            });
+            return llvm::Expected<llvm::orc::ThreadSafeModule>(std::move(threadSafeModule));
+        });
+    }
+}
+
+void Driver::runInteractive() {
+    const auto printPrompt = [] { std::cout << "ready> "; };
+
+    printPrompt();
+
+    // Read the first token
+    m_parser.start();
+
+    while (true) {
+        switch (m_parser.peekTopLevel()) {
+            case Parser::TopLevel::EndOfInput:
+                std::cout << "EOF\n";
+
+                // Print everything on exit
+                llvmCtxData().m_llvmModule->print(llvm::outs(), nullptr);
+                printCacheStats();
+                return;
+            case Parser::TopLevel::Definition:
+                handleDefinition();
+                break;
+            case Parser::TopLevel::Extern:
+                handleExtern();
+                break;
+            case Parser::TopLevel::Separator:
+                // Ignore top-level semicolons
+                printPrompt();
+                m_parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression:
+                handleTopLevelExpression();
+                break;
+        }
+    }
+}
+
+int Driver::runBatch() {
+    int errors = 0;
+    std::vector<TopLevelExpression> expressions;
+
+    m_parser.start();
+
+    for (auto item = m_parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = m_parser.peekTopLevel()) {
+        switch (item) {
+            case Parser::TopLevel::Definition:
+                errors += !compileFunction(m_parser.parseDefinition(), true);
+                errors += !itemGenerated();
+                break;
+            case Parser::TopLevel::Extern: {
+                const auto externProto = m_parser.parseExtern();
+                errors += !(externProto && externProto->codegen(llvmCtxData()));
+                errors += !itemGenerated();
+                break;
+            }
+            case Parser::TopLevel::Separator:
+                m_parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression: {
+                // Nothing runs before the whole program is compiled, the expressions stay in the JIT like the
+                // definitions
+                const Symbol name = Symbol::intern(kAnonExprIdentifier + std::to_string(expressions.size()));
+                auto anonFunc = m_parser.parseTopLevelExpr(name);
+
+                // Constant expressions are not compiled at all
+                if (const auto value = anonFunc ? m_folder.evaluate(anonFunc->m_body) : std::nullopt; value) {
+                    expressions.push_back({name, value});
+                    m_parser.recycle(*anonFunc);
+                    break;
+                }
+
+                if (compileFunction(std::move(anonFunc), false)) {
+                    expressions.push_back({name, std::nullopt});
+                } else {
+                    ++errors;
+                }
+                errors += !itemGenerated();
+                break;
+            }
+            case Parser::TopLevel::EndOfInput:
+                break;
+        }
+    }
+
+    // Without m_splitModules the whole program goes to the JIT in one piece here
+    errors += !handOverDefinitions();
+
+    errors += runExpressions(expressions);
+    return errors;
+}
+
+int Driver::runBatch(std::string_view program) {
+    std::vector<TopLevelExpression> expressions;
+
+    const std::span contexts = std::span{m_contexts}.first(m_options.m_parseThreads);
+    int errors = ParallelFrontEnd{m_folder, kAnonExprIdentifier}.compile(program, contexts, expressions);
+
+    // A module per piece, in input order
+    for (std::size_t i = 0; i < contexts.size(); ++i) {
+        m_currentContext = i;
+        errors += !handOverDefinitions();
+    }
+
+    errors += runExpressions(expressions);
+    return errors;
+}
+
+int Driver::runExpressions(const std::vector<TopLevelExpression> &expressions) {
+    int errors = 0;
+
+    if (m_splitModules && !m_JIT->isLazy()) {
+        // Compile everything in one go, so that the worker threads can take the modules in parallel
+        std::vector<std::string> names;
+        for (const auto &[name, exported] : *m_exportedFunctions) {
+            if (exported.m_defined) {
+                names.emplace_back(name.str());
+            }
+        }
+
+        // A module that fails is reported here, the expressions that need it fail on their own below
+        if (auto error = m_JIT->materialize(names)) {
+            std::cout << "Error: " << llvm::toString(std::move(error)) << '\n';
+            ++errors;
+        }
+    }
+
+    // Results are collected and written out in one go, those before an error right before it
+    std::ostringstream results;
+
+    for (const auto &[name, value] : expressions) {
+        if (value) {
+            results << *value << '\n';
+            continue;
+        }
+
+        // Fails if an extern it calls is nowhere to be found, or if a module it needs did not compile
+        auto exprSymbol = m_JIT->lookup(name.str());
+        if (!exprSymbol) {
+            std::cout << results.str() << "Error: " << llvm::toString(exprSymbol.takeError()) << '\n';
+            results.str({});
+            ++errors;
+            continue;
+        }
+
+        // In lazy mode a body that fails to compile on the call ends the process, what came before goes out first
+        if (m_JIT->isLazy()) {
+            std::cout << results.str();
+            results.str({});
+        }
+
+        double (*nativeAnonFunc)() = exprSymbol->getAddress().toPtr<double (*)()>();
+        trace::Scope scope{"execute", name.str()};
+        results << nativeAnonFunc() << '\n';
+    }
+
+    std::cout << results.str() << std::flush;
+
+    printCacheStats();
+    return errors;
+}
+
+void Driver::handleDefinition() {
+    if (const auto funcDef = m_parser.parseDefinition(); funcDef) {
+        std::cout << "Parsed a function definition\n";
+
+        if (const auto value = funcDef->codegen(llvmCtxData()); value) {
+            value->print(llvm::outs());
+            std::cout << '\n';
+
+            m_folder.define(*funcDef);
+        }
+
+        m_parser.recycle(*funcDef);
+
+        itemGenerated();
+    }
+}
+
+void Driver::handleExtern() {
+    if (const auto externProto = m_parser.parseExtern(); externProto) {
+        std::cout << "Parsed an extern\n";
+
+        if (const auto value = externProto->codegen(llvmCtxData()); value) {
+            value->print(llvm::outs());
+            std::cout << '\n';
+        }
+
+        itemGenerated();
+    }
+}
+
+void Driver::handleTopLevelExpression() {
+    if (const auto anonFunc = m_parser.parseTopLevelExpr(Symbol::intern(kAnonExprIdentifier)); anonFunc) {
+        std::cout << "Parsed a top-level expr\n";
+
+        // Constant: no IR, nothing to run
+        if (const auto result = m_folder.evaluate(anonFunc->m_body); result) {
+            std::cout << "Evaluated to " << *result << '\n';
+            m_parser.recycle(*anonFunc);
+            return;
+        }
+
+        // The definitions stay in the JIT for good, the expression is removed after it ran. They go in a module of
+        // their own, the following items declare them from m_exportedFunctions.
+        if (m_pendingItems > 0) {
+            handOverDefinitions();
+        }
+
+        if (const auto value = anonFunc->codegen(llvmCtxData()); value) {
+            value->print(llvm::outs());
+            std::cout << '\n';
+
+            // Remove anon function from the LLVM Module(unlink + delete)
+            // value->eraseFromParent();
+
+            // Create a ResourceTracker to track JIT'd memory allocated to our anonymous
+            // expression -- that way we can free it after executing
+            auto resourceTracker = m_JIT->getMainJITDylib().createResourceTracker();
+
+            llvm::ExitOnError{}(m_JIT->addEagerModule(llvmCtxData().takeModule(), resourceTracker));
+
+            // We lost the module -> start a new one in the same context
+            startNewModule();
+
+            // Search the JIT for the __anon_expr symbol. It fails if an extern it calls is nowhere to be found.
+            if (auto exprSymbol = m_JIT->lookup(kAnonExprIdentifier); exprSymbol) {
+                // Get the symbol's address and cast it to the right type (takes no arguments, returns a double) so we
+                // can call it as a native function
+                double (*nativeAnonFunc)() = exprSymbol->getAddress().toPtr<double (*)()>();
+                trace::Scope scope{"execute"};
+                const double result = nativeAnonFunc();
+                scope.finish();
+
+                std::cout << "Evaluated to " << result << '\n';
+            } else {
+                std::cout << "Error: " << llvm::toString(exprSymbol.takeError()) << '\n';
+            }
+
+            // Delete the anonymous expression module from the JIT
+            llvm::ExitOnError{}(resourceTracker->remove());
+        }
+
+        m_parser.recycle(*anonFunc);
+    }
+}
+
+llvm::Function *Driver::compileFunction(std::unique_ptr<FunctionAST> func, bool isDefinition) {
+    if (!func) {
+        return nullptr;
+    }
+
+    llvm::Function *value = func->codegen(llvmCtxData());
+    if (value && isDefinition) {
+        m_folder.define(*func);
+    }
+    m_parser.recycle(*func);
+    return value;
+}
+
+LLVMContextData *Driver::contextOf(const llvm::LLVMContext &llvmContext) {
+    for (const auto &ctxData : m_contexts) {
+        if (&ctxData->m_llvmContext == &llvmContext) {
+            return ctxData.get();
+        }
+    }
+    return nullptr;
+}
+
+void Driver::printCacheStats() const {
+    if (m_options.m_cacheStats && m_objectCache) {
+        const ObjectCacheDirectory::Stats stats = m_objectCache->stats();
+        std::cout << "Object cache: " << stats.m_hits << " hits, " << stats.m_misses << " misses, " << stats.m_stored
+                  << " stored, " << stats.m_evicted << " evicted, " << stats.m_bytes << " bytes\n";
+    }
+
+    if (m_options.m_memoStats && m_memoizer) {
+        m_memoizer->printStats();
+    }
+
+    if (m_passProfiler) {
+        m_passProfiler->printReport();
+    }
+}
+
+void Driver::startNewModule() {
+    llvmCtxData().startModule(kModuleName, m_JIT->getDataLayout());
+}
+
+bool Driver::itemGenerated() {
+    return ++m_pendingItems < m_itemsPerModule || !m_splitModules || handOverDefinitions();
+}
+
+bool Driver::handOverDefinitions() {
+    if (m_options.m_batch && m_options.m_emitIR) {
+        llvmCtxData().m_llvmModule->print(llvm::outs(), nullptr);
+    }
+
+    m_pendingItems = 0;
+
+    // Exported right away for the memoizer and the batch entry points, withdrawn if the JIT does not take the module
+    ExportedFunctions replaced = llvmCtxData().exportFunctions();
+    if (m_memoizer) {
+        m_memoizer->memoize(*llvmCtxData().m_llvmModule, *m_exportedFunctions);
+    }
+    if (m_batchEntries) {
+        m_batchEntries->generate(*llvmCtxData().m_llvmModule, *m_exportedFunctions);
+    }
+
+    // Fails for a definition of a name the JIT already resolved elsewhere, like a function of the host process that
+    // was declared and called before
+    const std::vector<Symbol> names = llvmCtxData().functionNames();
+    llvm::Error error = llvm::Error::success();
+    if (m_tiered) {
+        error = m_tiered->addModule(llvmCtxData().takeModule());
+    } else if (m_hotSwapper) {
+        error = m_hotSwapper->addModule(llvmCtxData().takeModule());
+    } else {
+        error = m_JIT->addModule(llvmCtxData().takeModule());
+    }
+
+    if (error) {
+        llvmCtxData().withdrawExports(names, std::move(replaced));
+    } else if (m_hotSwapper) {
+        // Nothing runs between two items, the replaced bodies can go right away
+        error = m_hotSwapper->releaseRetired();
+    }
+
+    const bool succeeded = !error;
+    if (error) {
+        std::cout << "Error: " << llvm::toString(std::move(error)) << '\n';
+    }
+    startNewModule();
+
+    // Continue in the next context, so that the JIT can compile the next module in parallel with this one
+    m_currentContext = (m_currentContext + 1) % m_contexts.size();
+    return succeeded;
+}
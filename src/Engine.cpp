@@ -0,0 +1,161 @@
+#include "Engine.hpp"
+
+#include "KaleidoscopeJIT.h"
+#include "LLVMContextData.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Utils.hpp"
+
+#include "llvm/Support/TargetSelect.h"
+
+#include <algorithm>
+
+namespace kaleidoscope {
+
+namespace {
+
+Error joinMessages(const std::vector<std::string> &messages) {
+    std::string message;
+    for (const std::string &line : messages) {
+        message += (message.empty() ? "" : "\n") + line;
+    }
+    return Error{message};
+}
+
+}  // namespace
+
+Result<void *> Program::resolve(std::string_view name, std::size_t arity) const {
+    if (std::find(m_functions.begin(), m_functions.end(), name) == m_functions.end()) {
+        return Error{"'" + std::string{name} + "' is not defined by this program"};
+    }
+    return m_engine->resolve(Symbol::intern(name), arity);
+}
+
+Result<std::unique_ptr<Engine>> Engine::create(OptLevel optLevel) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    auto jit = llvm::orc::KaleidoscopeJIT::Create();
+    if (!jit) {
+        return Error{llvm::toString(jit.takeError())};
+    }
+    return std::unique_ptr<Engine>(new Engine(std::move(*jit), optLevel));
+}
+
+Engine::Engine(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit, OptLevel optLevel)
+    : m_optLevel(optLevel)
+    , m_JIT(std::move(jit))
+    , m_ctxData(std::make_unique<LLVMContextData>(std::make_shared<ExportedFunctions>(), optLevel))
+    , m_mutex()
+    , m_addresses() {
+    m_ctxData->startModule(kModuleName, m_JIT->getDataLayout());
+
+    // What the session cannot return to a caller(why a materialization failed) goes to the errors captured on the
+    // thread that caused it, instead of to stderr. Nothing captures while the JIT shuts down, those are dropped.
+    m_JIT->setErrorReporter([](llvm::Error error) {
+        std::string message = llvm::toString(std::move(error));
+        if (std::vector<std::string> *const messages = utils::ScopedErrorCapture::messages(); messages) {
+            messages->push_back(std::move(message));
+        }
+    });
+}
+
+Engine::~Engine() = default;
+
+Result<Program> Engine::compile(std::string_view source) {
+    std::lock_guard lock{m_mutex};
+
+    // The parser and codegen report through utils::logError(), into `messages` from here on
+    std::vector<std::string> messages;
+    utils::ScopedErrorCapture capture{messages};
+
+    Lexer lexer{std::make_unique<StringSource>(source)};
+    Parser parser{lexer};
+    parser.start();
+
+    std::vector<std::string> functions;
+    for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+        switch (item) {
+            case Parser::TopLevel::Definition: {
+                const auto func = parser.parseDefinition();
+                if (!func || !func->codegen(*m_ctxData)) {
+                    return discardModule(messages);
+                }
+
+                functions.emplace_back(func->m_prototype.getName().str());
+                parser.recycle(*func);
+                break;
+            }
+            case Parser::TopLevel::Extern: {
+                const auto externProto = parser.parseExtern();
+                if (!externProto || !externProto->codegen(*m_ctxData)) {
+                    return discardModule(messages);
+                }
+                break;
+            }
+            case Parser::TopLevel::Separator:
+                parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression:
+                utils::logError("top-level expressions cannot be compiled, call a function instead");
+                return discardModule(messages);
+            case Parser::TopLevel::EndOfInput:
+                break;
+        }
+    }
+
+    // Optimized right away, the module is compiled on the first lookup of one of its functions
+    if (isModuleLevel(m_optLevel)) {
+        m_ctxData->m_llvmOpt.optimize(*m_ctxData->m_llvmModule);
+    }
+
+    const std::vector<Symbol> names = m_ctxData->functionNames();
+    ExportedFunctions replaced = m_ctxData->exportFunctions();
+    if (auto error = m_JIT->addModule(m_ctxData->takeModule())) {
+        m_ctxData->withdrawExports(names, std::move(replaced));
+        messages.push_back(llvm::toString(std::move(error)));
+        return discardModule(messages);
+    }
+    m_ctxData->startModule(kModuleName, m_JIT->getDataLayout());
+
+    return Program{*this, std::move(functions)};
+}
+
+Result<void *> Engine::resolve(Symbol name, std::size_t arity) {
+    std::lock_guard lock{m_mutex};
+
+    const auto exported = m_ctxData->m_exportedFunctions->find(name);
+    if (exported == m_ctxData->m_exportedFunctions->end() || !exported->second.m_defined) {
+        return Error{"unknown function '" + std::string{name.str()} + "'"};
+    }
+    if (exported->second.m_arity != arity) {
+        return Error{"'" + std::string{name.str()} + "' takes " + std::to_string(exported->second.m_arity) +
+                     " arguments, not " + std::to_string(arity)};
+    }
+
+    if (const auto it = m_addresses.find(name); it != m_addresses.end()) {
+        return it->second;
+    }
+
+    // Compiles the module on the first lookup, the reasons it fails come through the error reporter
+    std::vector<std::string> messages;
+    utils::ScopedErrorCapture capture{messages};
+
+    auto symbol = m_JIT->lookup(name.str());
+    if (!symbol) {
+        messages.push_back(llvm::toString(symbol.takeError()));
+        return joinMessages(messages);
+    }
+
+    void *const address = symbol->getAddress().toPtr<void *>();
+    m_addresses.emplace(name, address);
+    return address;
+}
+
+Error Engine::discardModule(const std::vector<std::string> &messages) {
+    m_ctxData->startModule(kModuleName, m_JIT->getDataLayout());
+    return joinMessages(messages);
+}
+
+}  // namespace kaleidoscope
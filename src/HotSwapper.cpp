@@ -0,0 +1,109 @@
+#include "HotSwapper.hpp"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+HotSwapper::HotSwapper(llvm::orc::KaleidoscopeJIT &jit)
+    : m_jit(jit) {
+}
+
+std::string HotSwapper::bodyName(Symbol name, std::uint64_t version) {
+    return std::string{name.str()} + kVersionSeparator + std::to_string(version);
+}
+
+llvm::Error HotSwapper::addModule(llvm::orc::ThreadSafeModule threadSafeModule) {
+    std::vector<Symbol> names;
+    std::vector<std::string> bodies;
+
+    threadSafeModule.withModuleDo([&](llvm::Module &module) {
+        // Collect first, every definition leaves a declaration of its stub behind
+        std::vector<llvm::Function *> definitions;
+        for (llvm::Function &func : module) {
+            if (!func.isDeclaration()) {
+                definitions.push_back(&func);
+            }
+        }
+
+        for (llvm::Function *func : definitions) {
+            const Symbol name = Symbol::intern(std::string_view{func->getName()});
+            names.push_back(name);
+            bodies.push_back(bodyName(name, m_functions[name].m_versions++));
+
+            // Every call, the recursive ones included, goes through the stub from now on
+            func->setName(bodies.back());
+            llvm::Function *const stub =
+                llvm::Function::Create(func->getFunctionType(), llvm::Function::ExternalLinkage, name.str(), module);
+            func->replaceAllUsesWith(stub);
+        }
+    });
+
+    if (names.empty()) {
+        return m_jit.addModule(std::move(threadSafeModule));
+    }
+
+    // The stubs of new names point nowhere until their bodies are compiled, nothing can call them before that
+    std::vector<std::string> newStubs;
+    for (const Symbol name : names) {
+        if (!m_functions[name].m_module) {
+            newStubs.emplace_back(name.str());
+        }
+    }
+    if (!newStubs.empty()) {
+        if (auto error = m_jit.addRedirectableSymbols(newStubs)) {
+            return error;
+        }
+    }
+
+    // Compiled right away, so that a failure leaves the stubs as they were
+    auto tracker = m_jit.getMainJITDylib().createResourceTracker();
+    llvm::Error error = m_jit.addModule(std::move(threadSafeModule), tracker);
+    if (!error) {
+        error = m_jit.materialize(bodies);
+    }
+
+    std::vector<llvm::orc::ExecutorAddr> addresses;
+    for (std::size_t i = 0; i < bodies.size() && !error; ++i) {
+        if (auto bodySymbol = m_jit.lookup(bodies[i])) {
+            addresses.push_back(bodySymbol->getAddress());
+        } else {
+            error = bodySymbol.takeError();
+        }
+    }
+
+    if (error) {
+        // A stub that never pointed anywhere must not be found by the modules that follow
+        error = llvm::joinErrors(std::move(error), tracker->remove());
+        if (!newStubs.empty()) {
+            error = llvm::joinErrors(std::move(error), m_jit.removeSymbols(newStubs));
+        }
+        return error;
+    }
+
+    const auto loaded = std::make_shared<LoadedModule>(LoadedModule{tracker, names.size()});
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        if (auto redirectError = m_jit.redirect(names[i].str(), addresses[i])) {
+            return redirectError;
+        }
+
+        // The previous body is unreachable from now on, its module once all of its bodies are
+        SwappableFunction &function = m_functions[names[i]];
+        if (function.m_module) {
+            ++m_redefinitions;
+            if (--function.m_module->m_liveBodies == 0) {
+                m_retired.push_back(function.m_module->m_tracker);
+            }
+        }
+        function.m_module = loaded;
+    }
+
+    return llvm::Error::success();
+}
+
+llvm::Error HotSwapper::releaseRetired() {
+    llvm::Error error = llvm::Error::success();
+    for (const auto &tracker : m_retired) {
+        error = llvm::joinErrors(std::move(error), tracker->remove());
+    }
+    m_retired.clear();
+    return error;
+}
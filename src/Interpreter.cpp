@@ -0,0 +1,135 @@
+#include "Interpreter.hpp"
+
+#include "Trace.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+Interpreter::Interpreter(Lexer &lexer)
+    : m_parser(lexer)
+    , m_program()
+    , m_vm() {
+}
+
+void Interpreter::runInteractive() {
+    const auto printPrompt = [] { std::cout << "ready> "; };
+
+    printPrompt();
+
+    m_parser.start();
+
+    while (true) {
+        switch (m_parser.peekTopLevel()) {
+            case Parser::TopLevel::EndOfInput:
+                std::cout << "EOF\n";
+                return;
+            case Parser::TopLevel::Definition:
+                handleDefinition();
+                break;
+            case Parser::TopLevel::Extern:
+                handleExtern();
+                break;
+            case Parser::TopLevel::Separator:
+                printPrompt();
+                m_parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression:
+                handleTopLevelExpression();
+                break;
+        }
+    }
+}
+
+int Interpreter::runBatch() {
+    int errors = 0;
+
+    // Run once every item is compiled, so that the results are written out together at the end, like the JIT does
+    std::vector<BytecodeFunction> expressions;
+
+    m_parser.start();
+
+    for (auto item = m_parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = m_parser.peekTopLevel()) {
+        switch (item) {
+            case Parser::TopLevel::Definition:
+                if (const auto func = m_parser.parseDefinition(); func) {
+                    errors += !m_program.define(*func);
+                    m_parser.recycle(*func);
+                } else {
+                    ++errors;
+                }
+                break;
+            case Parser::TopLevel::Extern: {
+                const auto externProto = m_parser.parseExtern();
+                errors += !(externProto && m_program.declare(*externProto));
+                break;
+            }
+            case Parser::TopLevel::Separator:
+                m_parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression:
+                if (const auto anonFunc = m_parser.parseTopLevelExpr(Symbol::intern(kAnonExprIdentifier)); anonFunc) {
+                    if (auto expression = m_program.compileExpression(*anonFunc); expression) {
+                        expressions.push_back(std::move(*expression));
+                    } else {
+                        ++errors;
+                    }
+                    m_parser.recycle(*anonFunc);
+                } else {
+                    ++errors;
+                }
+                break;
+            case Parser::TopLevel::EndOfInput:
+                break;
+        }
+    }
+
+    // Results are collected and written out in one go
+    std::ostringstream results;
+
+    for (const BytecodeFunction &expression : expressions) {
+        trace::Scope scope{"execute"};
+        if (const auto result = m_vm.run(m_program, expression); result) {
+            results << *result << '\n';
+        } else {
+            ++errors;
+        }
+    }
+
+    std::cout << results.str() << std::flush;
+
+    return errors;
+}
+
+void Interpreter::handleDefinition() {
+    if (const auto funcDef = m_parser.parseDefinition(); funcDef) {
+        std::cout << "Parsed a function definition\n";
+        m_program.define(*funcDef);
+        m_parser.recycle(*funcDef);
+    }
+}
+
+void Interpreter::handleExtern() {
+    if (const auto externProto = m_parser.parseExtern(); externProto) {
+        std::cout << "Parsed an extern\n";
+        m_program.declare(*externProto);
+    }
+}
+
+void Interpreter::handleTopLevelExpression() {
+    if (const auto anonFunc = m_parser.parseTopLevelExpr(Symbol::intern(kAnonExprIdentifier)); anonFunc) {
+        std::cout << "Parsed a top-level expr\n";
+
+        if (const auto expression = m_program.compileExpression(*anonFunc); expression) {
+            trace::Scope scope{"execute"};
+            const auto result = m_vm.run(m_program, *expression);
+            scope.finish();
+
+            if (result) {
+                std::cout << "Evaluated to " << *result << '\n';
+            }
+        }
+
+        m_parser.recycle(*anonFunc);
+    }
+}
@@ -1,8 +1,55 @@
 #include "LLVMContextData.hpp"
+#include "Trace.hpp"
 
-LLVMOptContextData::LLVMOptContextData(llvm::LLVMContext &llvmCtx)
-    : m_SI(llvmCtx, true /* Debug logging */) {
-    m_SI.registerCallbacks(m_PIC, &m_MAM);
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/Error.h"
+
+#include <vector>
+
+namespace {
+llvm::OptimizationLevel passBuilderLevel(OptLevel level) {
+    switch (level) {
+        case OptLevel::O1:
+            return llvm::OptimizationLevel::O1;
+        case OptLevel::O2:
+            return llvm::OptimizationLevel::O2;
+        case OptLevel::O3:
+            return llvm::OptimizationLevel::O3;
+        default:
+            return llvm::OptimizationLevel::O0;
+    }
+}
+}  // namespace
+
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(OptLevel level) {
+    auto targetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetMachineBuilder) {
+        llvm::consumeError(targetMachineBuilder.takeError());
+        return nullptr;
+    }
+
+    if (level == OptLevel::O3) {
+        targetMachineBuilder->setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+    }
+
+    auto targetMachine = targetMachineBuilder->createTargetMachine();
+    if (!targetMachine) {
+        llvm::consumeError(targetMachine.takeError());
+        return nullptr;
+    }
+    return std::move(*targetMachine);
+}
+
+LLVMOptContextData::LLVMOptContextData(llvm::LLVMContext &llvmCtx, OptLevel level, llvm::TargetMachine *targetMachine,
+                                       const PassInstrumentation &instrumentation)
+    : m_level(level) {
+    if (instrumentation.m_debugLogging) {
+        m_SI = std::make_unique<llvm::StandardInstrumentations>(llvmCtx, true /* Debug logging */);
+        m_SI->registerCallbacks(m_PIC, &m_MAM);
+    }
+    if (instrumentation.m_profiler) {
+        instrumentation.m_profiler->registerCallbacks(m_PIC);
+    }
 
     // Add transform passes
     //
@@ -15,17 +62,140 @@ LLVMOptContextData::LLVMOptContextData(llvm::LLVMContext &llvmCtx)
     // Simplify the control flow graph (deleting unreachable blocks, etc)
     m_FPM.addPass(llvm::SimplifyCFGPass());
 
-    // Register analysis passes used in these transform passes
-    llvm::PassBuilder passBuilder;
+    // The vectorizers are off unless asked for, like in clang they come with -O2
+    llvm::PipelineTuningOptions tuningOptions;
+    tuningOptions.LoopVectorization = level == OptLevel::O2 || level == OptLevel::O3;
+    tuningOptions.SLPVectorization = tuningOptions.LoopVectorization;
+
+    // Register analysis passes used in these transform passes. Without a PassInstrumentationCallbacks the pass
+    // managers skip instrumentation altogether.
+    llvm::PassBuilder passBuilder{targetMachine, tuningOptions, {}, instrumentation.enabled() ? &m_PIC : nullptr};
     passBuilder.registerModuleAnalyses(m_MAM);
+    passBuilder.registerCGSCCAnalyses(m_CGAM);
     passBuilder.registerFunctionAnalyses(m_FAM);
+    passBuilder.registerLoopAnalyses(m_LAM);
     passBuilder.crossRegisterProxies(m_LAM, m_FAM, m_CGAM, m_MAM);
+
+    if (level == OptLevel::O0) {
+        m_MPM = passBuilder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+    } else if (isModuleLevel(level)) {
+        m_MPM = passBuilder.buildPerModuleDefaultPipeline(passBuilderLevel(level));
+    }
 }
 
-LLVMContextData::LLVMContextData(std::string_view moduleName)
-    : m_llvmContext(std::make_unique<llvm::LLVMContext>())
-    , m_builder(*m_llvmContext)
-    , m_llvmModule(std::make_unique<llvm::Module>(moduleName, *m_llvmContext))
+void LLVMOptContextData::clearAnalyses() {
+    m_LAM.clear();
+    m_FAM.clear();
+    m_CGAM.clear();
+    m_MAM.clear();
+}
+
+void LLVMOptContextData::optimize(llvm::Module &module) {
+    trace::Scope scope{"optimize", module.getModuleIdentifier()};
+    trace::count(trace::Counter::IrInstructionsBefore, trace::enabled() ? module.getInstructionCount() : 0);
+
+    if (isModuleLevel(m_level)) {
+        m_MPM.run(module, m_MAM);
+    } else {
+        for (llvm::Function &func : module) {
+            if (!func.isDeclaration()) {
+                m_FPM.run(func, m_FAM);
+            }
+        }
+    }
+
+    trace::count(trace::Counter::IrInstructionsAfter, trace::enabled() ? module.getInstructionCount() : 0);
+    clearAnalyses();
+}
+
+LLVMContextData::LLVMContextData(std::shared_ptr<ExportedFunctions> exportedFunctions, OptLevel optLevel,
+                                 std::unique_ptr<llvm::TargetMachine> targetMachine,
+                                 const PassInstrumentation &instrumentation)
+    : m_threadSafeContext(std::make_unique<llvm::LLVMContext>())
+    , m_llvmContext(*m_threadSafeContext.getContext())
+    , m_builder(m_llvmContext)
+    , m_llvmModule()
     , m_namedValues()
-    , m_llvmOpt(*m_llvmContext) {
+    , m_exportedFunctions(std::move(exportedFunctions))
+    , m_targetMachine(targetMachine || !isModuleLevel(optLevel) ? std::move(targetMachine)
+                                                                : createHostTargetMachine(optLevel))
+    , m_llvmOpt(m_llvmContext, optLevel, m_targetMachine.get(), instrumentation)
+    , m_optimizeFunctions(!isModuleLevel(optLevel))
+    , m_allowRedefinition(false) {
+}
+
+void LLVMContextData::startModule(std::string_view moduleName, const llvm::DataLayout &dataLayout) {
+    // The function analyses are keyed by llvm::Function addresses, which the new module may reuse
+    m_llvmOpt.clearAnalyses();
+    m_builder.ClearInsertionPoint();
+    m_namedValues.clear();
+
+    m_llvmModule = std::make_unique<llvm::Module>(moduleName, m_llvmContext);
+    m_llvmModule->setDataLayout(dataLayout);
+}
+
+llvm::orc::ThreadSafeModule LLVMContextData::takeModule() {
+    return llvm::orc::ThreadSafeModule(std::move(m_llvmModule), m_threadSafeContext);
+}
+
+llvm::Function *LLVMContextData::getFunction(Symbol name) {
+    if (llvm::Function *func = m_llvmModule->getFunction(name.str()); func) {
+        return func;
+    }
+
+    const auto it = m_exportedFunctions->find(name);
+    if (it == m_exportedFunctions->end() || it->second.m_batchEntry) {
+        return nullptr;
+    }
+
+    llvm::Type *const doubleType = llvm::Type::getDoubleTy(m_llvmContext);
+    const std::vector<llvm::Type *> argTypes(it->second.m_arity, doubleType);
+
+    return llvm::Function::Create(llvm::FunctionType::get(doubleType, argTypes, false),
+                                  llvm::Function::ExternalLinkage, name.str(), *m_llvmModule);
+}
+
+bool LLVMContextData::isExportedDefinition(Symbol name) const {
+    const auto it = m_exportedFunctions->find(name);
+    return it != m_exportedFunctions->end() && it->second.m_defined;
+}
+
+bool LLVMContextData::isCompatibleDeclaration(Symbol name, std::size_t arity) const {
+    if (const llvm::Function *func = m_llvmModule->getFunction(name.str()); func) {
+        return func->arg_size() == arity;
+    }
+
+    const auto it = m_exportedFunctions->find(name);
+    return it == m_exportedFunctions->end() || (!it->second.m_batchEntry && it->second.m_arity == arity);
+}
+
+ExportedFunctions LLVMContextData::exportFunctions() {
+    ExportedFunctions replaced;
+    for (const llvm::Function &func : *m_llvmModule) {
+        const Symbol name = Symbol::intern(std::string_view{func.getName()});
+        if (const auto it = m_exportedFunctions->find(name); it != m_exportedFunctions->end()) {
+            replaced.emplace(name, it->second);
+        }
+
+        auto &exported = (*m_exportedFunctions)[name];
+        exported.m_arity = func.arg_size();
+        exported.m_defined = exported.m_defined || !func.isDeclaration();
+    }
+    return replaced;
+}
+
+std::vector<Symbol> LLVMContextData::functionNames() const {
+    std::vector<Symbol> names;
+    names.reserve(m_llvmModule->size());
+    for (const llvm::Function &func : *m_llvmModule) {
+        names.push_back(Symbol::intern(std::string_view{func.getName()}));
+    }
+    return names;
+}
+
+void LLVMContextData::withdrawExports(const std::vector<Symbol> &names, ExportedFunctions replaced) {
+    for (const Symbol name : names) {
+        m_exportedFunctions->erase(name);
+    }
+    m_exportedFunctions->merge(replaced);
 }
@@ -0,0 +1,271 @@
+#include "Memoizer.hpp"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+
+Memoizer::Memoizer(llvm::orc::KaleidoscopeJIT &jit, std::size_t maxEntries)
+    : m_maxSlots(std::bit_floor(std::max<std::size_t>(maxEntries, 1)))
+    , m_tables() {
+    llvm::ExitOnError{}(jit.defineHostFunction(kLookupHook, llvm::orc::ExecutorAddr::fromPtr(&Memoizer::lookupHook)));
+    llvm::ExitOnError{}(jit.defineHostFunction(kStoreHook, llvm::orc::ExecutorAddr::fromPtr(&Memoizer::storeHook)));
+}
+
+void Memoizer::memoize(llvm::Module &module, ExportedFunctions &exportedFunctions) {
+    const auto pure = pureFunctions(module, exportedFunctions);
+
+    std::vector<llvm::Function *> wrapped;
+    for (llvm::Function &func : module) {
+        if (!pure.contains(&func)) {
+            continue;
+        }
+
+        if (const auto it = exportedFunctions.find(Symbol::intern(std::string_view{func.getName()}));
+            it != exportedFunctions.end()) {
+            it->second.m_pure = true;
+        }
+
+        if (!func.arg_empty()) {
+            wrapped.push_back(&func);
+        }
+    }
+
+    // Not while iterating, every wrapper adds a function to the module
+    for (llvm::Function *const func : wrapped) {
+        wrap(*func);
+    }
+}
+
+void Memoizer::printStats() const {
+    for (const MemoTable &table : m_tables) {
+        std::cout << "Memoized " << table.m_name << ": " << table.m_hits << " hits, " << table.m_misses << " misses, "
+                  << table.m_evictions << " evicted, " << table.m_size << " entries\n";
+    }
+}
+
+int Memoizer::lookupHook(MemoTable *table, const double *args, double *result) {
+    return table->lookup(args, *result);
+}
+
+void Memoizer::storeHook(MemoTable *table, const double *args, double result) {
+    table->store(args, result);
+}
+
+std::unordered_set<const llvm::Function *> Memoizer::pureFunctions(const llvm::Module &module,
+                                                                   const ExportedFunctions &exportedFunctions) const {
+    std::unordered_set<const llvm::Function *> pure;
+    for (const llvm::Function &func : module) {
+        if (!func.isDeclaration()) {
+            pure.insert(&func);
+        }
+    }
+
+    // A call makes its caller impure unless it goes to a pure function: one of the module that is still in the set,
+    // an intrinsic, or a pure function of an earlier module. Repeated until nothing changes, so that a function is
+    // impure as soon as anything it calls, however indirectly, is.
+    const auto isPureCallee = [&](const llvm::Function *callee) {
+        if (!callee) {
+            return false;
+        }
+        if (!callee->isDeclaration()) {
+            return pure.contains(callee);
+        }
+        if (callee->isIntrinsic()) {
+            return true;
+        }
+
+        const auto it = exportedFunctions.find(Symbol::intern(std::string_view{callee->getName()}));
+        return it != exportedFunctions.end() && it->second.m_defined && it->second.m_pure;
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        for (const llvm::Function &func : module) {
+            if (!pure.contains(&func)) {
+                continue;
+            }
+
+            for (const llvm::BasicBlock &block : func) {
+                for (const llvm::Instruction &instruction : block) {
+                    const auto *const call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+                    if (call && !isPureCallee(call->getCalledFunction())) {
+                        pure.erase(&func);
+                        changed = true;
+                        break;
+                    }
+                }
+                if (!pure.contains(&func)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return pure;
+}
+
+void Memoizer::wrap(llvm::Function &func) {
+    llvm::Module &module = *func.getParent();
+    llvm::LLVMContext &llvmContext = module.getContext();
+    const std::string name = func.getName().str();
+    MemoTable &table = m_tables.emplace_back(name, func.arg_size(), m_maxSlots);
+
+    // Every call, the recursive ones included, goes through the wrapper from now on
+    func.setName(name + kBodySuffix);
+    func.setLinkage(llvm::GlobalValue::InternalLinkage);
+    llvm::Function *const wrapper =
+        llvm::Function::Create(func.getFunctionType(), llvm::Function::ExternalLinkage, name, module);
+    func.replaceAllUsesWith(wrapper);
+
+    llvm::Type *const doubleType = llvm::Type::getDoubleTy(llvmContext);
+    llvm::Type *const int32Type = llvm::Type::getInt32Ty(llvmContext);
+    llvm::Type *const int64Type = llvm::Type::getInt64Ty(llvmContext);
+    llvm::Type *const pointerType = llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(llvmContext));
+    llvm::Type *const doublePointerType = llvm::PointerType::getUnqual(doubleType);
+
+    llvm::FunctionCallee lookup = module.getOrInsertFunction(
+        kLookupHook, llvm::FunctionType::get(int32Type, {pointerType, doublePointerType, doublePointerType}, false));
+    llvm::FunctionCallee store = module.getOrInsertFunction(
+        kStoreHook,
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), {pointerType, doublePointerType, doubleType}, false));
+
+    llvm::BasicBlock *const entry = llvm::BasicBlock::Create(llvmContext, "entry", wrapper);
+    llvm::BasicBlock *const hit = llvm::BasicBlock::Create(llvmContext, "memo.hit", wrapper);
+    llvm::BasicBlock *const miss = llvm::BasicBlock::Create(llvmContext, "memo.miss", wrapper);
+
+    // entry: the arguments into an array, the table looked up for them
+    llvm::IRBuilder<> builder{entry};
+    llvm::ArrayType *const argsType = llvm::ArrayType::get(doubleType, func.arg_size());
+    llvm::Value *const args = builder.CreateAlloca(argsType, nullptr, "memo.args");
+    llvm::Value *const result = builder.CreateAlloca(doubleType, nullptr, "memo.result");
+
+    llvm::SmallVector<llvm::Value *, 8> argValues;
+    for (llvm::Argument &arg : wrapper->args()) {
+        arg.setName(func.getArg(arg.getArgNo())->getName());
+        builder.CreateStore(&arg, builder.CreateConstInBoundsGEP2_32(argsType, args, 0, arg.getArgNo()));
+        argValues.push_back(&arg);
+    }
+
+    llvm::Value *const firstArg = builder.CreateConstInBoundsGEP2_32(argsType, args, 0, 0);
+    llvm::Constant *const tableAddress = llvm::ConstantExpr::getIntToPtr(
+        llvm::ConstantInt::get(int64Type, reinterpret_cast<std::uintptr_t>(&table)), pointerType);
+
+    llvm::Value *const found = builder.CreateCall(lookup, {tableAddress, firstArg, result});
+    builder.CreateCondBr(builder.CreateICmpNE(found, llvm::ConstantInt::get(int32Type, 0)), hit, miss);
+
+    // memo.hit: the cached result
+    builder.SetInsertPoint(hit);
+    builder.CreateRet(builder.CreateLoad(doubleType, result));
+
+    // memo.miss: the body, and its result into the table
+    builder.SetInsertPoint(miss);
+    llvm::Value *const computed = builder.CreateCall(&func, argValues, "calltmp");
+    builder.CreateCall(store, {tableAddress, firstArg, computed});
+    builder.CreateRet(computed);
+}
+
+Memoizer::MemoTable::MemoTable(std::string name, std::size_t arity, std::size_t maxSlots)
+    : m_name(std::move(name))
+    , m_arity(arity)
+    , m_maxSlots(maxSlots)
+    , m_keys(std::min(kInitialSlots, maxSlots) * arity)
+    , m_values(std::min(kInitialSlots, maxSlots))
+    , m_used(std::min(kInitialSlots, maxSlots)) {
+}
+
+bool Memoizer::MemoTable::lookup(const double *args, double &result) {
+    const std::size_t mask = m_values.size() - 1;
+    const std::size_t home = homeSlot(args);
+    for (std::size_t probe = 0; probe < kMaxProbes; ++probe) {
+        const std::size_t slot = (home + probe) & mask;
+        if (!m_used[slot]) {
+            break;
+        }
+        if (matches(slot, args)) {
+            ++m_hits;
+            result = m_values[slot];
+            return true;
+        }
+    }
+
+    ++m_misses;
+    return false;
+}
+
+void Memoizer::MemoTable::store(const double *args, double result) {
+    // Half full at most while the table may still grow, the probe sequences stay short
+    if (2 * (m_size + 1) > m_values.size() && m_values.size() < m_maxSlots) {
+        grow();
+    }
+
+    const std::size_t mask = m_values.size() - 1;
+    const std::size_t home = homeSlot(args);
+    for (std::size_t probe = 0; probe < kMaxProbes; ++probe) {
+        const std::size_t slot = (home + probe) & mask;
+        if (!m_used[slot] || matches(slot, args)) {
+            m_size += !m_used[slot];
+            put(slot, args, result);
+            return;
+        }
+    }
+
+    // Full around the home slot: its resident makes room
+    ++m_evictions;
+    put(home, args, result);
+}
+
+std::size_t Memoizer::MemoTable::homeSlot(const double *args) const {
+    std::uint64_t hash = 0x9e3779b97f4a7c15;
+    for (std::size_t i = 0; i < m_arity; ++i) {
+        std::uint64_t bits;
+        std::memcpy(&bits, args + i, sizeof(bits));
+        hash = (hash ^ bits) * 0xbf58476d1ce4e5b9;
+        hash ^= hash >> 31;
+    }
+    return static_cast<std::size_t>(hash) & (m_values.size() - 1);
+}
+
+bool Memoizer::MemoTable::matches(std::size_t slot, const double *args) const {
+    // Bit for bit: 0 and -0 may give different results, a NaN argument is found again
+    return std::memcmp(args, m_keys.data() + slot * m_arity, m_arity * sizeof(double)) == 0;
+}
+
+void Memoizer::MemoTable::put(std::size_t slot, const double *args, double result) {
+    std::copy(args, args + m_arity, m_keys.begin() + slot * m_arity);
+    m_values[slot] = result;
+    m_used[slot] = true;
+}
+
+void Memoizer::MemoTable::grow() {
+    std::vector<double> keys(m_keys.size() * 2);
+    std::vector<double> values(m_values.size() * 2);
+    std::vector<bool> used(m_used.size() * 2);
+    std::swap(keys, m_keys);
+    std::swap(values, m_values);
+    std::swap(used, m_used);
+
+    // A key that finds no free slot within its probes is dropped, it is only a cached result
+    const std::size_t mask = m_values.size() - 1;
+    m_size = 0;
+    for (std::size_t old = 0; old < values.size(); ++old) {
+        if (!used[old]) {
+            continue;
+        }
+
+        const double *const args = keys.data() + old * m_arity;
+        const std::size_t home = homeSlot(args);
+        for (std::size_t probe = 0; probe < kMaxProbes; ++probe) {
+            const std::size_t slot = (home + probe) & mask;
+            if (!m_used[slot]) {
+                put(slot, args, values[old]);
+                ++m_size;
+                break;
+            }
+        }
+    }
+}
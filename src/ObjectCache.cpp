@@ -0,0 +1,200 @@
+#include "ObjectCache.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Support/BLAKE3.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+std::unique_ptr<ObjectCacheDirectory> ObjectCacheDirectory::open(const std::string &path, std::uint64_t maxBytes) {
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    if (error || !std::filesystem::is_directory(path, error)) {
+        std::cout << "Error: cannot use '" << path << "' as the object cache: "
+                  << (error ? error.message() : "not a directory") << '\n';
+        return nullptr;
+    }
+
+    std::unique_ptr<ObjectCacheDirectory> directory{new ObjectCacheDirectory(path, maxBytes)};
+
+    // Index the objects already there, oldest last
+    struct Found {
+        std::filesystem::file_time_type m_used;
+        Entry m_entry;
+    };
+    std::vector<Found> found;
+
+    for (const auto &file : std::filesystem::directory_iterator(path, error)) {
+        if (!file.is_regular_file(error) || file.path().extension() != kExtension) {
+            continue;
+        }
+
+        found.push_back({file.last_write_time(error), {file.path().stem().string(), file.file_size(error)}});
+    }
+
+    std::sort(found.begin(), found.end(), [](const Found &a, const Found &b) { return a.m_used > b.m_used; });
+
+    for (const Found &object : found) {
+        directory->m_lru.push_back(object.m_entry);
+        directory->m_entries.emplace(object.m_entry.m_key, std::prev(directory->m_lru.end()));
+        directory->m_stats.m_bytes += object.m_entry.m_size;
+    }
+
+    directory->evictDownTo(maxBytes);
+    return directory;
+}
+
+ObjectCacheDirectory::ObjectCacheDirectory(std::filesystem::path path, std::uint64_t maxBytes)
+    : m_path(std::move(path))
+    , m_maxBytes(maxBytes) {
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ObjectCacheDirectory::load(const std::string &key) {
+    std::lock_guard lock{m_mutex};
+
+    if (!m_entries.contains(key)) {
+        ++m_stats.m_misses;
+        return nullptr;
+    }
+
+    // Another process may have evicted it meanwhile
+    auto object = llvm::MemoryBuffer::getFile(pathOf(key).string());
+    if (!object) {
+        m_stats.m_bytes -= m_entries.at(key)->m_size;
+        m_lru.erase(m_entries.at(key));
+        m_entries.erase(key);
+        ++m_stats.m_misses;
+        return nullptr;
+    }
+
+    touch(key);
+
+    std::error_code error;
+    std::filesystem::last_write_time(pathOf(key), std::filesystem::file_time_type::clock::now(), error);
+
+    ++m_stats.m_hits;
+    return std::move(*object);
+}
+
+void ObjectCacheDirectory::store(const std::string &key, llvm::MemoryBufferRef object) {
+    const std::uint64_t size = object.getBufferSize();
+    if (size > m_maxBytes) {
+        return;
+    }
+
+    std::lock_guard lock{m_mutex};
+
+    if (m_entries.contains(key)) {
+        touch(key);
+        return;
+    }
+
+    // Written next to its final name and renamed into place, readers in other processes never see a partial object
+    const std::filesystem::path path = pathOf(key);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp" + std::to_string(::getpid());
+
+    {
+        std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+        file.write(object.getBufferStart(), static_cast<std::streamsize>(size));
+        if (!file) {
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+
+    m_lru.push_front({key, size});
+    m_entries.emplace(key, m_lru.begin());
+    m_stats.m_bytes += size;
+    ++m_stats.m_stored;
+
+    evictDownTo(m_maxBytes);
+}
+
+ObjectCacheDirectory::Stats ObjectCacheDirectory::stats() const {
+    std::lock_guard lock{m_mutex};
+    return m_stats;
+}
+
+std::filesystem::path ObjectCacheDirectory::pathOf(const std::string &key) const {
+    return m_path / (key + kExtension);
+}
+
+void ObjectCacheDirectory::touch(const std::string &key) {
+    m_lru.splice(m_lru.begin(), m_lru, m_entries.at(key));
+}
+
+void ObjectCacheDirectory::evictDownTo(std::uint64_t maxBytes) {
+    while (m_stats.m_bytes > maxBytes && !m_lru.empty()) {
+        const Entry &oldest = m_lru.back();
+
+        std::error_code error;
+        std::filesystem::remove(pathOf(oldest.m_key), error);
+
+        m_stats.m_bytes -= oldest.m_size;
+        ++m_stats.m_evicted;
+        m_entries.erase(oldest.m_key);
+        m_lru.pop_back();
+    }
+}
+
+TargetObjectCache::TargetObjectCache(ObjectCacheDirectory &directory, const llvm::TargetMachine &targetMachine)
+    : m_directory(directory)
+    , m_target(targetMachine.getTargetTriple().str() + '\n' + targetMachine.getTargetCPU().str() + '\n' +
+               targetMachine.getTargetFeatureString().str() + '\n' +
+               std::to_string(static_cast<int>(targetMachine.getOptLevel()))) {
+}
+
+void TargetObjectCache::notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) {
+    std::string key;
+    {
+        std::lock_guard lock{m_pendingMutex};
+        const auto it = m_pendingKeys.find(module);
+        if (it == m_pendingKeys.end()) {
+            return;
+        }
+
+        key = std::move(it->second);
+        m_pendingKeys.erase(it);
+    }
+
+    m_directory.store(key, object);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> TargetObjectCache::getObject(const llvm::Module *module) {
+    std::string key = keyOf(*module);
+
+    auto object = m_directory.load(key);
+    if (!object) {
+        std::lock_guard lock{m_pendingMutex};
+        m_pendingKeys[module] = std::move(key);
+    }
+    return object;
+}
+
+std::string TargetObjectCache::keyOf(const llvm::Module &module) const {
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream{bitcode};
+    llvm::WriteBitcodeToFile(module, stream);
+
+    llvm::BLAKE3 hasher;
+    hasher.update(m_target);
+    hasher.update(llvm::StringRef{bitcode.data(), bitcode.size()});
+    return llvm::toHex(hasher.final(), true);
+}
@@ -0,0 +1,313 @@
+#include "Options.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// Parses `value` into `count`, false unless it is a positive number
+bool parseCount(std::string_view value, std::size_t &count) {
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), count);
+    return error == std::errc{} && end == value.data() + value.size() && count > 0;
+}
+
+}  // namespace
+
+std::optional<Options> Options::parse(int argc, char **argv) {
+    // Options that take a string, all of them must have one
+    const std::pair<std::string_view, std::string Options::*> kStringOptions[] = {
+        {"--emit-obj=", &Options::m_emitObj},
+        {"--emit-lib=", &Options::m_emitLib},
+        {"--emit-header=", &Options::m_emitHeader},
+        {"--mtriple=", &Options::m_targetTriple},
+        {"--mcpu=", &Options::m_targetCPU},
+        {"--trace=", &Options::m_traceFile},
+        {"--serve=", &Options::m_serveSocket},
+        {"--preload=", &Options::m_preloadFile},
+        {"--object-cache=", &Options::m_objectCache},
+    };
+
+    // Options that take a positive number, and what it counts
+    struct CountOption {
+        std::string_view m_prefix;
+        std::string_view m_unit;
+        std::size_t Options::*m_member;
+    };
+    const CountOption kCountOptions[] = {
+        {"--jit-threads=", "threads", &Options::m_jitThreads},
+        {"--parse-threads=", "threads", &Options::m_parseThreads},
+        {"--tier-threshold=", "calls", &Options::m_tierThreshold},
+        {"--serve-threads=", "threads", &Options::m_serveThreads},
+        {"--object-cache-size=", "megabytes", &Options::m_objectCacheMegabytes},
+        {"--memo-entries=", "entries", &Options::m_memoEntries},
+    };
+
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+
+        const auto stringOption = std::find_if(std::begin(kStringOptions), std::end(kStringOptions),
+                                               [arg](const auto &option) { return arg.starts_with(option.first); });
+        if (stringOption != std::end(kStringOptions)) {
+            const std::string_view value = arg.substr(stringOption->first.size());
+            if (value.empty()) {
+                std::cout << "Error: expected a value in '" << arg << "'\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+            options.*stringOption->second = value;
+            continue;
+        }
+
+        const auto countOption = std::find_if(std::begin(kCountOptions), std::end(kCountOptions),
+                                              [arg](const auto &option) { return arg.starts_with(option.m_prefix); });
+        if (countOption != std::end(kCountOptions)) {
+            if (!parseCount(arg.substr(countOption->m_prefix.size()), options.*countOption->m_member)) {
+                std::cout << "Error: expected a positive number of " << countOption->m_unit << " in '" << arg << "'\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+            continue;
+        }
+
+        if (arg == "--batch") {
+            options.m_batch = true;
+        } else if (arg == "--emit-ir") {
+            options.m_emitIR = true;
+        } else if (const auto optLevel = parseOptLevel(arg); optLevel) {
+            options.m_optLevel = *optLevel;
+        } else if (arg == "--engine=jit") {
+            options.m_engine = Engine::Jit;
+        } else if (arg == "--engine=interp") {
+            options.m_engine = Engine::Interp;
+        } else if (arg == "--lazy") {
+            options.m_lazy = true;
+        } else if (arg == "--tiered") {
+            options.m_tiered = true;
+        } else if (arg == "--hot-swap") {
+            options.m_hotSwap = true;
+        } else if (arg == "--cache-stats") {
+            options.m_cacheStats = true;
+        } else if (arg == "--memoize") {
+            options.m_memoize = true;
+        } else if (arg == "--memo-stats") {
+            options.m_memoStats = true;
+        } else if (arg == "--batch-entries") {
+            options.m_batchEntries = true;
+        } else if (arg == "--trace-summary") {
+            options.m_traceSummary = true;
+        } else if (arg == "--debug-passes") {
+            options.m_debugPasses = true;
+        } else if (arg == "--pass-profile") {
+            options.m_passProfile = true;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return std::nullopt;
+        } else if (!arg.starts_with('-') && options.m_inputFile.empty()) {
+            options.m_inputFile = arg;
+        } else {
+            std::cout << "Error: unexpected argument '" << arg << "'\n";
+            printUsage(argv[0]);
+            return std::nullopt;
+        }
+    }
+
+    if (options.m_tiered && options.m_lazy) {
+        std::cout << "Error: --tiered and --lazy cannot be combined\n";
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+
+    if (options.m_tiered && isModuleLevel(options.m_optLevel)) {
+        std::cout << "Error: --tiered picks its own optimization levels, -O0 to -O3 cannot be combined with it\n";
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+
+    if (options.m_memoize && options.m_tiered) {
+        std::cout << "Error: --memoize and --tiered cannot be combined\n";
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+
+    if (options.m_memoize && options.aheadOfTime()) {
+        std::cout << "Error: --memoize keeps its caches in the running process, it cannot be combined with --emit-obj "
+                     "and --emit-lib\n";
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+
+    if (options.m_parseThreads > 1 && (!options.m_batch || options.aheadOfTime())) {
+        std::cout << "Error: --parse-threads splits up a whole program, it needs --batch and cannot be combined with "
+                     "--emit-obj and --emit-lib\n";
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+
+    if (options.m_hotSwap) {
+        // Batch mode folds and orders the items as if every name had a single definition, the others rewrite or split
+        // up the functions themselves
+        const std::pair<bool, std::string_view> kConflictingOptions[] = {
+            {options.m_batch, "--batch"},
+            {options.m_lazy, "--lazy"},
+            {options.m_tiered, "--tiered"},
+            {options.m_memoize, "--memoize"},
+            {options.m_batchEntries, "--batch-entries"},
+            {options.aheadOfTime(), "--emit-obj and --emit-lib"},
+        };
+
+        for (const auto &[given, name] : kConflictingOptions) {
+            if (given) {
+                std::cout << "Error: --hot-swap and " << name << " cannot be combined\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+        }
+    }
+
+    if (options.m_serveSocket.empty() && (options.m_serveThreads > 0 || !options.m_preloadFile.empty())) {
+        std::cout << "Error: --serve-threads and --preload need --serve\n";
+        printUsage(argv[0]);
+        return std::nullopt;
+    }
+
+    if (!options.m_serveSocket.empty()) {
+        // The sessions bring their own programs, item by item, each into a JITDylib of its own
+        const std::pair<bool, std::string_view> kConflictingOptions[] = {
+            {!options.m_inputFile.empty(), "an input file"},
+            {options.m_batch, "--batch"},
+            {options.m_emitIR, "--emit-ir"},
+            {options.m_lazy, "--lazy"},
+            {options.m_jitThreads > 1, "--jit-threads"},
+            {options.m_parseThreads > 1, "--parse-threads"},
+            {options.m_tiered, "--tiered"},
+            {options.m_hotSwap, "--hot-swap"},
+            {!options.m_objectCache.empty(), "--object-cache"},
+            {options.m_memoize, "--memoize"},
+            {options.m_batchEntries, "--batch-entries"},
+            {options.m_debugPasses, "--debug-passes"},
+            {options.m_passProfile, "--pass-profile"},
+            {options.aheadOfTime(), "--emit-obj and --emit-lib"},
+        };
+
+        for (const auto &[given, name] : kConflictingOptions) {
+            if (given) {
+                std::cout << "Error: --serve and " << name << " cannot be combined\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+        }
+    }
+
+    if (options.m_engine == Engine::Interp) {
+        const std::pair<bool, std::string_view> kCompilerOptions[] = {
+            {options.m_emitIR, "--emit-ir"},
+            {isModuleLevel(options.m_optLevel), "-O0 to -O3"},
+            {options.m_lazy, "--lazy"},
+            {options.m_jitThreads > 1, "--jit-threads"},
+            {options.m_parseThreads > 1, "--parse-threads"},
+            {options.m_tiered, "--tiered"},
+            {options.m_hotSwap, "--hot-swap"},
+            {!options.m_serveSocket.empty(), "--serve"},
+            {!options.m_objectCache.empty(), "--object-cache"},
+            {options.aheadOfTime(), "--emit-obj and --emit-lib"},
+            {options.m_memoize, "--memoize"},
+            {options.m_batchEntries, "--batch-entries"},
+            {options.m_debugPasses, "--debug-passes"},
+            {options.m_passProfile, "--pass-profile"},
+        };
+
+        for (const auto &[given, name] : kCompilerOptions) {
+            if (given) {
+                std::cout << "Error: --engine=interp compiles nothing, " << name << " cannot be combined with it\n";
+                printUsage(argv[0]);
+                return std::nullopt;
+            }
+        }
+    }
+
+    return options;
+}
+
+void Options::printUsage(const char *programName) {
+    std::cout << "Usage: " << programName << " [options] [file.ks]\n"
+              << "Reads the program from file.ks, or from stdin if no file is given.\n\n"
+              << "Options:\n"
+              << "  --batch    compile the whole program into one module and JIT it once, then run the top-level\n"
+              << "             expressions in order and print only their results\n"
+              << "  --emit-ir  print the generated IR(batch mode)\n"
+              << "  -Ofunction optimize every function on its own as soon as it is generated(default)\n"
+              << "  -O0, -O1, -O2, -O3\n"
+              << "             run LLVM's default pipeline of that level over every module before it is compiled:\n"
+              << "             inlining from -O1, vectorization from -O2. The printed IR is not optimized\n"
+              << "  --engine=jit|interp\n"
+              << "             run the program on LLVM's JIT(default), or on a bytecode interpreter that starts\n"
+              << "             right away. The interpreter prints no IR and takes none of the JIT or\n"
+              << "             ahead-of-time compilation options\n"
+              << "  --lazy     optimize and compile every function on its first call; the printed IR is not optimized\n"
+              << "  --jit-threads=N\n"
+              << "             compile on N worker threads(default 1: on the main thread). The program goes to the\n"
+              << "             JIT in modules of 64 top-level items(definitions, externs, batch expressions) each,\n"
+              << "             the modules needed at the same time(in batch mode the whole program) are compiled in\n"
+              << "             parallel\n"
+              << "  --parse-threads=N\n"
+              << "             batch mode: split the program at top-level items and lex, parse and generate code\n"
+              << "             for the pieces on N threads(default 1: on the main thread), a module each\n"
+              << "  --tiered   compile every function without optimizations first and recompile it with full\n"
+              << "             optimization in the background once it gets hot; not with --lazy\n"
+              << "  --tier-threshold=N\n"
+              << "             calls after which a function counts as hot(default 1000)\n"
+              << "  --hot-swap allow a function to be defined again(same number of arguments): only the new body is\n"
+              << "             compiled and every caller calls it from then on. Not with --batch, --lazy, --tiered,\n"
+              << "             --memoize or --batch-entries\n"
+              << "  --serve=PATH\n"
+              << "             run nothing, serve sessions on a Unix domain socket at PATH instead: every\n"
+              << "             connection is a REPL of its own, a request is a line of items and the answer a\n"
+              << "             line, \"ok\" and the values of its top-level expressions or \"error\" and the reason\n"
+              << "  --serve-threads=N\n"
+              << "             compile and run the requests of all the sessions on N worker threads(default: one\n"
+              << "             per core)\n"
+              << "  --preload=FILE.ks\n"
+              << "             compile the functions of FILE.ks once, when the server starts; every session can\n"
+              << "             call them\n"
+              << "  --object-cache=DIR\n"
+              << "             keep compiled objects in DIR and load unchanged modules from there instead of\n"
+              << "             compiling them again\n"
+              << "  --object-cache-size=MB\n"
+              << "             size cap of the object cache(default 256), least recently used objects go first\n"
+              << "  --cache-stats\n"
+              << "             print the hits and misses of the object cache at exit\n"
+              << "  --memoize  cache the results of every function that calls no extern, however indirectly: each\n"
+              << "             set of arguments is computed once; not with --tiered\n"
+              << "  --memo-entries=N\n"
+              << "             results cached per function(default 65536), a full cache replaces old ones\n"
+              << "  --memo-stats\n"
+              << "             print the hits and misses of every memoized function at exit\n"
+              << "  --batch-entries\n"
+              << "             generate `void f_batch(const double *a, ..., double *out, size_t n)` next to every\n"
+              << "             function `f(a, ...)`: out[i] = f(a[i], ...) for i < n, vectorized for the host's SIMD\n"
+              << "             width. For C callers(see --emit-lib), Kaleidoscope code cannot call them\n"
+              << "  --debug-passes\n"
+              << "             print every optimization pass as it runs\n"
+              << "  --pass-profile\n"
+              << "             time every optimization pass and count the IR instructions it adds or removes, and\n"
+              << "             print the totals per pass and the functions slowest to optimize at exit\n"
+              << "  --trace=FILE.json\n"
+              << "             time parsing, codegen, optimization, the JIT and execution, and write the spans and\n"
+              << "             counters to FILE.json as trace events(chrome://tracing, ui.perfetto.dev)\n"
+              << "  --trace-summary\n"
+              << "             print the total time of every phase and the counters(tokens, AST nodes, IR\n"
+              << "             instructions before/after optimization, machine code bytes, JIT lookups) at exit\n\n"
+              << "Ahead-of-time compilation(nothing is run, top-level expressions are skipped):\n"
+              << "  --emit-obj=FILE.o, --emit-lib=FILE.a\n"
+              << "             compile the whole program into an object file or a static library of C functions\n"
+              << "             `double name(double, ...)`, at the level of -O(-O2 codegen for -Ofunction)\n"
+              << "  --emit-header=FILE.h\n"
+              << "             where to declare the functions(default: next to the output, with a .h extension)\n"
+              << "  --mtriple=TRIPLE, --mcpu=CPU\n"
+              << "             compile for that target/CPU instead of the host\n";
+}
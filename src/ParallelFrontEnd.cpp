@@ -0,0 +1,259 @@
+#include "ParallelFrontEnd.hpp"
+
+#include "CharScanner.hpp"
+#include "Lexer.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Where the first top-level item at or after `from` begins: at a 'def' or 'extern' keyword, or right after a ';'.
+// `from` is the beginning of a line, so neither inside a token nor inside a comment. program.size() if there is none.
+std::size_t findItemStart(std::string_view program, std::size_t from, const scan::Kernels &kernels) {
+    const char *const begin = program.data();
+    const char *const end = begin + program.size();
+
+    for (const char *cur = begin + from; (cur = kernels.m_skipSpaces(cur, end)) != end;) {
+        const char c = *cur;
+
+        // Numbers need no scanning of their own: no identifier starts inside one
+        if (scan::isIdentifierStart(c)) {
+            const char *const identifierEnd = kernels.m_skipIdentifier(cur, end);
+            const std::string_view identifier{cur, static_cast<std::size_t>(identifierEnd - cur)};
+            if (identifier == "def" || identifier == "extern") {
+                return cur - begin;
+            }
+            cur = identifierEnd;
+        } else if (c == '#') {
+            cur = kernels.m_skipToLineEnd(cur, end);
+        } else {
+            ++cur;
+            if (c == ';') {
+                return cur - begin;
+            }
+        }
+    }
+    return program.size();
+}
+
+// Whether codegen finds everything the body of `func` refers to: its arguments, itself and the functions of `table`,
+// called with as many arguments as they take
+bool resolves(const FunctionAST &func, const ExportedFunctions &table) {
+    const PrototypeAST &prototype = func.m_prototype;
+    const std::vector<Symbol> &params = prototype.getArgs();
+    const ExprPool &body = func.m_body;
+
+    for (ExprId id = 0; id < body.size(); ++id) {
+        if (body.kind(id) == ExprKind::Variable) {
+            if (std::find(params.begin(), params.end(), body.symbol(id)) == params.end()) {
+                return false;
+            }
+        } else if (body.kind(id) == ExprKind::Call) {
+            const std::size_t arity = body.args(id).size();
+            if (body.symbol(id) == prototype.getName()) {
+                if (arity != params.size()) {
+                    return false;
+                }
+                continue;
+            }
+
+            const auto it = table.find(body.symbol(id));
+            if (it == table.end() || it->second.m_batchEntry || it->second.m_arity != arity) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Runs work(i) for every i < count, each on a thread of its own(the first one on the calling thread)
+template <typename Work>
+void forEachPiece(std::size_t count, const Work &work) {
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (std::size_t i = 1; i < count; ++i) {
+        threads.emplace_back(work, i);
+    }
+
+    if (count > 0) {
+        work(0);
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+ParallelFrontEnd::ParallelFrontEnd(ConstantFolder &folder, std::string_view expressionPrefix)
+    : m_folder(folder)
+    , m_expressionPrefix(expressionPrefix) {
+}
+
+std::vector<std::string_view> ParallelFrontEnd::split(std::string_view program, std::size_t pieces) {
+    trace::Scope scope{"split"};
+
+    pieces = std::clamp<std::size_t>(program.size() / kMinPieceBytes, 1, std::max<std::size_t>(pieces, 1));
+    const scan::Kernels &kernels = scan::kernels();
+
+    std::vector<std::string_view> result;
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i < pieces; ++i) {
+        // The first line that starts past an even share of the program
+        std::size_t from = std::max(begin, program.size() / pieces * i);
+        if (from > 0 && program[from - 1] != '\n') {
+            from = program.find('\n', from);
+            if (from == std::string_view::npos) {
+                break;
+            }
+            ++from;
+        }
+
+        const std::size_t end = findItemStart(program, from, kernels);
+        if (end == program.size()) {
+            break;
+        }
+        if (end > begin) {
+            result.push_back(program.substr(begin, end - begin));
+            begin = end;
+        }
+    }
+    result.push_back(program.substr(begin));
+
+    return result;
+}
+
+int ParallelFrontEnd::compile(std::string_view program, std::span<const std::unique_ptr<LLVMContextData>> contexts,
+                              std::vector<TopLevelExpression> &expressions) {
+    const std::vector<std::string_view> pieces = split(program, contexts.size());
+
+    std::vector<std::vector<Item>> items(pieces.size());
+    forEachPiece(pieces.size(), [&](std::size_t i) { items[i] = parse(pieces[i]); });
+
+    // Every piece sees the functions of the modules handed over before and those of the pieces before it, in a table
+    // of its own that is only read while generating
+    const std::shared_ptr<ExportedFunctions> exportedFunctions = contexts.front()->m_exportedFunctions;
+    ExportedFunctions declared = *exportedFunctions;
+    std::vector<std::shared_ptr<ExportedFunctions>> tables;
+
+    std::size_t expressionIndex = expressions.size();
+    for (std::vector<Item> &pieceItems : items) {
+        tables.push_back(std::make_shared<ExportedFunctions>(declared));
+        merge(pieceItems, declared, expressionIndex);
+    }
+
+    forEachPiece(pieces.size(), [&](std::size_t i) {
+        LLVMContextData &ctxData = *contexts[i];
+        ctxData.m_exportedFunctions = tables[i];
+        generate(items[i], ctxData);
+        ctxData.m_exportedFunctions = exportedFunctions;
+    });
+
+    int errors = 0;
+    for (std::vector<Item> &pieceItems : items) {
+        for (Item &item : pieceItems) {
+            for (const std::string &message : item.m_messages) {
+                std::cout << "Error: " << message << '\n';
+            }
+
+            if (!item.m_compiled) {
+                ++errors;
+            } else if (item.m_kind == Parser::TopLevel::Expression) {
+                expressions.push_back({item.m_function->m_prototype.getName(), item.m_value});
+            }
+        }
+    }
+
+    return errors;
+}
+
+std::vector<ParallelFrontEnd::Item> ParallelFrontEnd::parse(std::string_view piece) {
+    const Symbol placeholder = Symbol::intern("");
+
+    Lexer lexer{std::make_unique<StringSource>(piece)};
+    Parser parser{lexer};
+    parser.start();
+
+    std::vector<Item> items;
+    for (auto kind = parser.peekTopLevel(); kind != Parser::TopLevel::EndOfInput; kind = parser.peekTopLevel()) {
+        if (kind == Parser::TopLevel::Separator) {
+            parser.skipSeparator();
+            continue;
+        }
+
+        Item &item = items.emplace_back();
+        item.m_kind = kind;
+
+        utils::ScopedErrorCapture capture{item.m_messages};
+        if (kind == Parser::TopLevel::Extern) {
+            item.m_prototype = parser.parseExtern();
+        } else if (kind == Parser::TopLevel::Definition) {
+            item.m_function = parser.parseDefinition();
+        } else {
+            // Named once it is known not to fold
+            item.m_function = parser.parseTopLevelExpr(placeholder);
+        }
+    }
+    return items;
+}
+
+void ParallelFrontEnd::merge(std::vector<Item> &items, ExportedFunctions &table, std::size_t &expressionIndex) {
+    for (Item &item : items) {
+        switch (item.m_kind) {
+            case Parser::TopLevel::Definition: {
+                if (!item.m_function) {
+                    break;
+                }
+
+                // A definition the codegen of its piece rejects(a redefinition, another number of arguments, a name
+                // it cannot find) is neither declared nor folded, as if it had failed to compile in one piece
+                const PrototypeAST &prototype = item.m_function->m_prototype;
+                const auto it = table.find(prototype.getName());
+                const bool declarable = it == table.end() || (!it->second.m_defined && !it->second.m_batchEntry &&
+                                                              it->second.m_arity == prototype.getArgs().size());
+                if (declarable && resolves(*item.m_function, table)) {
+                    table[prototype.getName()] = ExportedFunction{prototype.getArgs().size(), true, false, false};
+                    m_folder.define(*item.m_function);
+                }
+                break;
+            }
+            case Parser::TopLevel::Extern:
+                if (item.m_prototype) {
+                    table.try_emplace(item.m_prototype->getName(),
+                                      ExportedFunction{item.m_prototype->getArgs().size(), false, false, false});
+                }
+                break;
+            case Parser::TopLevel::Expression:
+                if (!item.m_function) {
+                    break;
+                }
+
+                item.m_value = m_folder.evaluate(item.m_function->m_body);
+                if (!item.m_value) {
+                    item.m_function->m_prototype = PrototypeAST{
+                        Symbol::intern(m_expressionPrefix + std::to_string(expressionIndex++)), {}};
+                }
+                break;
+            case Parser::TopLevel::EndOfInput:
+            case Parser::TopLevel::Separator:
+                break;
+        }
+    }
+}
+
+void ParallelFrontEnd::generate(std::vector<Item> &items, LLVMContextData &ctxData) {
+    for (Item &item : items) {
+        utils::ScopedErrorCapture capture{item.m_messages};
+
+        if (item.m_prototype) {
+            item.m_compiled = item.m_prototype->codegen(ctxData);
+        } else if (item.m_function) {
+            item.m_compiled = item.m_value || item.m_function->codegen(ctxData);
+        }
+    }
+}
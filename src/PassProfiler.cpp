@@ -0,0 +1,189 @@
+#include "PassProfiler.hpp"
+
+#include "llvm/ADT/Any.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t kReportedFunctions = 10;
+
+// A pass that started and has not finished yet, on this thread
+struct Run {
+    Clock::time_point m_begin;
+    std::chrono::nanoseconds m_nested;  // of the profiled passes it ran itself
+    std::int64_t m_instructions;
+    std::string m_function;
+};
+
+// Pipelines run on one thread at a time, the passes running on a thread nest
+thread_local std::vector<Run> t_runs;
+
+// Pass managers, adaptors and the like: the passes they run are profiled instead
+bool isContainer(llvm::StringRef pass) {
+    constexpr llvm::StringLiteral kContainers[] = {"PassManager", "PassAdaptor", "AnalysisManagerProxy",
+                                                   "DevirtSCCRepeatedPass", "ModuleInlinerWrapperPass"};
+    return std::any_of(std::begin(kContainers), std::end(kContainers),
+                       [pass](llvm::StringRef container) { return pass.contains(container); });
+}
+
+std::int64_t instructionCount(const llvm::Any &ir) {
+    if (const auto *func = llvm::any_cast<const llvm::Function *>(&ir); func) {
+        return (*func)->getInstructionCount();
+    }
+    if (const auto *module = llvm::any_cast<const llvm::Module *>(&ir); module) {
+        return (*module)->getInstructionCount();
+    }
+    if (const auto *scc = llvm::any_cast<const llvm::LazyCallGraph::SCC *>(&ir); scc) {
+        std::int64_t count = 0;
+        for (const llvm::LazyCallGraph::Node &node : **scc) {
+            count += node.getFunction().getInstructionCount();
+        }
+        return count;
+    }
+    if (const auto *loop = llvm::any_cast<const llvm::Loop *>(&ir); loop) {
+        std::int64_t count = 0;
+        for (const llvm::BasicBlock *block : (*loop)->blocks()) {
+            count += block->size();
+        }
+        return count;
+    }
+    return 0;
+}
+
+// The function `ir` belongs to, empty for modules and call graph SCCs of several functions
+std::string functionName(const llvm::Any &ir) {
+    if (const auto *func = llvm::any_cast<const llvm::Function *>(&ir); func) {
+        return (*func)->getName().str();
+    }
+    if (const auto *loop = llvm::any_cast<const llvm::Loop *>(&ir); loop) {
+        return (*loop)->getHeader()->getParent()->getName().str();
+    }
+    if (const auto *scc = llvm::any_cast<const llvm::LazyCallGraph::SCC *>(&ir); scc && (*scc)->size() == 1) {
+        return (*scc)->begin()->getFunction().getName().str();
+    }
+    return {};
+}
+
+}  // namespace
+
+void PassProfiler::registerCallbacks(llvm::PassInstrumentationCallbacks &callbacks) {
+    callbacks.registerBeforeNonSkippedPassCallback([](llvm::StringRef pass, llvm::Any ir) {
+        if (!isContainer(pass)) {
+            t_runs.push_back({Clock::now(), {}, instructionCount(ir), functionName(ir)});
+        }
+    });
+
+    // Takes the innermost run off the stack, the parent run does not count its time as its own
+    const auto finish = [](std::int64_t instructions) {
+        Run run = std::move(t_runs.back());
+        t_runs.pop_back();
+
+        const auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - run.m_begin);
+        if (!t_runs.empty()) {
+            t_runs.back().m_nested += time;
+        }
+        return std::make_tuple(std::move(run.m_function), time - run.m_nested, instructions - run.m_instructions);
+    };
+
+    callbacks.registerAfterPassCallback(
+        [this, finish](llvm::StringRef pass, llvm::Any ir, const llvm::PreservedAnalyses &) {
+            if (!isContainer(pass)) {
+                const auto [function, time, delta] = finish(instructionCount(ir));
+                record(pass, function, time, delta);
+            }
+        });
+
+    // The IR is gone(a deleted loop, a merged SCC), so is whatever the pass did to it
+    callbacks.registerAfterPassInvalidatedCallback(
+        [this, finish](llvm::StringRef pass, const llvm::PreservedAnalyses &) {
+            if (!isContainer(pass)) {
+                const std::int64_t before = t_runs.back().m_instructions;
+                const auto [function, time, delta] = finish(before);
+                record(pass, function, time, delta);
+            }
+        });
+}
+
+void PassProfiler::record(llvm::StringRef pass, const std::string &function, std::chrono::nanoseconds time,
+                          std::int64_t instructionDelta) {
+    std::lock_guard lock{m_mutex};
+
+    for (Totals *totals : {&m_passes[pass.str()], function.empty() ? nullptr : &m_functions[function]}) {
+        if (totals) {
+            ++totals->m_runs;
+            totals->m_time += time;
+            totals->m_instructionDelta += instructionDelta;
+        }
+    }
+}
+
+void PassProfiler::printReport() const {
+    std::lock_guard lock{m_mutex};
+
+    using Row = std::pair<std::string, Totals>;
+    const auto slowestFirst = [](const Row &lhs, const Row &rhs) { return lhs.second.m_time > rhs.second.m_time; };
+
+    std::vector<Row> passes(m_passes.begin(), m_passes.end());
+    std::sort(passes.begin(), passes.end(), slowestFirst);
+
+    std::vector<Row> functions(m_functions.begin(), m_functions.end());
+    const std::size_t reported = std::min(functions.size(), kReportedFunctions);
+    std::partial_sort(functions.begin(), functions.begin() + reported, functions.end(), slowestFirst);
+    functions.resize(reported);
+
+    std::chrono::nanoseconds total{};
+    std::uint64_t runs = 0;
+    for (const auto &[name, totals] : passes) {
+        total += totals.m_time;
+        runs += totals.m_runs;
+    }
+
+    const auto milliseconds = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration<double, std::milli>(time).count();
+    };
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3) << "Pass profile: " << runs << " pass runs, " << milliseconds(total)
+           << " ms\n";
+
+    // Wide enough for the longest name, template passes have long ones
+    const auto nameWidth = [](const char *title, const std::vector<Row> &rows) {
+        std::size_t width = std::string_view{title}.size();
+        for (const auto &[name, totals] : rows) {
+            width = std::max(width, name.size());
+        }
+        return static_cast<int>(width + 2);
+    };
+
+    const auto printTable = [&](const char *title, const std::vector<Row> &rows) {
+        const int width = nameWidth(title, rows);
+        report << std::left << std::setw(width) << title << std::right << std::setw(10) << "runs" << std::setw(12)
+               << "total ms" << std::setw(9) << "share" << std::setw(12) << "IR delta\n";
+        for (const auto &[name, totals] : rows) {
+            const double share = total.count() ? 100.0 * totals.m_time.count() / total.count() : 0.0;
+            report << std::left << std::setw(width) << name << std::right << std::setw(10) << totals.m_runs
+                   << std::setw(12) << milliseconds(totals.m_time) << std::setw(8) << std::setprecision(1) << share
+                   << '%' << std::setprecision(3) << std::setw(11) << std::showpos << totals.m_instructionDelta
+                   << std::noshowpos << '\n';
+        }
+    };
+
+    printTable("Pass", passes);
+    report << '\n';
+    printTable("Function(slowest to optimize)", functions);
+
+    std::cout << report.str() << std::flush;
+}
@@ -0,0 +1,499 @@
+#include "Server.hpp"
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
+
+#include "llvm/Support/TargetSelect.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Shortest text that reads back as `value`
+std::string formatValue(double value) {
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+// Writes all of `data`, gives up once the client is gone
+void sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+}
+
+// Whether `address` is a socket file nobody listens at, left behind by a server that is gone
+bool isStaleSocket(const sockaddr_un &address) {
+    struct stat status;
+    if (::stat(address.sun_path, &status) != 0 || !S_ISSOCK(status.st_mode)) {
+        return false;
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    const bool listening = ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+    ::close(fd);
+    return !listening;
+}
+
+}  // namespace
+
+Server::Session::Session(Server &server, int fd, std::uint64_t id)
+    : m_server(server)
+    , m_fd(fd)
+    , m_id(id) {
+}
+
+Server::Session::~Session() {
+    if (m_dylib) {
+        if (auto error = m_server.m_JIT->removeClientJITDylib(*m_dylib)) {
+            std::cout << "Error: " << llvm::toString(std::move(error)) << '\n';
+        }
+    }
+    ::close(m_fd);
+}
+
+std::unique_ptr<Server> Server::open(const std::string &socketPath, unsigned threads, OptLevel optLevel,
+                                     std::string_view library) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmParser();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    // Requests are compiled on the workers that run them
+    auto jit = llvm::orc::KaleidoscopeJIT::Create();
+    if (!jit) {
+        std::cout << "Error: " << llvm::toString(jit.takeError()) << '\n';
+        return nullptr;
+    }
+
+    std::unique_ptr<Server> server{new Server(std::move(*jit), optLevel, threads)};
+    if (!server->preload(library) || !server->listen(socketPath)) {
+        return nullptr;
+    }
+    return server;
+}
+
+Server::Server(std::unique_ptr<llvm::orc::KaleidoscopeJIT> jit, OptLevel optLevel, unsigned threads)
+    : m_JIT(std::move(jit))
+    , m_optLevel(optLevel)
+    , m_threads(std::max(threads, 1u)) {
+}
+
+Server::~Server() {
+    if (m_listenFd >= 0) {
+        ::close(m_listenFd);
+    }
+    if (!m_socketPath.empty()) {
+        ::unlink(m_socketPath.c_str());
+    }
+    for (const int fd : m_wakeFds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool Server::preload(std::string_view library) {
+    LLVMContextData ctxData{std::make_shared<ExportedFunctions>(), m_optLevel};
+    ctxData.startModule("Kaleidoscope library", m_JIT->getDataLayout());
+
+    Lexer lexer{std::make_unique<StringSource>(library)};
+    Parser parser{lexer};
+    parser.start();
+
+    std::vector<std::string> definitions;
+    for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+        switch (item) {
+            case Parser::TopLevel::Definition: {
+                const auto func = parser.parseDefinition();
+                if (!func || !func->codegen(ctxData)) {
+                    return false;
+                }
+
+                m_libraryFolder.define(*func);
+                definitions.emplace_back(func->m_prototype.getName().str());
+                parser.recycle(*func);
+                break;
+            }
+            case Parser::TopLevel::Extern: {
+                const auto externProto = parser.parseExtern();
+                if (!externProto || !externProto->codegen(ctxData)) {
+                    return false;
+                }
+                break;
+            }
+            case Parser::TopLevel::Separator:
+                parser.skipSeparator();
+                break;
+            case Parser::TopLevel::Expression:
+                utils::logError("the preloaded library can only define functions and declare externs");
+                return false;
+            case Parser::TopLevel::EndOfInput:
+                break;
+        }
+    }
+
+    if (isModuleLevel(m_optLevel)) {
+        ctxData.m_llvmOpt.optimize(*ctxData.m_llvmModule);
+    }
+
+    ctxData.exportFunctions();
+    m_libraryFunctions = *ctxData.m_exportedFunctions;
+
+    // Compiled now rather than by the first session that calls into it. An extern nowhere to be found fails here.
+    llvm::Error error = m_JIT->addModule(ctxData.takeModule());
+    if (!error && !definitions.empty()) {
+        error = m_JIT->materialize(definitions);
+    }
+    if (error) {
+        std::cout << "Error: " << llvm::toString(std::move(error)) << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool Server::listen(const std::string &socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cout << "Error: the socket path '" << socketPath << "' is too long\n";
+        return false;
+    }
+    socketPath.copy(address.sun_path, socketPath.size());
+
+    if (isStaleSocket(address)) {
+        ::unlink(address.sun_path);
+    }
+
+    if (::pipe2(m_wakeFds, O_CLOEXEC) != 0 || (m_listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        std::cout << "Error: cannot listen at '" << socketPath << "': " << std::strerror(errno) << '\n';
+        return false;
+    }
+
+    // Only the owner may connect, bind() creates the socket file through the umask
+    const mode_t mask = ::umask(0077);
+    const bool bound = ::bind(m_listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+    ::umask(mask);
+
+    if (!bound) {
+        std::cout << "Error: cannot listen at '" << socketPath << "': " << std::strerror(errno) << '\n';
+        return false;
+    }
+    m_socketPath = socketPath;
+
+    if (::listen(m_listenFd, SOMAXCONN) != 0) {
+        std::cout << "Error: cannot listen at '" << socketPath << "': " << std::strerror(errno) << '\n';
+        return false;
+    }
+    return true;
+}
+
+void Server::run() {
+    for (unsigned i = 0; i < m_threads; ++i) {
+        m_workers.emplace_back(&Server::work, this);
+    }
+
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        fds.push_back({m_wakeFds[0], POLLIN, 0});
+        fds.push_back({m_listenFd, POLLIN, 0});
+        for (const auto &[fd, session] : m_sessions) {
+            fds.push_back({fd, POLLIN, 0});
+        }
+
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cout << "Error: cannot wait for the clients: " << std::strerror(errno) << '\n';
+            break;
+        }
+
+        if (fds[0].revents != 0) {
+            break;
+        }
+
+        for (auto fd = fds.begin() + 2; fd != fds.end(); ++fd) {
+            if (fd->revents == 0) {
+                continue;
+            }
+
+            const auto session = m_sessions.find(fd->fd);
+            if (!receive(session->second)) {
+                // Its requests not started yet are dropped, the worker running one(if any) frees it afterwards
+                {
+                    std::lock_guard lock{m_mutex};
+                    session->second->m_requests.clear();
+                }
+                m_sessions.erase(session);
+            }
+        }
+
+        if (fds[1].revents != 0) {
+            if (const int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC); fd >= 0) {
+                m_sessions.emplace(fd, std::make_shared<Session>(*this, fd, m_sessionIds++));
+            } else if (errno != EINTR && errno != ECONNABORTED) {
+                std::cout << "Error: cannot accept a client: " << std::strerror(errno) << '\n';
+            }
+        }
+    }
+
+    // The sessions waiting for a worker are freed here rather than under the lock
+    std::deque<std::shared_ptr<Session>> waiting;
+    {
+        std::lock_guard lock{m_mutex};
+        m_stopping = true;
+        waiting.swap(m_runQueue);
+    }
+    m_work.notify_all();
+
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    m_sessions.clear();
+}
+
+void Server::stop() {
+    const char byte = 0;
+    [[maybe_unused]] const ssize_t written = ::write(m_wakeFds[1], &byte, 1);
+}
+
+bool Server::receive(const std::shared_ptr<Session> &session) {
+    char buffer[16 * 1024];
+    const ssize_t bytesRead = ::read(session->m_fd, buffer, sizeof(buffer));
+    if (bytesRead < 0 && errno == EINTR) {
+        return true;
+    }
+    if (bytesRead <= 0) {
+        return false;
+    }
+
+    std::string &input = session->m_input;
+    input.append(buffer, static_cast<std::size_t>(bytesRead));
+
+    std::vector<std::string> lines;
+    std::size_t begin = 0;
+    for (std::size_t end; (end = input.find('\n', begin)) != std::string::npos; begin = end + 1) {
+        lines.emplace_back(input, begin, end - begin);
+    }
+    input.erase(0, begin);
+
+    if (input.size() > kMaxRequestBytes) {
+        return false;
+    }
+    if (lines.empty()) {
+        return true;
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard lock{m_mutex};
+        std::move(lines.begin(), lines.end(), std::back_inserter(session->m_requests));
+        if (!std::exchange(session->m_scheduled, true)) {
+            m_runQueue.push_back(session);
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        m_work.notify_one();
+    }
+    return true;
+}
+
+void Server::work() {
+    while (true) {
+        // Released after the lock, the last reference to a session frees its code
+        std::shared_ptr<Session> session;
+        std::string request;
+        {
+            std::unique_lock lock{m_mutex};
+            m_work.wait(lock, [this] { return m_stopping || !m_runQueue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+
+            session = std::move(m_runQueue.front());
+            m_runQueue.pop_front();
+
+            // The client disconnected before its turn
+            if (session->m_requests.empty()) {
+                session->m_scheduled = false;
+                continue;
+            }
+
+            request = std::move(session->m_requests.front());
+            session->m_requests.pop_front();
+        }
+
+        sendAll(session->m_fd, evaluate(*session, request));
+        m_requests.fetch_add(1, std::memory_order_relaxed);
+
+        // One request at a time, a busy session goes back to the end of the queue behind the others
+        std::lock_guard lock{m_mutex};
+        if (session->m_requests.empty()) {
+            session->m_scheduled = false;
+        } else {
+            m_runQueue.push_back(std::move(session));
+        }
+    }
+}
+
+std::string Server::evaluate(Session &session, std::string_view request) {
+    trace::Scope scope{"request"};
+
+    // The parser and codegen report through utils::logError(), into `messages` from here on
+    std::vector<std::string> messages;
+    utils::ScopedErrorCapture capture{messages};
+
+    std::string values;
+    if (session.m_ctxData || startSession(session, messages)) {
+        Lexer lexer{std::make_unique<StringSource>(request)};
+        Parser parser{lexer};
+        parser.start();
+
+        for (auto item = parser.peekTopLevel(); item != Parser::TopLevel::EndOfInput; item = parser.peekTopLevel()) {
+            switch (item) {
+                case Parser::TopLevel::Definition:
+                    if (const auto func = parser.parseDefinition(); func) {
+                        if (func->codegen(*session.m_ctxData)) {
+                            session.m_folder.define(*func);
+                            session.m_pendingItems = true;
+                        }
+                        parser.recycle(*func);
+                    }
+                    break;
+                case Parser::TopLevel::Extern:
+                    if (const auto externProto = parser.parseExtern(); externProto) {
+                        session.m_pendingItems = externProto->codegen(*session.m_ctxData) || session.m_pendingItems;
+                    }
+                    break;
+                case Parser::TopLevel::Separator:
+                    parser.skipSeparator();
+                    break;
+                case Parser::TopLevel::Expression:
+                    if (const auto func = parser.parseTopLevelExpr(Symbol::intern(kAnonExprIdentifier)); func) {
+                        std::optional<double> value = session.m_folder.evaluate(func->m_body);
+                        if (!value) {
+                            // The definitions go to the JIT for good in a module of their own, as in the REPL
+                            if (session.m_pendingItems) {
+                                handOverDefinitions(session, messages);
+                            }
+                            if (func->codegen(*session.m_ctxData)) {
+                                value = runExpression(session, messages);
+                            }
+                        }
+
+                        if (value) {
+                            values += ' ' + formatValue(*value);
+                        }
+                        parser.recycle(*func);
+                    }
+                    break;
+                case Parser::TopLevel::EndOfInput:
+                    break;
+            }
+        }
+    }
+
+    if (messages.empty()) {
+        return "ok" + values + '\n';
+    }
+
+    // One line, whatever the messages hold
+    std::string answer = "error";
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        std::replace(messages[i].begin(), messages[i].end(), '\n', ' ');
+        answer += (i == 0 ? " " : "; ") + messages[i];
+    }
+    return answer + '\n';
+}
+
+bool Server::startSession(Session &session, std::vector<std::string> &messages) {
+    auto dylib = m_JIT->createClientJITDylib("session." + std::to_string(session.m_id));
+    if (!dylib) {
+        messages.push_back(llvm::toString(dylib.takeError()));
+        return false;
+    }
+    session.m_dylib = &*dylib;
+
+    // Declares the functions of the library, whose names it cannot define again
+    session.m_ctxData =
+        std::make_unique<LLVMContextData>(std::make_shared<ExportedFunctions>(m_libraryFunctions), m_optLevel);
+    session.m_ctxData->startModule(kModuleName, m_JIT->getDataLayout());
+    session.m_folder = m_libraryFolder;
+    return true;
+}
+
+std::optional<double> Server::runExpression(Session &session, std::vector<std::string> &messages) {
+    LLVMContextData &ctxData = *session.m_ctxData;
+    if (isModuleLevel(m_optLevel)) {
+        ctxData.m_llvmOpt.optimize(*ctxData.m_llvmModule);
+    }
+
+    // Removed once it ran, unlike the definitions of the session
+    const auto tracker = session.m_dylib->createResourceTracker();
+    llvm::Error error = m_JIT->addEagerModule(ctxData.takeModule(), tracker);
+    ctxData.startModule(kModuleName, m_JIT->getDataLayout());
+    if (error) {
+        messages.push_back(llvm::toString(std::move(error)));
+        return std::nullopt;
+    }
+
+    std::optional<double> value;
+    if (auto exprSymbol = m_JIT->lookup(*session.m_dylib, kAnonExprIdentifier); exprSymbol) {
+        double (*nativeAnonFunc)() = exprSymbol->getAddress().toPtr<double (*)()>();
+        trace::Scope scope{"execute"};
+        value = nativeAnonFunc();
+    } else {
+        messages.push_back(llvm::toString(exprSymbol.takeError()));
+    }
+
+    if (auto removeError = tracker->remove()) {
+        messages.push_back(llvm::toString(std::move(removeError)));
+    }
+    return value;
+}
+
+void Server::handOverDefinitions(Session &session, std::vector<std::string> &messages) {
+    LLVMContextData &ctxData = *session.m_ctxData;
+    if (isModuleLevel(m_optLevel)) {
+        ctxData.m_llvmOpt.optimize(*ctxData.m_llvmModule);
+    }
+
+    // Exported only if the JIT takes the module, so that later requests cannot call functions that are not there
+    const std::vector<Symbol> names = ctxData.functionNames();
+    ExportedFunctions replaced = ctxData.exportFunctions();
+    if (auto error = m_JIT->addModule(ctxData.takeModule(), session.m_dylib->getDefaultResourceTracker())) {
+        ctxData.withdrawExports(names, std::move(replaced));
+        messages.push_back(llvm::toString(std::move(error)));
+    }
+    ctxData.startModule(kModuleName, m_JIT->getDataLayout());
+    session.m_pendingItems = false;
+}
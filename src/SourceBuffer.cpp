@@ -0,0 +1,75 @@
+#include "SourceBuffer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+std::string SourceBuffer::readAll() {
+    std::string contents;
+    for (std::string_view chunk = nextChunk(); !chunk.empty(); chunk = nextChunk()) {
+        contents.append(chunk);
+    }
+    return contents;
+}
+
+std::unique_ptr<MappedFileSource> MappedFileSource::open(const char *path) {
+    const auto logError = [path] {
+        std::cout << "Error: cannot read '" << path << "': " << std::strerror(errno) << '\n';
+        return nullptr;
+    };
+
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return logError();
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return logError();
+    }
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+
+    // mmap() rejects empty mappings, an empty file is simply an empty source
+    void *data = nullptr;
+    if (size != 0) {
+        data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    // The mapping keeps the file alive
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        return logError();
+    }
+
+    // The lexer scans the mapping front to back exactly once
+    if (data) {
+        ::madvise(data, size, MADV_SEQUENTIAL);
+    }
+
+    return std::unique_ptr<MappedFileSource>(new MappedFileSource(static_cast<const char *>(data), size));
+}
+
+MappedFileSource::~MappedFileSource() {
+    if (m_data) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+}
+
+std::string_view StreamSource::nextChunk() {
+    ssize_t bytesRead = 0;
+    do {
+        bytesRead = ::read(m_fd, m_buffer.get(), kBlockSize);
+    } while (bytesRead < 0 && errno == EINTR);
+
+    if (bytesRead <= 0) {
+        return {};
+    }
+    return {m_buffer.get(), static_cast<std::size_t>(bytesRead)};
+}
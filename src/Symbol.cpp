@@ -0,0 +1,106 @@
+#include "Symbol.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+// FNV-1a
+std::uint64_t hashName(std::string_view name) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Open-addressing hash set of names. The hash of every entry is kept next to it, so probing only touches the names
+// whose hashes match.
+class SymbolTable {
+    struct Slot {
+        std::uint64_t m_hash;
+        const std::string *m_name;
+    };
+
+    static constexpr std::size_t kInitialCapacity = 1024;
+
+public:
+    SymbolTable()
+        : m_slots(kInitialCapacity, Slot{0, nullptr}) {
+    }
+
+    const std::string *intern(std::uint64_t hash, std::string_view name) {
+        std::lock_guard lock{m_mutex};
+
+        Slot *slot = find(hash, name);
+        if (slot->m_name) {
+            return slot->m_name;
+        }
+
+        // std::deque never relocates its elements, so handed out symbols stay valid
+        const std::string *entry = &m_names.emplace_back(name);
+        *slot = Slot{hash, entry};
+
+        // Keep the load factor at most 1/2
+        if (2 * m_names.size() > m_slots.size()) {
+            grow();
+        }
+
+        return entry;
+    }
+
+private:
+    // Returns the slot holding `name` or the empty slot where it belongs
+    Slot *find(std::uint64_t hash, std::string_view name) {
+        const std::size_t mask = m_slots.size() - 1;
+
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot &slot = m_slots[i];
+            if (!slot.m_name || (slot.m_hash == hash && *slot.m_name == name)) {
+                return &slot;
+            }
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> slots(2 * m_slots.size(), Slot{0, nullptr});
+        m_slots.swap(slots);
+
+        for (const Slot &slot : slots) {
+            if (slot.m_name) {
+                *find(slot.m_hash, *slot.m_name) = slot;
+            }
+        }
+    }
+
+    std::mutex m_mutex;
+    std::deque<std::string> m_names;
+    std::vector<Slot> m_slots;
+};
+
+SymbolTable &symbolTable() {
+    static SymbolTable table;
+    return table;
+}
+
+}  // namespace
+
+Symbol Symbol::intern(std::string_view name) {
+    constexpr std::size_t kCacheSize = 4096;
+
+    const std::uint64_t hash = hashName(name);
+
+    // Direct-mapped per-thread cache in front of the shared table, re-interning a recently seen name takes no lock
+    thread_local std::array<const std::string *, kCacheSize> cache{};
+
+    const std::string *&cached = cache[hash & (kCacheSize - 1)];
+    if (!cached || *cached != name) {
+        cached = symbolTable().intern(hash, name);
+    }
+
+    return Symbol{cached};
+}
@@ -0,0 +1,290 @@
+#include "TieredCompiler.hpp"
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+TieredCompiler::TieredCompiler(llvm::orc::KaleidoscopeJIT &jit, std::uint64_t threshold, PassProfiler *profiler)
+    : m_jit(jit)
+    , m_threshold(threshold)
+    , m_profiler(profiler) {
+    llvm::ExitOnError{}(
+        m_jit.defineHostFunction(kTierUpHook, llvm::orc::ExecutorAddr::fromPtr(&TieredCompiler::tierUpHook)));
+
+    m_background = std::thread(&TieredCompiler::backgroundLoop, this);
+}
+
+TieredCompiler::~TieredCompiler() {
+    {
+        std::lock_guard lock{m_queueMutex};
+        m_stopping = true;
+    }
+    m_queueChanged.notify_one();
+    m_background.join();
+}
+
+llvm::Error TieredCompiler::addModule(llvm::orc::ThreadSafeModule threadSafeModule) {
+    std::vector<std::string> names;
+    std::vector<std::string> tier0Names;
+
+    threadSafeModule.withModuleDo([&](llvm::Module &module) {
+        // Collect first, instrumentFunction() adds declarations to the module
+        std::vector<llvm::Function *> definitions;
+        definitions.reserve(module.size());
+        for (llvm::Function &func : module) {
+            if (!func.isDeclaration()) {
+                definitions.push_back(&func);
+            }
+        }
+
+        // Save all of them before instrumenting any, so that the saved copies call each other by their own names
+        std::vector<std::uint64_t> ids;
+        for (llvm::Function *func : definitions) {
+            names.push_back(func->getName().str());
+            ids.push_back(saveFunction(*func));
+        }
+
+        for (std::size_t i = 0; i < definitions.size(); ++i) {
+            instrumentFunction(*definitions[i], ids[i]);
+            tier0Names.push_back(definitions[i]->getName().str());
+        }
+    });
+
+    if (names.empty()) {
+        return m_jit.addBaselineModule(std::move(threadSafeModule));
+    }
+
+    // The stubs take the names of the functions, the module refers to them through the declarations
+    // instrumentFunction() left behind
+    if (auto error = m_jit.addRedirectableSymbols(names)) {
+        return error;
+    }
+    // Stubs left unredirected would jump to null, so they go if the module fails(a call fails to resolve instead)
+    if (auto error = addTier0(std::move(threadSafeModule), names, tier0Names)) {
+        return llvm::joinErrors(std::move(error), m_jit.removeSymbols(names));
+    }
+
+    return llvm::Error::success();
+}
+
+llvm::Error TieredCompiler::addTier0(llvm::orc::ThreadSafeModule threadSafeModule, const std::vector<std::string> &names,
+                                     const std::vector<std::string> &tier0Names) {
+    if (auto error = m_jit.addBaselineModule(std::move(threadSafeModule))) {
+        return error;
+    }
+    if (auto error = m_jit.materialize(tier0Names)) {
+        return error;
+    }
+
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        auto tier0Symbol = m_jit.lookup(tier0Names[i]);
+        if (!tier0Symbol) {
+            return tier0Symbol.takeError();
+        }
+        if (auto error = m_jit.redirect(names[i], tier0Symbol->getAddress())) {
+            return error;
+        }
+    }
+
+    return llvm::Error::success();
+}
+
+void TieredCompiler::tierUpHook(TieredCompiler *self, std::uint64_t id) {
+    {
+        std::lock_guard lock{self->m_queueMutex};
+        self->m_queue.push_back(id);
+    }
+    self->m_queueChanged.notify_one();
+}
+
+std::uint64_t TieredCompiler::saveFunction(const llvm::Function &func) {
+    // Only `func` keeps its body, the rest of the module stays behind as declarations
+    llvm::ValueToValueMapTy valueMap;
+    const auto copy = llvm::CloneModule(*func.getParent(), valueMap,
+                                        [&func](const llvm::GlobalValue *value) { return value == &func; });
+
+    TieredFunction saved{Symbol::intern(std::string_view{func.getName()}), {}};
+    llvm::raw_svector_ostream stream{saved.m_bitcode};
+    llvm::WriteBitcodeToFile(*copy, stream);
+
+    std::lock_guard lock{m_functionsMutex};
+    const std::uint64_t id = m_functions.size();
+    m_ids.emplace(saved.m_name, id);
+    m_functions.push_back(std::move(saved));
+    return id;
+}
+
+void TieredCompiler::instrumentFunction(llvm::Function &func, std::uint64_t id) {
+    llvm::Module &module = *func.getParent();
+    llvm::LLVMContext &llvmContext = module.getContext();
+    const std::string name = func.getName().str();
+
+    // Every call, the recursive ones included, goes through the stub from now on
+    func.setName(name + kTier0Suffix);
+    llvm::Function *const stub =
+        llvm::Function::Create(func.getFunctionType(), llvm::Function::ExternalLinkage, name, module);
+    func.replaceAllUsesWith(stub);
+
+    llvm::Type *const int64Type = llvm::Type::getInt64Ty(llvmContext);
+    llvm::Type *const pointerType = llvm::PointerType::getUnqual(llvm::Type::getInt8Ty(llvmContext));
+
+    auto *const calls = new llvm::GlobalVariable(module, int64Type, false, llvm::GlobalValue::InternalLinkage,
+                                                 llvm::ConstantInt::get(int64Type, 0), name + ".calls");
+
+    llvm::FunctionCallee hook = module.getOrInsertFunction(
+        kTierUpHook, llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), {pointerType, int64Type}, false));
+
+    // tier.count: ++calls, tier.up on the call that reaches the threshold, then the body as it was
+    llvm::BasicBlock *const body = &func.getEntryBlock();
+    llvm::BasicBlock *const count = llvm::BasicBlock::Create(llvmContext, "tier.count", &func, body);
+    llvm::BasicBlock *const tierUp = llvm::BasicBlock::Create(llvmContext, "tier.up", &func, body);
+
+    llvm::IRBuilder<> builder{count};
+    llvm::Value *const callCount =
+        builder.CreateAdd(builder.CreateLoad(int64Type, calls), llvm::ConstantInt::get(int64Type, 1));
+    builder.CreateStore(callCount, calls);
+    builder.CreateCondBr(builder.CreateICmpEQ(callCount, llvm::ConstantInt::get(int64Type, m_threshold)), tierUp,
+                         body);
+
+    builder.SetInsertPoint(tierUp);
+    llvm::Constant *const self = llvm::ConstantExpr::getIntToPtr(
+        llvm::ConstantInt::get(int64Type, reinterpret_cast<std::uintptr_t>(this)), pointerType);
+    builder.CreateCall(hook, {self, llvm::ConstantInt::get(int64Type, id)});
+    builder.CreateBr(body);
+}
+
+void TieredCompiler::backgroundLoop() {
+    while (true) {
+        std::uint64_t id;
+        {
+            std::unique_lock lock{m_queueMutex};
+            m_queueChanged.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+
+            id = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        // The function keeps running at tier 0 if anything goes wrong
+        if (auto error = promote(id)) {
+            std::cout << "Error: tier-up failed: " << llvm::toString(std::move(error)) << '\n';
+        }
+    }
+}
+
+llvm::Error TieredCompiler::promote(std::uint64_t id) {
+    if (!m_targetMachine) {
+        auto targetMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+        if (!targetMachineBuilder) {
+            return targetMachineBuilder.takeError();
+        }
+        targetMachineBuilder->setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+
+        auto targetMachine = targetMachineBuilder->createTargetMachine();
+        if (!targetMachine) {
+            return targetMachine.takeError();
+        }
+        m_targetMachine = std::move(*targetMachine);
+    }
+
+    auto llvmContext = std::make_unique<llvm::LLVMContext>();
+
+    std::unique_lock functionsLock{m_functionsMutex};
+    const TieredFunction &function = m_functions[id];
+    const std::string name{function.m_name.str()};
+
+    auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef{llvm::StringRef{function.m_bitcode.data(),
+                                                                               function.m_bitcode.size()},
+                                                               name},
+                                         *llvmContext);
+    if (!parsed) {
+        return parsed.takeError();
+    }
+    std::unique_ptr<llvm::Module> module = std::move(*parsed);
+
+    // Bring in the bodies of the tiered functions it calls, to be inlined. They stay available_externally: whatever
+    // is not inlined still calls the stub.
+    std::vector<const TieredFunction *> callees;
+    for (const llvm::Function &func : *module) {
+        if (func.isDeclaration() && func.getName() != name) {
+            if (const auto it = m_ids.find(Symbol::intern(std::string_view{func.getName()})); it != m_ids.end()) {
+                callees.push_back(&m_functions[it->second]);
+            }
+        }
+    }
+
+    llvm::Linker linker{*module};
+    for (const TieredFunction *callee : callees) {
+        auto calleeModule = llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef{llvm::StringRef{callee->m_bitcode.data(), callee->m_bitcode.size()},
+                                  callee->m_name.str()},
+            *llvmContext);
+        if (!calleeModule) {
+            return calleeModule.takeError();
+        }
+
+        (*calleeModule)->getFunction(callee->m_name.str())->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+        if (linker.linkInModule(std::move(*calleeModule))) {
+            return llvm::make_error<llvm::StringError>("cannot link the callees of " + name,
+                                                       llvm::inconvertibleErrorCode());
+        }
+    }
+    functionsLock.unlock();
+
+    module->setDataLayout(m_jit.getDataLayout());
+    module->setTargetTriple(m_targetMachine->getTargetTriple().str());
+
+    // The function itself gets a name of its own, its recursive calls now go straight to the tier-1 body
+    module->getFunction(name)->setName(name + kTier1Suffix);
+
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    llvm::PipelineTuningOptions tuningOptions;
+    tuningOptions.LoopVectorization = true;
+    tuningOptions.SLPVectorization = true;
+
+    llvm::PassInstrumentationCallbacks PIC;
+    if (m_profiler) {
+        m_profiler->registerCallbacks(PIC);
+    }
+
+    llvm::PassBuilder passBuilder{m_targetMachine.get(), tuningOptions, {}, m_profiler ? &PIC : nullptr};
+    passBuilder.registerModuleAnalyses(MAM);
+    passBuilder.registerCGSCCAnalyses(CGAM);
+    passBuilder.registerFunctionAnalyses(FAM);
+    passBuilder.registerLoopAnalyses(LAM);
+    passBuilder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3).run(*module, MAM);
+
+    if (auto error = m_jit.addEagerModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(llvmContext)))) {
+        return error;
+    }
+
+    auto tier1Symbol = m_jit.lookup(name + kTier1Suffix);
+    if (!tier1Symbol) {
+        return tier1Symbol.takeError();
+    }
+    if (auto error = m_jit.redirect(name, tier1Symbol->getAddress())) {
+        return error;
+    }
+
+    m_promoted.fetch_add(1, std::memory_order_release);
+    return llvm::Error::success();
+}
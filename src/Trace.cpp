@@ -0,0 +1,197 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+constexpr const char *kCounterNames[] = {
+    "tokens lexed",
+    "AST nodes",
+    "IR instructions before optimization",
+    "IR instructions after optimization",
+    "machine code bytes",
+    "JIT lookups",
+};
+static_assert(std::size(kCounterNames) == static_cast<std::size_t>(Counter::Count));
+
+struct Event {
+    const char *m_name;
+    std::string m_detail;
+    std::uint32_t m_thread;
+    Clock::time_point m_begin;
+    Clock::time_point m_end;
+};
+
+// The spans of all threads, in the order they ended
+struct Recorder {
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+    Clock::time_point m_start;
+};
+
+Recorder &recorder() {
+    static Recorder recorder;
+    return recorder;
+}
+
+// Small thread ids for the trace, in the order the threads first recorded something
+std::uint32_t threadIndex() {
+    static std::atomic<std::uint32_t> next = 0;
+    thread_local const std::uint32_t index = next++;
+    return index;
+}
+
+// `text` as a JSON string literal
+std::string jsonString(std::string_view text) {
+    std::string quoted = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            quoted += ' ';
+            continue;
+        }
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+// Microseconds since the start of the recording, the unit of trace events
+double microseconds(Clock::time_point time) {
+    return std::chrono::duration<double, std::micro>(time - recorder().m_start).count();
+}
+
+void writeChromeTrace(std::ostream &out, const std::vector<Event> &events, Clock::time_point end) {
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+
+    std::uint32_t threads = 0;
+    for (const Event &event : events) {
+        threads = std::max(threads, event.m_thread + 1);
+
+        out << "{\"name\":\"" << event.m_name << "\",\"cat\":\"kaleidoscope\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << event.m_thread << ",\"ts\":" << microseconds(event.m_begin)
+            << ",\"dur\":" << microseconds(event.m_end) - microseconds(event.m_begin);
+        if (!event.m_detail.empty()) {
+            out << ",\"args\":{\"detail\":" << jsonString(event.m_detail) << '}';
+        }
+        out << "},\n";
+    }
+
+    for (std::uint32_t thread = 0; thread < threads; ++thread) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\""
+            << (thread == 0 ? "main" : "thread " + std::to_string(thread)) << "\"}},\n";
+    }
+
+    // The totals, at the end of the recording
+    out << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << microseconds(end) << ",\"args\":{";
+    for (std::size_t i = 0; i < std::size(kCounterNames); ++i) {
+        out << (i == 0 ? "" : ",") << jsonString(kCounterNames[i]) << ':'
+            << detail::s_counters[i].load(std::memory_order_relaxed);
+    }
+    out << "}}\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void printSummary(const std::vector<Event> &events) {
+    struct Phase {
+        const char *m_name;
+        std::size_t m_spans = 0;
+        Clock::duration m_total{};
+        Clock::duration m_longest{};
+    };
+
+    // In the order the phases first ended
+    std::vector<Phase> phases;
+    for (const Event &event : events) {
+        auto phase = std::find_if(phases.begin(), phases.end(),
+                                  [&](const Phase &phase) { return std::string_view{phase.m_name} == event.m_name; });
+        if (phase == phases.end()) {
+            phase = phases.insert(phases.end(), Phase{event.m_name});
+        }
+
+        ++phase->m_spans;
+        phase->m_total += event.m_end - event.m_begin;
+        phase->m_longest = std::max(phase->m_longest, event.m_end - event.m_begin);
+    }
+
+    const auto milliseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    // Spans nest(a lookup compiles what it finds), the totals are inclusive
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(3) << "Phase                 spans    total ms     mean ms      max ms\n";
+    for (const Phase &phase : phases) {
+        summary << std::left << std::setw(16) << phase.m_name << std::right << std::setw(11) << phase.m_spans
+                << std::setw(12) << milliseconds(phase.m_total) << std::setw(12)
+                << milliseconds(phase.m_total) / static_cast<double>(phase.m_spans) << std::setw(12)
+                << milliseconds(phase.m_longest) << '\n';
+    }
+
+    summary << "\nCounter                                      total\n";
+    for (std::size_t i = 0; i < std::size(kCounterNames); ++i) {
+        summary << std::left << std::setw(36) << kCounterNames[i] << std::right << std::setw(15)
+                << detail::s_counters[i].load(std::memory_order_relaxed) << '\n';
+    }
+
+    std::cout << summary.str() << std::flush;
+}
+
+}  // namespace
+
+void detail::record(const char *name, std::string_view detail, Clock::time_point begin, Clock::time_point end) {
+    Event event{name, std::string{detail}, threadIndex(), begin, end};
+
+    Recorder &rec = recorder();
+    std::lock_guard lock{rec.m_mutex};
+    rec.m_events.push_back(std::move(event));
+}
+
+void enable() {
+    recorder().m_start = Clock::now();
+    threadIndex();  // the enabling thread is the main one
+    detail::s_enabled.store(true, std::memory_order_relaxed);
+}
+
+Session::Session(std::string traceFile, bool summary)
+    : m_traceFile(std::move(traceFile))
+    , m_summary(summary) {
+    if (!m_traceFile.empty() || m_summary) {
+        enable();
+    }
+}
+
+Session::~Session() {
+    if (!enabled()) {
+        return;
+    }
+
+    const Clock::time_point end = Clock::now();
+    detail::s_enabled.store(false, std::memory_order_relaxed);
+
+    Recorder &rec = recorder();
+    std::lock_guard lock{rec.m_mutex};
+
+    if (!m_traceFile.empty()) {
+        std::ofstream file{m_traceFile};
+        writeChromeTrace(file, rec.m_events, end);
+        if (!file) {
+            std::cout << "Error: cannot write the trace to '" << m_traceFile << "'\n";
+        }
+    }
+
+    if (m_summary) {
+        printSummary(rec.m_events);
+    }
+}
+
+}  // namespace trace
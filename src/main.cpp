@@ -1,29 +1,81 @@
+#include <csignal>
 #include <iostream>
+#include <string>
+#include <thread>
 
-#include "Parser.hpp"
+#include "AotCompiler.hpp"
+#include "Driver.hpp"
+#include "Interpreter.hpp"
+#include "Options.hpp"
+#include "Server.hpp"
+#include "Trace.hpp"
 
 constexpr bool TEST_LEXER = false;
 constexpr bool TEST_PARSER = true;
 
-int main() {
+// Reads the program from the input file, or from stdin
+static std::unique_ptr<SourceBuffer> openSource(const Options &options) {
+    if (!options.m_inputFile.empty()) {
+        return MappedFileSource::open(options.m_inputFile.c_str());
+    }
+    return std::make_unique<StreamSource>();
+}
+
+// Stopped by SIGINT and SIGTERM
+static Server *g_server = nullptr;
+
+// --serve: runs the server until it is stopped
+static int serve(const Options &options) {
+    std::string library;
+    if (!options.m_preloadFile.empty()) {
+        const auto source = MappedFileSource::open(options.m_preloadFile.c_str());
+        if (!source) {
+            return 1;
+        }
+        library = source->readAll();
+    }
+
+    // Written once the server is gone, workers included
+    trace::Session traceSession{options.m_traceFile, options.m_traceSummary};
+
+    const unsigned threads = options.m_serveThreads > 0 ? options.m_serveThreads : std::thread::hardware_concurrency();
+    const auto server = Server::open(options.m_serveSocket, threads, options.m_optLevel, library);
+    if (!server) {
+        return 1;
+    }
+
+    g_server = server.get();
+    const auto stop = [](int) { g_server->stop(); };
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    server->run();
+    std::cout << "Served " << server->requests() << " requests\n";
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const auto options = Options::parse(argc, argv);
+    if (!options) {
+        return 1;
+    }
+
+    if (!options->m_serveSocket.empty()) {
+        return serve(*options);
+    }
+
+    auto source = openSource(*options);
+    if (!source) {
+        return 1;
+    }
+
+    // Written once everything below is gone, JIT threads included
+    trace::Session traceSession{options->m_traceFile, options->m_traceSummary};
+
     if constexpr (TEST_LEXER) {
-        Lexer lexer;
+        Lexer lexer{std::move(source)};
 
         for (TokenData td = lexer.getNextToken();; td = lexer.getNextToken()) {
-            const auto unpackValue = [](const auto &value) {
-                return std::visit(
-                    []<typename T>(const T &val) {
-                        if constexpr (std::is_same_v<T, char>) {
-                            return std::string{val};
-                        } else if constexpr (std::is_same_v<T, std::string>) {
-                            return val;
-                        } else {
-                            return std::to_string(val);
-                        }
-                    },
-                    value);
-            };
-
             switch (td.m_token) {
                 case Token::TOK_EOF:
                     std::cout << "EOF\n";
@@ -35,23 +87,47 @@ int main() {
                     std::cout << "extern\n";
                     break;
                 case Token::TOK_IDENTIFIER:
-                    std::cout << "id: " << unpackValue(td.m_value) << '\n';
+                    std::cout << "id: " << td.m_value.m_symbol.str() << '\n';
                     break;
                 case Token::TOK_NUMBER:
-                    std::cout << "num: " << unpackValue(td.m_value) << '\n';
+                    std::cout << "num: " << std::to_string(td.m_value.m_number) << '\n';
                     break;
                 case Token::TOK_OPERATOR:
-                    std::cout << "op: '" << unpackValue(td.m_value) << "'\n";
+                    std::cout << "op: '" << td.m_value.m_op << "'\n";
                     break;
             }
         }
     }
 
     if constexpr (TEST_PARSER) {
-        Lexer lexer;
-        Parser parser{lexer};
+        // The parallel front end splits the whole program up front, the lexer is left with nothing to read
+        const std::string program = options->m_parseThreads > 1 ? source->readAll() : std::string{};
+        Lexer lexer{std::move(source)};
+
+        if (options->aheadOfTime()) {
+            AotCompiler compiler{lexer, *options};
+            return compiler.run() == 0 ? 0 : 1;
+        }
+
+        if (options->m_engine == Engine::Interp) {
+            Interpreter interpreter{lexer};
+
+            if (options->m_batch) {
+                return interpreter.runBatch() == 0 ? 0 : 1;
+            }
+
+            interpreter.runInteractive();
+            return 0;
+        }
+
+        Driver driver{lexer, *options};
+
+        if (options->m_batch) {
+            const int errors = options->m_parseThreads > 1 ? driver.runBatch(program) : driver.runBatch();
+            return errors == 0 ? 0 : 1;
+        }
 
-        parser.mainLoop();
+        driver.runInteractive();
     }
 
     return 0;